@@ -0,0 +1,376 @@
+/*
+Asymmetric Multiprocessing
+
+Runs data producers on the other three A53 cores while psu_cortexa53_0 keeps ownership of the UART and everything
+else. Producers only touch the NVMe queues through AMP_OP_RUN jobs that use the driver's multi-producer submission
+path (the nvme*CID() functions and nvmeIsIOComplete()). Core 0 sends jobs (fill a buffer with the verify pattern,
+copy a frame, check a read buffer) to each producer core over its own single-producer / single-consumer ring, and gets
+them back over a second ring in the other direction. Each ring index is written by one core only, so no atomic
+read-modify-write is needed: just a barrier between writing an entry and publishing the index that hands it over.
+
+The producer cores run from the same image. They are started at ampSecondaryEntry with core 0's MMU and exception
+settings, their own stacks, and FP/SIMD enabled, and then wait for jobs. Core 0 runs with the data cache disabled,
+and so do the producers, so all shared memory is coherent without cache maintenance.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "amp.h"
+#include "xtime_l.h"
+#include <string.h>
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define AMP_STACK_SIZE 0x10000			// 64KiB per producer core.
+#define AMP_START_TIMEOUT_MS 100
+
+// Reset and Boot Address Registers
+#define APU_RVBARADDR_BASE 0xFD5C0040	// RVBARADDRnL/H pairs for cores 0-3.
+#define CRF_APB_RST_FPD_APU 0xFD1A0104	// ACPUn_RESET in bits 3:0, ACPUn_PWRON_RESET in bits 13:10.
+#define PMU_GLOBAL_REQ_PWRUP_STATUS 0xFFD80110
+#define PMU_GLOBAL_REQ_PWRUP_INT_EN 0xFFD80118
+#define PMU_GLOBAL_REQ_PWRUP_TRIG 0xFFD80120	// ACPUn in bits 3:0.
+
+#define dmb() __asm__ __volatile__("dmb ish" : : : "memory")
+#define sev() __asm__ __volatile__("sev" : : : "memory")
+#define wfe() __asm__ __volatile__("wfe" : : : "memory")
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Single-Producer / Single-Consumer Ring. head is written only by the producer, tail only by the consumer. They are
+// kept on separate cache lines in case the data cache is ever enabled.
+typedef struct
+{
+	volatile u32 head;
+	u8 pad0[60];
+	volatile u32 tail;
+	u8 pad1[60];
+	ampJob_type jobs[AMP_RING_SIZE];
+} spscRing_type;
+
+// Boot Parameters for ampSecondaryEntry. Offsets are used by the assembly below.
+typedef struct
+{
+	u64 ttbr0;					// 0x00
+	u64 tcr;					// 0x08
+	u64 mair;					// 0x10
+	u64 sctlr;					// 0x18
+	u64 vbar;					// 0x20
+	u64 sp[4];					// 0x28
+} ampBoot_type;
+
+// Per-Core Producer State, written only by that core.
+typedef struct
+{
+	volatile u32 alive;
+	u64 busyCounts;
+	u64 jobs;
+	patternStats_type stats;
+} ampCore_type;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void ampSecondaryEntry(void);
+void ampProducerMain(u64 core);
+u8 spscPush(spscRing_type * ring, const ampJob_type * job);
+u8 spscPop(spscRing_type * ring, ampJob_type * job);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+ampBoot_type ampBoot;
+u8 ampStacks[AMP_CORES_MAX][AMP_STACK_SIZE] __attribute__((aligned(16)));
+
+spscRing_type ampJobRing[AMP_CORES_MAX + 1];		// Core 0 to producer core n, indexed by core.
+spscRing_type ampDoneRing[AMP_CORES_MAX + 1];		// Producer core n to core 0.
+ampCore_type ampCore[AMP_CORES_MAX + 1];
+volatile u32 ampResetRequest[AMP_CORES_MAX + 1];
+
+u32 ampCores = 0;				// Producer cores running.
+u32 ampActive = 0;				// Producer cores jobs are submitted to.
+u32 ampNext = 0;				// Round-robin submission.
+u32 ampPending = 0;				// Jobs submitted but not yet polled back.
+
+// Producer core entry, at EL3 with the MMU and caches off. Loads core 0's translation and exception settings, enables
+// FP/SIMD, sets the stack from ampBoot.sp[core], and calls ampProducerMain(core).
+__asm__(
+	".section .text.ampSecondaryEntry, \"ax\"\n"
+	".global ampSecondaryEntry\n"
+	".balign 64\n"
+	"ampSecondaryEntry:\n"
+	"	msr cptr_el3, xzr\n"
+	"	isb\n"
+	"	mrs x0, mpidr_el1\n"
+	"	and x0, x0, #0xFF\n"
+	"	ldr x1, =ampBoot\n"
+	"	ldr x2, [x1, #0x00]\n"
+	"	msr ttbr0_el3, x2\n"
+	"	ldr x2, [x1, #0x08]\n"
+	"	msr tcr_el3, x2\n"
+	"	ldr x2, [x1, #0x10]\n"
+	"	msr mair_el3, x2\n"
+	"	ldr x2, [x1, #0x20]\n"
+	"	msr vbar_el3, x2\n"
+	"	tlbi alle3\n"
+	"	dsb sy\n"
+	"	isb\n"
+	"	ldr x2, [x1, #0x18]\n"
+	"	msr sctlr_el3, x2\n"
+	"	isb\n"
+	"	add x3, x1, #0x28\n"
+	"	ldr x2, [x3, x0, lsl #3]\n"
+	"	mov sp, x2\n"
+	"	bl ampProducerMain\n"
+	"1:	wfe\n"
+	"	b 1b\n"
+	".ltorg\n"
+	".text\n"
+);
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Use producer cores 1 to nCores (0 for none), starting any that aren't running yet. Call from core 0 only.
+int ampInit(u32 nCores)
+{
+	volatile u32 * rvbar;
+	volatile u32 * rstFPDAPU = (volatile u32 *)(CRF_APB_RST_FPD_APU);
+	volatile u32 * pwrupStatus = (volatile u32 *)(PMU_GLOBAL_REQ_PWRUP_STATUS);
+	volatile u32 * pwrupIntEn = (volatile u32 *)(PMU_GLOBAL_REQ_PWRUP_INT_EN);
+	volatile u32 * pwrupTrig = (volatile u32 *)(PMU_GLOBAL_REQ_PWRUP_TRIG);
+	u64 el, entry = (u64) ampSecondaryEntry;
+	XTime tStart, tNow;
+
+	if(nCores > AMP_CORES_MAX) { nCores = AMP_CORES_MAX; }
+	if(nCores <= ampCores)
+	{
+		ampActive = nCores;
+		return AMP_OK;
+	}
+
+	__asm__ __volatile__("mrs %0, CurrentEL" : "=r" (el));
+	if(((el >> 2) & 0x3) != 3) { return AMP_ERROR_EL; }
+
+	// Producers use the same translation tables and settings as this core.
+	__asm__ __volatile__("mrs %0, ttbr0_el3" : "=r" (ampBoot.ttbr0));
+	__asm__ __volatile__("mrs %0, tcr_el3" : "=r" (ampBoot.tcr));
+	__asm__ __volatile__("mrs %0, mair_el3" : "=r" (ampBoot.mair));
+	__asm__ __volatile__("mrs %0, sctlr_el3" : "=r" (ampBoot.sctlr));
+	__asm__ __volatile__("mrs %0, vbar_el3" : "=r" (ampBoot.vbar));
+
+	for(u32 core = ampCores + 1; core <= nCores; core++)
+	{
+		ampBoot.sp[core] = (u64) &ampStacks[core - 1][AMP_STACK_SIZE];
+		ampJobRing[core].head = 0;
+		ampJobRing[core].tail = 0;
+		ampDoneRing[core].head = 0;
+		ampDoneRing[core].tail = 0;
+		ampCore[core].alive = 0;
+		ampResetRequest[core] = 0;
+		dmb();
+
+		rvbar = (volatile u32 *)((u64)APU_RVBARADDR_BASE + 8 * core);
+		rvbar[0] = (u32)(entry & 0xFFFFFFFF);
+		rvbar[1] = (u32)(entry >> 32);
+
+		// Power up the core through the PMU if it's off, then release its resets.
+		*pwrupIntEn = (1 << core);
+		*pwrupTrig = (1 << core);
+		XTime_GetTime(&tStart);
+		do { XTime_GetTime(&tNow); }
+		while((*pwrupStatus & (1 << core)) && ((tNow - tStart) < (u64)AMP_START_TIMEOUT_MS * COUNTS_PER_SECOND / 1000));
+
+		*rstFPDAPU &= ~((1 << core) | (1 << (core + 10)));
+
+		XTime_GetTime(&tStart);
+		do
+		{
+			XTime_GetTime(&tNow);
+			if((tNow - tStart) > (u64)AMP_START_TIMEOUT_MS * COUNTS_PER_SECOND / 1000) { return AMP_ERROR_TIMEOUT; }
+		}
+		while(!ampCore[core].alive);
+
+		ampCores = core;
+	}
+	ampActive = nCores;
+
+	return AMP_OK;
+}
+
+u32 ampGetCores(void)
+{
+	return ampActive;
+}
+
+// Queue a job on the next producer core with room, round-robin. Returns 1 if queued, 0 if every ring is full.
+u8 ampSubmit(const ampJob_type * job)
+{
+	u32 core;
+
+	for(u32 i = 0; i < ampActive; i++)
+	{
+		if(ampNext >= ampActive) { ampNext = 0; }
+		core = ampNext + 1;
+		ampNext = (ampNext + 1) % ampActive;
+		if(spscPush(&ampJobRing[core], job))
+		{
+			ampPending++;
+			sev();
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Get one finished job from any producer core. Returns 1 if one was available.
+u8 ampPoll(ampJob_type * done)
+{
+	for(u32 core = 1; core <= ampCores; core++)
+	{
+		if(spscPop(&ampDoneRing[core], done))
+		{
+			ampPending--;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Jobs submitted but not yet returned by ampPoll().
+u32 ampGetPending(void)
+{
+	return ampPending;
+}
+
+// Ask each producer to clear its statistics, and wait until they have. Only call with no jobs pending.
+void ampResetStats(void)
+{
+	for(u32 core = 1; core <= ampCores; core++) { ampResetRequest[core] = 1; }
+	dmb();
+	sev();
+	for(u32 core = 1; core <= ampCores; core++)
+	{
+		while(ampResetRequest[core]) { sev(); }
+	}
+}
+
+// Sum of the check results from all producer cores. Only call with no jobs pending.
+void ampGetCheckStats(patternStats_type * stats)
+{
+	patternStats_type * s;
+
+	patternResetStats(stats);
+	for(u32 core = 1; core <= ampCores; core++)
+	{
+		s = &ampCore[core].stats;
+		if((s->lbaBad > 0) && ((stats->lbaBad == 0) || (s->firstBadLBA < stats->firstBadLBA)))
+		{
+			stats->firstBadLBA = s->firstBadLBA;
+			stats->firstBadStampLBA = s->firstBadStampLBA;
+		}
+		stats->lbaChecked += s->lbaChecked;
+		stats->lbaBad += s->lbaBad;
+		stats->wordsBad += s->wordsBad;
+		stats->bitsBad += s->bitsBad;
+		stats->bits0to1 += s->bits0to1;
+		stats->bits1to0 += s->bits1to0;
+	}
+}
+
+// Time a producer core has spent on jobs, in XTime counts, and the number of jobs, since ampResetStats().
+void ampGetBusy(u32 core, u64 * busyCounts, u64 * jobs)
+{
+	if((core == 0) || (core > ampCores)) { *busyCounts = 0; *jobs = 0; return; }
+	*busyCounts = ampCore[core].busyCounts;
+	*jobs = ampCore[core].jobs;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Producer core main loop. Never returns.
+void ampProducerMain(u64 core)
+{
+	ampCore_type * self = &ampCore[core];
+	ampJob_type job;
+	XTime tStart, tEnd;
+
+	self->busyCounts = 0;
+	self->jobs = 0;
+	patternResetStats(&self->stats);
+	dmb();
+	self->alive = 1;
+
+	for(;;)
+	{
+		if(ampResetRequest[core])
+		{
+			self->busyCounts = 0;
+			self->jobs = 0;
+			patternResetStats(&self->stats);
+			dmb();
+			ampResetRequest[core] = 0;
+		}
+
+		if(!spscPop(&ampJobRing[core], &job))
+		{
+			wfe();
+			continue;
+		}
+
+		XTime_GetTime(&tStart);
+		switch(job.op)
+		{
+		case AMP_OP_FILL:
+			patternFill(job.buffer, job.lba, job.numLBA, job.lbaSize, job.pass, job.seed);
+			break;
+		case AMP_OP_COPY:
+			memcpy(job.buffer, job.source, (u64)job.numLBA * job.lbaSize);
+			break;
+		case AMP_OP_CHECK:
+			job.bad = patternCheck(job.buffer, job.lba, job.numLBA, job.lbaSize, job.pass, job.seed, &self->stats);
+			break;
+		case AMP_OP_RUN:
+			job.run(job.arg);
+			break;
+		default:
+			break;
+		}
+		XTime_GetTime(&tEnd);
+		self->busyCounts += tEnd - tStart;
+		self->jobs++;
+
+		// The done ring has as many entries as the job ring, and core 0 drains it, so this wait is short.
+		while(!spscPush(&ampDoneRing[core], &job)) { }
+	}
+}
+
+u8 spscPush(spscRing_type * ring, const ampJob_type * job)
+{
+	u32 head = ring->head;
+
+	if(head - ring->tail >= AMP_RING_SIZE) { return 0; }
+
+	ring->jobs[head & (AMP_RING_SIZE - 1)] = *job;
+	dmb();								// Entry is visible before the index that hands it over.
+	ring->head = head + 1;
+
+	return 1;
+}
+
+u8 spscPop(spscRing_type * ring, ampJob_type * job)
+{
+	u32 tail = ring->tail;
+
+	if(tail == ring->head) { return 0; }
+
+	dmb();								// Entry is read after the index that handed it over.
+	*job = ring->jobs[tail & (AMP_RING_SIZE - 1)];
+	dmb();								// Entry is read before the slot is handed back.
+	ring->tail = tail + 1;
+
+	return 1;
+}
@@ -0,0 +1,61 @@
+/*
+Asymmetric Multiprocessing Include
+*/
+
+#ifndef __AMP_INCLUDE__
+#define __AMP_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+#include "pattern.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+#define AMP_CORES_MAX 3				// Producer cores: psu_cortexa53_1 to psu_cortexa53_3.
+#define AMP_RING_SIZE 64			// Jobs per ring, power of 2.
+
+// Job Operations
+#define AMP_OP_FILL 1				// LBA-stamped pattern, see patternFill().
+#define AMP_OP_COPY 2				// Copy numLBA LBAs from source.
+#define AMP_OP_CHECK 3				// Check the pattern, see patternCheck(). Results accumulate per core.
+#define AMP_OP_RUN 4				// Call run(arg) on the producer core, e.g. to submit NVMe commands from it.
+
+// ampInit() Return Values
+#define AMP_OK 0
+#define AMP_ERROR_EL 1				// Not running at EL3, so the other cores can't be started from here.
+#define AMP_ERROR_TIMEOUT 2			// A core didn't start.
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Producer Job, and its completion (returned unchanged apart from bad).
+typedef struct
+{
+	u8 * buffer;
+	const u8 * source;			// AMP_OP_COPY only.
+	u64 lba;
+	u32 numLBA;
+	u32 lbaSize;
+	u32 pass;
+	u32 seed;
+	u32 tag;					// Caller's identifier, e.g. slot or frame index.
+	u32 bad;					// AMP_OP_CHECK: Bad LBAs found.
+	void (*run)(void * arg);	// AMP_OP_RUN only.
+	void * arg;
+	u8 op;
+} ampJob_type;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+int ampInit(u32 nCores);
+u32 ampGetCores(void);
+u8 ampSubmit(const ampJob_type * job);
+u8 ampPoll(ampJob_type * done);
+u32 ampGetPending(void);
+void ampResetStats(void);
+void ampGetCheckStats(patternStats_type * stats);
+void ampGetBusy(u32 core, u64 * busyCounts, u64 * jobs);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
@@ -11,6 +11,33 @@
 #include "diskio.h"		/* Declarations of disk functions */
 #include "nvme.h"
 
+#define DISK_ASYNC_MAX	NVME_IO_QUEUE_DEPTH	/* Commands tracked at a time, as many as the driver keeps in flight */
+#define DISK_ASYNC_SLOTS	NVME_IO_SLOTS	/* Tracking entries, a power of 2 above DISK_ASYNC_MAX so tokens wrap cleanly */
+#define DISK_READ_TOKENS	1024	/* Most recent tokens disk_poll() knows the read results of, a power of 2 */
+
+static u16 asyncCID[DISK_ASYNC_SLOTS];	/* CID of each command in flight, by token */
+static LBA_t asyncSector[DISK_ASYNC_SLOTS];	/* Start sector of each asynchronous write in flight, by token */
+static UINT asyncCount[DISK_ASYNC_SLOTS];	/* Sectors of each asynchronous write in flight, 0 for a read or a synchronous command */
+static u8 asyncSync[DISK_ASYNC_SLOTS];	/* 1 if disk_read() or disk_write() waits for the command and reports its status, by token */
+static volatile u8 asyncDone[DISK_ASYNC_SLOTS];	/* Set by async_complete() once asyncStatus is valid, by token */
+static u16 asyncStatus[DISK_ASYNC_SLOTS];	/* Status of each completed command, by token */
+static DWORD asyncEnd[DISK_ASYNC_SLOTS];	/* Token of the last command of the transfer each one is part of, by token */
+static u8 asyncRead[DISK_READ_TOKENS];	/* 1 if the token ends an asynchronous read, 2 if that read failed, else 0 */
+static DWORD asyncByCID[NVME_IO_SLOTS];	/* Token of the command with each CID, by CID modulo NVME_IO_SLOTS */
+static DWORD asyncIssued;				/* Token of the last asynchronous command submitted */
+static DWORD asyncRetired;				/* Token up to which all asynchronous commands have completed */
+static DWORD asyncLastWrite;			/* Token of the last asynchronous write submitted */
+static DWORD asyncFailed;				/* Token of the first asynchronous write that failed, 0 if none */
+static u8 asyncSyncFailed;				/* Set if a synchronous command of the current transfer failed */
+static UINT asyncBehind;				/* Asynchronous commands f_write() may leave in flight */
+
+static DRESULT async_submit (BYTE *buff, LBA_t sector, UINT count, u8 write, u8 sync, DWORD *token);
+static void async_complete (const nvmeCompletion_type *completion);
+static void async_retire (void);
+static void async_wait (DWORD token);
+static DWORD async_overlap (LBA_t sector, UINT count);
+static DRESULT wait_tokens (DWORD first, DWORD last);
+
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
 /*-----------------------------------------------------------------------*/
@@ -40,7 +67,11 @@ DSTATUS disk_initialize (
 	{
 		nvmeStatus = nvmeInit();
 	}
-	if(nvmeStatus == NVME_OK) { return 0; }
+	asyncFailed = 0;
+	if(nvmeStatus != NVME_OK) { return STA_NOINIT; }
+
+	// Each command's status is recorded by token as it is reaped, however long ago it was submitted.
+	if(nvmeAddCompletionHook(async_complete) == 0) { return 0; }
 
 	return STA_NOINIT;
 }
@@ -58,22 +89,44 @@ DRESULT disk_read (
 	UINT count		/* Number of sectors to read */
 )
 {
-	// Finish all slipped writes before switching to read.
-	while(nvmeGetIOSlip() > 0)
-	{
-		nvmeServiceIOCompletions(16);
-	}
+	DRESULT res;
+	DWORD first;
+	u8 sq;
+
+	// Finish slipped writes to these sectors only. Other commands stay in flight.
+	async_wait(async_overlap(sector, count));
+
+	// FatFs waits for this one, so it goes ahead of bulk data on the priority queue.
+	sq = nvmeGetIOQueue();
+	nvmeSelectIOQueue(NVME_IOSQ_PRIORITY);
+	first = asyncIssued + 1;
+	res = async_submit(buff, sector, count, 0, 1, 0);
+	nvmeSelectIOQueue(sq);
+
+	// Every command submitted is waited for, even if a later one couldn't be.
+	if(wait_tokens(first, asyncIssued) != RES_OK) { return RES_ERROR; }
+	return res;
+}
 
-	int nvmeRWStatus = nvmeRead(buff, (u64) sector, count);
-	if(nvmeRWStatus != NVME_RW_OK) { return RES_ERROR; }
 
-	// No command slip allowed for reading. TO-DO: What about fast reading?
-	while(nvmeGetIOSlip() > 0)
-	{
-		nvmeServiceIOCompletions(16);
-	}
 
-	return RES_OK;
+/*-----------------------------------------------------------------------*/
+/* Read Sector(s) Asynchronously                                         */
+/*-----------------------------------------------------------------------*/
+/* Submits the read and returns its token. The data is in the buffer     */
+/* once disk_poll() reports the token complete.                          */
+
+DRESULT disk_read_async (
+	BYTE pdrv,		/* Physical drive nmuber to identify the drive */
+	BYTE *buff,		/* Data buffer to store read data */
+	LBA_t sector,	/* Start sector in LBA */
+	UINT count,		/* Number of sectors to read */
+	DWORD *token	/* Token of the read */
+)
+{
+	async_wait(async_overlap(sector, count));
+
+	return async_submit(buff, sector, count, 0, 0, token);
 }
 
 
@@ -89,23 +142,86 @@ DRESULT disk_write (
 	UINT count			/* Number of sectors to write */
 )
 {
-	u8 nSlipAllowed = 0;
+	DRESULT res;
+	DWORD first;
+	u8 sq;
+
+	// FatFs writes its own buffers here, e.g. metadata and partial sectors. They go
+	// out only after every asynchronous data write has completed, and not at all if
+	// an asynchronous command failed, so no metadata can refer to data that isn't on
+	// the drive.
+	async_wait(asyncLastWrite);
+	if(asyncFailed) { return RES_ERROR; }
+
+	// Metadata on the priority queue, ahead of bulk data such as stream writes.
+	sq = nvmeGetIOQueue();
+	nvmeSelectIOQueue(NVME_IOSQ_PRIORITY);
+	first = asyncIssued + 1;
+	res = async_submit((BYTE *) buff, sector, count, 1, 1, 0);
+	nvmeSelectIOQueue(sq);
+
+	// The buffer is reused as soon as this returns.
+	if(wait_tokens(first, asyncIssued) != RES_OK) { return RES_ERROR; }
+	return res;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Write Sector(s) Asynchronously                                        */
+/*-----------------------------------------------------------------------*/
+/* Submits the write and returns its token. The buffer belongs to the    */
+/* drive until disk_poll() reports the token complete. Without a token   */
+/* (f_write()), returns once no more commands are in flight than set     */
+/* with CTRL_WRITE_BEHIND.                                               */
 
-	int nvmeRWStatus = nvmeWrite(buff, (u64) sector, count);
-	if(nvmeRWStatus != NVME_RW_OK) { return RES_ERROR; }
+DRESULT disk_write_async (
+	BYTE pdrv,			/* Physical drive nmuber to identify the drive */
+	const BYTE *buff,	/* Data to be written */
+	LBA_t sector,		/* Start sector in LBA */
+	UINT count,			/* Number of sectors to write */
+	DWORD *token		/* Token of the write, or 0 to apply the write-behind limit */
+)
+{
+	if(async_submit((BYTE *) buff, sector, count, 1, 0, token) != RES_OK) { return RES_ERROR; }
+	if(token) { return RES_OK; }
 
-	// APPLICATION SPECIFIC: If we're writing from image DDR4, allow write slip
-	// of up to 1/4 of the IO queue depth for high-speed transfer.
-	if((u64)buff > 0x10000000)
+	while(asyncIssued - asyncRetired > asyncBehind)
 	{
-		nSlipAllowed = 16;
+		nvmeServiceIOCompletions(16);
+		async_retire();
 	}
 
-	while(nvmeGetIOSlip() > nSlipAllowed)
+	return (asyncFailed) ? RES_ERROR : RES_OK;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Check an Asynchronous Read or Write                                   */
+/*-----------------------------------------------------------------------*/
+
+DRESULT disk_poll (	/* RES_OK:complete, RES_NOTRDY:in flight, RES_ERROR:failed */
+	BYTE pdrv,		/* Physical drive nmuber to identify the drive */
+	DWORD token		/* Token from disk_read_async() or disk_write_async(), covering all writes before it */
+)
+{
+	u8 read;
+
+	nvmeServiceIOCompletions(16);
+	async_retire();
+
+	// A read only reports itself, so that a failed prefetch FatFs throws away fails nothing else.
+	read = asyncRead[token % DISK_READ_TOKENS];
+	if(read)
 	{
-		nvmeServiceIOCompletions(16);
+		if((int)(asyncRetired - token) < 0) { return RES_NOTRDY; }
+		return (read == 2) ? RES_ERROR : RES_OK;
 	}
 
+	if(asyncFailed && (int)(token - asyncFailed) >= 0) { return RES_ERROR; }
+	if((int)(asyncRetired - token) < 0) { return RES_NOTRDY; }
+
 	return RES_OK;
 }
 
@@ -122,11 +238,19 @@ DRESULT disk_ioctl (
 {
 	QWORD numLBA;
 	WORD sizeLBA;
+	int nvmeStatus;
 
 	switch(cmd)
 	{
 	case CTRL_SYNC:
-		nvmeFlush();
+		// Flush only what has completed, and nothing if a write didn't.
+		async_wait(asyncLastWrite);
+		if(asyncFailed) { return RES_ERROR; }
+		while((nvmeStatus = nvmeFlush()) == NVME_RW_QUEUE_FULL)
+		{
+			nvmeServiceIOCompletions(16);
+		}
+		if(nvmeStatus != NVME_RW_OK) { return RES_ERROR; }
 
 		// No command slip allowed for flushing.
 		while(nvmeGetIOSlip() > 0)
@@ -161,8 +285,160 @@ DRESULT disk_ioctl (
 		// Unknown block size, return 1.
 		*(DWORD *) buff = 1;
 		return RES_OK;
+	case CTRL_WRITE_BEHIND:
+		if(*(UINT *) buff >= DISK_ASYNC_MAX) { return RES_PARERR; }
+		asyncBehind = *(UINT *) buff;
+		return RES_OK;
 	}
 
 	return RES_PARERR;
 }
 
+
+
+/*-----------------------------------------------------------------------*/
+/* Asynchronous Command Tracking                                         */
+/*-----------------------------------------------------------------------*/
+
+// Submit a read or write as commands of at most the drive's maximum transfer size, each with the next token. The token
+// returned is the last one, which covers the whole transfer. A synchronous command is waited for with wait_tokens(),
+// which reports its status, so it doesn't count as a failed asynchronous command.
+static DRESULT async_submit (BYTE *buff, LBA_t sector, UINT count, u8 write, u8 sync, DWORD *token)
+{
+	int nvmeRWStatus;
+	UINT lbaSize = nvmeGetLBASize();
+	UINT nMax = nvmeGetMaxTransferSize() / lbaSize;
+	UINT n;
+	DWORD next, last;
+	u16 cid;
+	u16 i;
+
+	if(sync) { asyncSyncFailed = 0; }
+	if((count == 0) || (nMax == 0)) { return RES_PARERR; }
+
+	// Failed pieces of an asynchronous read are reported by the token that ends it.
+	last = asyncIssued + (count + nMax - 1) / nMax;
+	asyncRead[last % DISK_READ_TOKENS] = (!write && !sync) ? 1 : 0;
+
+	while(count > 0)
+	{
+		n = (count > nMax) ? nMax : count;
+
+		// Room to track it, then in the I/O queue.
+		while(asyncIssued - asyncRetired >= DISK_ASYNC_MAX)
+		{
+			nvmeServiceIOCompletions(16);
+			async_retire();
+		}
+		do
+		{
+			if(write) { nvmeRWStatus = nvmeWriteCID(buff, (u64) sector, n, &cid); }
+			else { nvmeRWStatus = nvmeReadCID(buff, (u64) sector, n, &cid); }
+			if(nvmeRWStatus == NVME_RW_QUEUE_FULL) { nvmeServiceIOCompletions(16); }
+		}
+		while(nvmeRWStatus == NVME_RW_QUEUE_FULL);
+		if(nvmeRWStatus != NVME_RW_OK) { return RES_ERROR; }
+
+		// Completions are reaped by polling on this core, so the command can't be seen complete before this is recorded.
+		next = asyncIssued + 1;
+		i = next % DISK_ASYNC_SLOTS;
+		asyncCID[i] = cid;
+		asyncSector[i] = sector;
+		asyncCount[i] = (write && !sync) ? n : 0;
+		asyncSync[i] = sync;
+		asyncDone[i] = 0;
+		asyncEnd[i] = last;
+		asyncByCID[cid % NVME_IO_SLOTS] = next;
+		asyncIssued = next;
+		if(write && !sync) { asyncLastWrite = next; }
+		if(token) { *token = next; }
+
+		buff += n * lbaSize;
+		sector += n;
+		count -= n;
+	}
+
+	return RES_OK;
+}
+
+// Completion Hook: Record the status of a command tracked here, by its token.
+static void async_complete (const nvmeCompletion_type *completion)
+{
+	DWORD token = asyncByCID[completion->cid % NVME_IO_SLOTS];
+	u16 i = token % DISK_ASYNC_SLOTS;
+
+	// Not tracked (e.g. a flush or a command submitted elsewhere) unless its token is in flight with this CID.
+	if((DWORD)(token - asyncRetired - 1) >= (DWORD)(asyncIssued - asyncRetired)) { return; }
+	if((asyncCID[i] != completion->cid) || asyncDone[i]) { return; }
+
+	asyncStatus[i] = completion->status;
+	asyncDone[i] = 1;
+}
+
+// Retire commands in token order, as far as they have completed.
+static void async_retire (void)
+{
+	DWORD next;
+	u16 i;
+
+	while(asyncRetired != asyncIssued)
+	{
+		next = asyncRetired + 1;
+		i = next % DISK_ASYNC_SLOTS;
+		if(!asyncDone[i]) { break; }
+		if(asyncStatus[i])
+		{
+			// A failed read fails only its own transfer, a failed write every token from it on.
+			if(asyncSync[i]) { asyncSyncFailed = 1; }
+			else if(asyncRead[asyncEnd[i] % DISK_READ_TOKENS]) { asyncRead[asyncEnd[i] % DISK_READ_TOKENS] = 2; }
+			else if(!asyncFailed) { asyncFailed = next; }
+		}
+		asyncRetired = next;
+	}
+}
+
+// Wait until all commands up to the token have completed.
+static void async_wait (DWORD token)
+{
+	async_retire();
+	while((int)(asyncRetired - token) < 0)
+	{
+		nvmeServiceIOCompletions(16);
+		async_retire();
+	}
+}
+
+// Token of the last asynchronous write in flight to any of the sectors, or one already retired if none.
+static DWORD async_overlap (LBA_t sector, UINT count)
+{
+	DWORD t;
+	u16 i;
+
+	async_retire();
+	for(t = asyncIssued; t != asyncRetired; t--)
+	{
+		i = t % DISK_ASYNC_SLOTS;
+		if((asyncCount[i] > 0) && (asyncSector[i] < sector + count) && (sector < asyncSector[i] + asyncCount[i])) { return t; }
+	}
+
+	return asyncRetired;
+}
+
+// Wait for the synchronous commands from first to last only, leaving the commands before them in flight. Commands
+// already retired, e.g. to make room for the rest of a long transfer, left their status in asyncSyncFailed.
+static DRESULT wait_tokens (DWORD first, DWORD last)
+{
+	DWORD t;
+	u16 i;
+
+	for(t = first; (int)(last - t) >= 0; t++)
+	{
+		if((int)(asyncRetired - t) >= 0) { continue; }
+		i = t % DISK_ASYNC_SLOTS;
+		while(!asyncDone[i]) { nvmeServiceIOCompletions(16); }
+		if(asyncStatus[i]) { asyncSyncFailed = 1; }
+	}
+	async_retire();
+
+	return (asyncSyncFailed) ? RES_ERROR : RES_OK;
+}
@@ -32,6 +32,9 @@ DRESULT disk_read (BYTE pdrv, BYTE* buff, LBA_t sector, UINT count);
 DRESULT disk_write (BYTE pdrv, const BYTE* buff, LBA_t sector, UINT count);
 DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
 DWORD get_fattime (void);
+DRESULT disk_read_async (BYTE pdrv, BYTE* buff, LBA_t sector, UINT count, DWORD* token);
+DRESULT disk_write_async (BYTE pdrv, const BYTE* buff, LBA_t sector, UINT count, DWORD* token);
+DRESULT disk_poll (BYTE pdrv, DWORD token);
 
 
 /* Disk Status Bits (DSTATUS) */
@@ -66,6 +69,9 @@ DWORD get_fattime (void);
 #define ISDIO_WRITE			56	/* Write data to SD iSDIO register */
 #define ISDIO_MRITE			57	/* Masked write data to SD iSDIO register */
 
+/* Asynchronous write command (Not used by FatFs) */
+#define CTRL_WRITE_BEHIND	30	/* Set the number of asynchronous writes f_write() may leave in flight */
+
 /* ATA/CF specific ioctl command */
 #define ATA_GET_REV			20	/* Get F/W revision */
 #define ATA_GET_MODEL		21	/* Get model name */
@@ -21,6 +21,12 @@
 
 #include "ff.h"			/* Declarations of FatFs API */
 #include "diskio.h"		/* Declarations of device I/O functions */
+#if FF_FAST_MEM && defined(__GNUC__)
+#define FF_MEM_WORD 1
+typedef DWORD __attribute__((__may_alias__)) DWORD_A;	/* 32-bit word that may alias the bytes of any buffer */
+#else
+#define FF_MEM_WORD 0
+#endif
 
 
 /*--------------------------------------------------------------------------
@@ -255,6 +261,30 @@
 #if (FF_MAX_SS < FF_MIN_SS) || (FF_MAX_SS != 512 && FF_MAX_SS != 1024 && FF_MAX_SS != 2048 && FF_MAX_SS != 4096) || (FF_MIN_SS != 512 && FF_MIN_SS != 1024 && FF_MIN_SS != 2048 && FF_MIN_SS != 4096)
 #error Wrong sector size configuration
 #endif
+#if FF_WIN_CACHE < 1 || FF_WIN_CACHE > 255 || (FF_FS_TINY && FF_WIN_CACHE > 1)
+#error Wrong FF_WIN_CACHE setting
+#endif
+#if FF_FAST_BITMAP != 0 && FF_FAST_BITMAP != 1
+#error Wrong FF_FAST_BITMAP setting
+#endif
+#if FF_BITMAP_MIRROR < 0 || FF_BITMAP_MIRROR % FF_MAX_SS
+#error Wrong FF_BITMAP_MIRROR setting
+#endif
+#if (FF_FAST_MEM != 0 && FF_FAST_MEM != 1) || (FF_FAST_MEM && FF_INTDEF != 2)
+#error Wrong FF_FAST_MEM setting
+#endif
+#if FF_FASTSEEK_AUTO && !FF_USE_FASTSEEK
+#error FF_FASTSEEK_AUTO needs FF_USE_FASTSEEK
+#endif
+#if FF_USE_ASYNC_WRITE && FF_FS_READONLY
+#error FF_USE_ASYNC_WRITE needs FF_FS_READONLY == 0
+#endif
+#if FF_READ_AHEAD < 0 || FF_READ_AHEAD > 64 || (FF_READ_AHEAD && (FF_READ_AHEAD_SIZE == 0 || FF_READ_AHEAD_SIZE % FF_MAX_SS))
+#error Wrong FF_READ_AHEAD setting
+#endif
+#if FF_DIR_INDEX < 0 || (FF_DIR_INDEX & (FF_DIR_INDEX - 1)) || (FF_DIR_INDEX && (FF_DIR_INDEX_DIRS < 1 || FF_DIR_INDEX_DIRS > 255))
+#error Wrong FF_DIR_INDEX setting
+#endif
 #if FF_MAX_SS == FF_MIN_SS
 #define SS(fs)	((UINT)FF_MAX_SS)	/* Fixed sector size */
 #else
@@ -460,6 +490,28 @@ typedef struct {
 static FATFS* FatFs[FF_VOLUMES];	/* Pointer to the filesystem objects (logical drives) */
 static WORD Fsid;					/* Filesystem mount ID */
 
+#if FF_FS_EXFAT && !FF_FS_READONLY && FF_BITMAP_MIRROR
+static DWORD BmMirror[FF_VOLUMES][FF_BITMAP_MIRROR / 4];	/* Allocation bitmap mirror of each volume (DWORD aligned for the disk I/O) */
+#define BM_XFER	32	/* Maximum number of sectors per disk access to load or flush the mirror */
+#endif
+
+#if FF_FS_EXFAT && FF_DIR_INDEX
+static DWORD DiOfs[FF_VOLUMES][FF_DIR_INDEX_DIRS * FF_DIR_INDEX];	/* Directory indexes of each volume: entry block offset + 1 (0:empty, DI_DEL:deleted) */
+static WORD DiHash[FF_VOLUMES][FF_DIR_INDEX_DIRS * FF_DIR_INDEX];	/* Directory indexes of each volume: name hash */
+#define DI_DEL	0xFFFFFFFF
+#define DI_KEY(fs, dp)	((dp)->obj.sclust ? (dp)->obj.sclust : (fs)->dirbase)	/* Start cluster of the directory */
+#endif
+
+#if FF_READ_AHEAD
+static DWORD RaBuf[FF_READ_AHEAD][FF_READ_AHEAD_SIZE / 4];	/* Prefetch buffers (DWORD aligned for the disk I/O) */
+static FSIZE_t RaOfs[FF_READ_AHEAD];	/* File offset of the data in each buffer */
+static UINT RaLen[FF_READ_AHEAD];		/* Number of bytes in each buffer (0:free) */
+static DWORD RaTok[FF_READ_AHEAD];		/* Token of the read filling each buffer */
+static FIL* RaFil;						/* File object the buffers belong to */
+static WORD RaId;						/* Volume mount ID of the file object */
+static BYTE RaPdrv;						/* Physical drive the buffers are read from */
+#endif
+
 #if FF_FS_RPATH != 0
 static BYTE CurrVol;				/* Current drive */
 #endif
@@ -680,12 +732,26 @@ static void st_qword (BYTE* ptr, QWORD val)	/* Store an 8-byte word in little-en
 /* String functions                                                      */
 /*-----------------------------------------------------------------------*/
 
+/* The fast versions move 32-bit words where both buffers are aligned alike.
+/  The words are accessed through DWORD_A so that the compiler does not assume
+/  they are distinct from the byte and structure accesses to the same buffers.
+/  The remainder and the unaligned cases fall back to the byte loops. */
+
 /* Copy memory to memory */
 static void mem_cpy (void* dst, const void* src, UINT cnt)
 {
 	BYTE *d = (BYTE*)dst;
 	const BYTE *s = (const BYTE*)src;
 
+#if FF_MEM_WORD
+	if (cnt >= 16 && ((uintptr_t)d & 3) == ((uintptr_t)s & 3)) {
+		for ( ; (uintptr_t)d & 3; cnt--) *d++ = *s++;	/* Align to a word */
+		for ( ; cnt >= 8; cnt -= 8, d += 8, s += 8) {
+			((DWORD_A*)d)[0] = ((const DWORD_A*)s)[0];
+			((DWORD_A*)d)[1] = ((const DWORD_A*)s)[1];
+		}
+	}
+#endif
 	if (cnt != 0) {
 		do {
 			*d++ = *s++;
@@ -699,6 +765,18 @@ static void mem_set (void* dst, int val, UINT cnt)
 {
 	BYTE *d = (BYTE*)dst;
 
+#if FF_MEM_WORD
+	DWORD w = (BYTE)val * 0x01010101UL;
+
+	if (cnt >= 16) {
+		for ( ; (uintptr_t)d & 3; cnt--) *d++ = (BYTE)val;	/* Align to a word */
+		for ( ; cnt >= 8; cnt -= 8, d += 8) {
+			((DWORD_A*)d)[0] = w;
+			((DWORD_A*)d)[1] = w;
+		}
+		if (cnt == 0) return;
+	}
+#endif
 	do {
 		*d++ = (BYTE)val;
 	} while (--cnt);
@@ -711,6 +789,14 @@ static int mem_cmp (const void* dst, const void* src, UINT cnt)	/* ZR:same, NZ:d
 	const BYTE *d = (const BYTE *)dst, *s = (const BYTE *)src;
 	int r = 0;
 
+#if FF_MEM_WORD
+	if (cnt >= 16 && ((uintptr_t)d & 3) == ((uintptr_t)s & 3)) {
+		for ( ; ((uintptr_t)d & 3) && *d == *s; cnt--, d++, s++) ;	/* Align to a word */
+		if ((uintptr_t)d & 3) return *d - *s;
+		for ( ; cnt >= 4 && *(const DWORD_A*)d == *(const DWORD_A*)s; cnt -= 4, d += 4, s += 4) ;
+	}
+#endif
+	if (cnt == 0) return 0;
 	do {
 		r = *d++ - *s++;
 	} while (--cnt && r == 0);
@@ -1068,6 +1154,224 @@ static void clear_lock (	/* Clear lock entries of the volume */
 /*-----------------------------------------------------------------------*/
 /* Move/Flush disk access window in the filesystem object                */
 /*-----------------------------------------------------------------------*/
+#if FF_WIN_CACHE > 1
+/* The window is backed by an N-way sector cache. Moving the window puts its sector
+/  into the cache and takes the new one from the cache if it is there, so the window
+/  itself stays at the same address for the pointers into it. A dirty sector is only
+/  written back when its line is replaced or the window is synced. */
+
+static void wc_reset (
+	FATFS* fs			/* Filesystem object */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < FF_WIN_CACHE; i++) {
+		fs->wc_sect[i] = (LBA_t)0 - 1;
+		fs->wc_dirty[i] = 0;
+		fs->wc_stamp[i] = 0;
+	}
+	fs->wc_clock = 0;
+	fs->wflag = 0;
+	fs->winsect = (LBA_t)0 - 1;
+}
+
+
+static UINT wc_find (	/* Line holding the sector, FF_WIN_CACHE if none */
+	FATFS* fs,			/* Filesystem object */
+	LBA_t sect			/* Sector to look up */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < FF_WIN_CACHE && fs->wc_sect[i] != sect; i++) ;
+	return i;
+}
+
+
+#if !FF_FS_READONLY
+static void wc_discard (	/* Drop clean lines in a sector range */
+	FATFS* fs,			/* Filesystem object */
+	LBA_t sect,			/* First sector */
+	UINT n				/* Number of sectors */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < FF_WIN_CACHE; i++) {
+		if (fs->wc_sect[i] - sect < n && !fs->wc_dirty[i]) fs->wc_sect[i] = (LBA_t)0 - 1;
+	}
+}
+
+
+static FRESULT wc_write_run (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs,			/* Filesystem object */
+	UINT line			/* A dirty line. It is written back with the dirty lines contiguous with it. */
+)
+{
+	LBA_t sect;
+	UINT i, n, nf;
+	BYTE *buf;
+
+
+	/* Find the start of the run of dirty sectors */
+	sect = fs->wc_sect[line];
+	while ((i = wc_find(fs, sect - 1)) < FF_WIN_CACHE && fs->wc_dirty[i]) sect--;
+
+	/* Gather the run, or write a single line in place */
+	for (n = 0; n < FF_WIN_CACHE && (i = wc_find(fs, sect + n)) < FF_WIN_CACHE && fs->wc_dirty[i]; n++) {
+		if (n == 1) mem_cpy(fs->wc_wbuf, fs->wc_buf[line], SS(fs));
+		if (n >= 1) mem_cpy(fs->wc_wbuf + n * SS(fs), fs->wc_buf[i], SS(fs));
+		line = i;
+	}
+	buf = (n == 1) ? fs->wc_buf[line] : fs->wc_wbuf;
+
+	if (disk_write(fs->pdrv, buf, sect, n) != RES_OK) return FR_DISK_ERR;
+	for (i = 0; i < n; i++) fs->wc_dirty[wc_find(fs, sect + i)] = 0;
+	if (sect - fs->fatbase < fs->fsize && fs->n_fats == 2) {	/* Reflect the part in the 1st FAT to the 2nd FAT if needed */
+		nf = (fs->fatbase + fs->fsize - sect < n) ? (UINT)(fs->fatbase + fs->fsize - sect) : n;
+		disk_write(fs->pdrv, buf, sect + fs->fsize, nf);
+	}
+	return FR_OK;
+}
+#endif
+
+
+static UINT wc_victim (	/* An empty or the least recently used line */
+	FATFS* fs			/* Filesystem object */
+)
+{
+	UINT i, n;
+
+
+	for (i = 0, n = 0; n < FF_WIN_CACHE; n++) {
+		if (fs->wc_sect[n] == (LBA_t)0 - 1) return n;
+		if (fs->wc_clock - fs->wc_stamp[n] > fs->wc_clock - fs->wc_stamp[i]) i = n;
+	}
+	return i;
+}
+
+
+static FRESULT wc_store (	/* Put the window into the cache. Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs			/* Filesystem object */
+)
+{
+	UINT i;
+
+
+	if (fs->winsect == (LBA_t)0 - 1) return FR_OK;	/* Nothing valid in the window */
+	i = wc_find(fs, fs->winsect);
+	if (i == FF_WIN_CACHE) {	/* Not cached: replace an empty or the least recently used line */
+		i = wc_victim(fs);
+#if !FF_FS_READONLY
+		if (fs->wc_dirty[i] && wc_write_run(fs, i) != FR_OK) return FR_DISK_ERR;
+#endif
+	}
+	mem_cpy(fs->wc_buf[i], fs->win, SS(fs));
+	fs->wc_sect[i] = fs->winsect;
+	fs->wc_dirty[i] = fs->wflag;
+	fs->wc_stamp[i] = ++fs->wc_clock;
+	fs->wflag = 0;
+	return FR_OK;
+}
+
+
+static int wc_load (	/* Take a sector out of the cache into the window. Returns 0 if it is not cached. */
+	FATFS* fs,			/* Filesystem object */
+	LBA_t sect			/* Sector to load */
+)
+{
+	UINT i;
+
+
+	i = wc_find(fs, sect);
+	if (i == FF_WIN_CACHE) return 0;
+	mem_cpy(fs->win, fs->wc_buf[i], SS(fs));
+	fs->wflag = fs->wc_dirty[i];
+	fs->wc_sect[i] = (LBA_t)0 - 1;
+	fs->wc_dirty[i] = 0;
+	fs->winsect = sect;
+	return 1;
+}
+
+
+#if !FF_FS_READONLY
+static FRESULT sync_window (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs			/* Filesystem object */
+)
+{
+	FRESULT res = FR_OK;
+	UINT i;
+
+
+	if (fs->wflag) res = wc_store(fs);	/* A dirty window is written back with the cache */
+	for (i = 0; i < FF_WIN_CACHE && res == FR_OK; i++) {	/* Write back all dirty lines */
+		if (fs->wc_dirty[i]) res = wc_write_run(fs, i);
+	}
+	return res;
+}
+#endif
+
+
+static FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs,		/* Filesystem object */
+	LBA_t sect		/* Sector LBA to make appearance in the fs->win[] */
+)
+{
+	FRESULT res = FR_OK;
+
+
+	if (sect != fs->winsect) {	/* Window offset changed? */
+		res = wc_store(fs);			/* Move the window into the cache */
+		if (res == FR_OK && !wc_load(fs, sect)) {	/* Fill sector window from the cache, or with new data */
+			if (disk_read(fs->pdrv, fs->win, sect, 1) != RES_OK) {
+				sect = (LBA_t)0 - 1;	/* Invalidate window if read data is not valid */
+				res = FR_DISK_ERR;
+			}
+			fs->winsect = sect;
+		}
+	}
+	return res;
+}
+
+
+#if FF_FS_EXFAT && !FF_FS_READONLY && FF_FAST_BITMAP
+static FRESULT prefetch_window (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs,		/* Filesystem object */
+	LBA_t sect,		/* Sector LBA to make appearance in the fs->win[] */
+	UINT n			/* Number of sectors that will be needed from sect on */
+)
+{
+	UINT i, k, line;
+
+
+	if (sect == fs->winsect || wc_find(fs, sect) < FF_WIN_CACHE) return move_window(fs, sect);
+	if (n > FF_WIN_CACHE) n = FF_WIN_CACHE;	/* The read-ahead must not evict itself */
+	for (k = 1; k < n && sect + k != fs->winsect && wc_find(fs, sect + k) == FF_WIN_CACHE; k++) ;	/* Stop at a sector already in memory */
+	if (k == 1) return move_window(fs, sect);
+
+	if (wc_store(fs) != FR_OK) return FR_DISK_ERR;	/* Move the window into the cache */
+	if (disk_read(fs->pdrv, fs->wc_wbuf, sect, k) != RES_OK) {	/* Read the sector and the ones following it at once */
+		fs->winsect = (LBA_t)0 - 1;
+		return FR_DISK_ERR;
+	}
+	mem_cpy(fs->win, fs->wc_wbuf, SS(fs));
+	fs->winsect = sect;
+	for (i = 1; i < k; i++) {	/* Put the rest into clean lines */
+		line = wc_victim(fs);
+		if (fs->wc_dirty[line]) break;	/* Do not write back for a read-ahead */
+		mem_cpy(fs->wc_buf[line], fs->wc_wbuf + i * SS(fs), SS(fs));
+		fs->wc_sect[line] = sect + i;
+		fs->wc_stamp[line] = ++fs->wc_clock;
+	}
+	return FR_OK;
+}
+#endif
+
+#else
 #if !FF_FS_READONLY
 static FRESULT sync_window (	/* Returns FR_OK or FR_DISK_ERR */
 	FATFS* fs			/* Filesystem object */
@@ -1113,10 +1417,105 @@ static FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERR */
 	}
 	return res;
 }
+#endif	/* FF_WIN_CACHE > 1 */
+
+
+#if !FF_FS_READONLY
+static void set_winsect (	/* Declare the win[] as holding a sector. Call only after sync_window(). */
+	FATFS* fs,		/* Filesystem object */
+	LBA_t sect		/* Sector LBA */
+)
+{
+#if FF_WIN_CACHE > 1
+	wc_discard(fs, sect, 1);	/* Drop the cached copy of the sector */
+#endif
+	fs->winsect = sect;
+}
+#endif
 
 
 
 
+#if FF_FS_EXFAT && !FF_FS_READONLY && FF_BITMAP_MIRROR
+/*-----------------------------------------------------------------------*/
+/* exFAT: Allocation bitmap mirror                                       */
+/*-----------------------------------------------------------------------*/
+
+static FRESULT bm_load (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs,		/* Filesystem object */
+	BYTE* buf		/* Mirror buffer of FF_BITMAP_MIRROR bytes */
+)
+{
+	UINT n, nsect, s;
+
+
+	fs->bm_buf = 0;
+	nsect = (UINT)((fs->n_fatent - 2 + SS(fs) * 8 - 1) / (SS(fs) * 8));	/* Size of the bitmap [sectors] */
+	if ((QWORD)nsect * SS(fs) > FF_BITMAP_MIRROR) return FR_OK;	/* Too large, access it through the window */
+	for (s = 0; s < nsect; s += n) {
+		n = (nsect - s < BM_XFER) ? nsect - s : BM_XFER;
+		if (disk_read(fs->pdrv, buf + s * SS(fs), fs->bitbase + s, n) != RES_OK) return FR_DISK_ERR;
+	}
+	mem_set(fs->bm_dirty, 0, sizeof fs->bm_dirty);
+	fs->bm_buf = buf;
+	return FR_OK;
+}
+
+
+static FRESULT bm_flush (	/* Write back the dirty sectors of the mirror. Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs		/* Filesystem object */
+)
+{
+	UINT i, n, nsect, s;
+
+
+	if (!fs->bm_buf) return FR_OK;
+	nsect = (UINT)((fs->n_fatent - 2 + SS(fs) * 8 - 1) / (SS(fs) * 8));
+	for (s = 0; s < nsect; s += n) {
+		n = 1;
+		if (!(fs->bm_dirty[s / 8] & 1 << s % 8)) continue;
+		while (n < BM_XFER && s + n < nsect && (fs->bm_dirty[(s + n) / 8] & 1 << (s + n) % 8)) n++;	/* Run of dirty sectors */
+		if (disk_write(fs->pdrv, fs->bm_buf + s * SS(fs), fs->bitbase + s, n) != RES_OK) return FR_DISK_ERR;
+		for (i = s; i < s + n; i++) fs->bm_dirty[i / 8] &= ~(1 << i % 8);
+	}
+	return FR_OK;
+}
+
+
+static FRESULT bm_change (	/* Set/Clear a block of the mirror. Returns FR_OK or FR_INT_ERR */
+	FATFS* fs,	/* Filesystem object */
+	DWORD clst,	/* Cluster number to change from */
+	DWORD ncl,	/* Number of clusters to be changed */
+	int bv		/* bit value to be set (0 or 1) */
+)
+{
+	DWORD i;
+	BYTE bm, *p;
+
+
+	clst -= 2;	/* The first bit corresponds to cluster #2 */
+	for (i = clst / 8 / SS(fs); i <= (clst + ncl - 1) / 8 / SS(fs); i++) fs->bm_dirty[i / 8] |= 1 << i % 8;	/* Mark the sectors dirty */
+	p = fs->bm_buf + clst / 8;
+	bm = 1 << (clst % 8);
+	do {
+		if (bm == 1 && ncl >= 8) {	/* A whole byte */
+			if (*p != (bv ? 0 : 0xFF)) return FR_INT_ERR;	/* Are the bits expected value? */
+			*p++ = bv ? 0xFF : 0;
+			ncl -= 8;
+		} else {
+			if (bv == (int)((*p & bm) != 0)) return FR_INT_ERR;	/* Is the bit expected value? */
+			*p ^= bm;	/* Flip the bit */
+			ncl--;
+			if (!(bm <<= 1)) { bm = 1; p++; }
+		}
+	} while (ncl);
+	return FR_OK;
+}
+
+#endif	/* FF_FS_EXFAT && !FF_FS_READONLY && FF_BITMAP_MIRROR */
+
+
+
 #if !FF_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* Synchronize filesystem and data on the storage                        */
@@ -1129,7 +1528,12 @@ static FRESULT sync_fs (	/* Returns FR_OK or FR_DISK_ERR */
 	FRESULT res;
 
 
+#if FF_FS_EXFAT && FF_BITMAP_MIRROR
+	res = bm_flush(fs);		/* Write back the allocation bitmap changed in the mirror */
+	if (res == FR_OK) res = sync_window(fs);
+#else
 	res = sync_window(fs);
+#endif
 	if (res == FR_OK) {
 		if (fs->fs_type == FS_FAT32 && fs->fsi_flag == 1) {	/* FAT32: Update FSInfo sector if needed */
 			/* Create FSInfo structure */
@@ -1140,7 +1544,7 @@ static FRESULT sync_fs (	/* Returns FR_OK or FR_DISK_ERR */
 			st_dword(fs->win + FSI_Free_Count, fs->free_clst);
 			st_dword(fs->win + FSI_Nxt_Free, fs->last_clst);
 			/* Write it into the FSInfo sector */
-			fs->winsect = fs->volbase + 1;
+			set_winsect(fs, fs->volbase + 1);
 			disk_write(fs->pdrv, fs->win, fs->winsect, 1);
 			fs->fsi_flag = 0;
 		}
@@ -1318,13 +1722,14 @@ static FRESULT put_fat (	/* FR_OK(0):succeeded, !=0:error */
 /* Find a contiguous free cluster block */
 /*--------------------------------------*/
 
+#if !FF_FAST_BITMAP
 static DWORD find_bitmap (	/* 0:Not found, 2..:Cluster block found, 0xFFFFFFFF:Disk error */
 	FATFS* fs,	/* Filesystem object */
 	DWORD clst,	/* Cluster number to scan from */
 	DWORD ncl	/* Number of contiguous clusters to find (1..) */
 )
 {
-	BYTE bm, bv;
+	BYTE bm, bv, *p;
 	UINT i;
 	DWORD val, scl, ctr;
 
@@ -1333,11 +1738,19 @@ static DWORD find_bitmap (	/* 0:Not found, 2..:Cluster block found, 0xFFFFFFFF:D
 	if (clst >= fs->n_fatent - 2) clst = 0;
 	scl = val = clst; ctr = 0;
 	for (;;) {
-		if (move_window(fs, fs->bitbase + val / 8 / SS(fs)) != FR_OK) return 0xFFFFFFFF;
+#if FF_BITMAP_MIRROR
+		if (fs->bm_buf) {
+			p = fs->bm_buf + val / 8 / SS(fs) * SS(fs);	/* The sector in the mirror */
+		} else
+#endif
+		{
+			if (move_window(fs, fs->bitbase + val / 8 / SS(fs)) != FR_OK) return 0xFFFFFFFF;
+			p = fs->win;
+		}
 		i = val / 8 % SS(fs); bm = 1 << (val % 8);
 		do {
 			do {
-				bv = fs->win[i] & bm; bm <<= 1;		/* Get bit value */
+				bv = p[i] & bm; bm <<= 1;		/* Get bit value */
 				if (++val >= fs->n_fatent - 2) {	/* Next cluster (with wrap-around) */
 					val = 0; bm = 0; i = SS(fs);
 				}
@@ -1353,6 +1766,106 @@ static DWORD find_bitmap (	/* 0:Not found, 2..:Cluster block found, 0xFFFFFFFF:D
 	}
 }
 
+#else
+static UINT ctz64 (QWORD w)	/* Number of trailing zeros in a non-zero word */
+{
+#if defined(__GNUC__)
+	return (UINT)__builtin_ctzll(w);	/* rbit + clz on AArch64 */
+#else
+	UINT n = 0;
+
+	while (!(w & 1)) { w >>= 1; n++; }
+	return n;
+#endif
+}
+
+
+static UINT span_bitmap (	/* Number of leading bytes equal to pat, counted in whole 8-byte words */
+	const BYTE* p,	/* Start of the span (8-byte aligned offset in the sector) */
+	UINT nb,		/* Bytes available (multiple of 8) */
+	BYTE pat		/* 0x00:Free or 0xFF:In use */
+)
+{
+	UINT i = 0;
+	QWORD w = pat ? ~(QWORD)0 : 0;
+
+	for ( ; i < nb && ld_qword(p + i) == w; i += 8) ;
+	return i;
+}
+
+
+static DWORD find_bitmap (	/* 0:Not found, 2..:Cluster block found, 0xFFFFFFFF:Disk error */
+	FATFS* fs,	/* Filesystem object */
+	DWORD clst,	/* Cluster number to scan from */
+	DWORD ncl	/* Number of contiguous clusters to find (1..) */
+)
+{
+	QWORD w;
+	UINT i, bv;
+	DWORD val, scl, ctr, nbit, end, n, r;
+	LBA_t sect;
+	FRESULT res;
+	BYTE *p;
+
+
+	nbit = fs->n_fatent - 2;	/* Number of bits in the bitmap */
+	clst -= 2;	/* The first bit in the bitmap corresponds to cluster #2 */
+	if (clst >= nbit) clst = 0;
+	scl = val = clst; ctr = 0;
+	end = nbit;	/* Scan to the end of the bitmap, then from the top to clst */
+	for (;;) {
+#if FF_BITMAP_MIRROR
+		if (fs->bm_buf) {
+			p = fs->bm_buf + val / 8 / SS(fs) * SS(fs);	/* The sector in the mirror */
+		} else
+#endif
+		{
+			sect = fs->bitbase + val / 8 / SS(fs);
+#if FF_WIN_CACHE > 1
+			res = prefetch_window(fs, sect, (UINT)(fs->bitbase + (end - 1) / 8 / SS(fs) + 1 - sect));
+#else
+			res = move_window(fs, sect);
+#endif
+			if (res != FR_OK) return 0xFFFFFFFF;
+			p = fs->win;
+		}
+		do {
+			i = val / 8 % SS(fs) & ~7;	/* Offset of the 64-bit word holding the bit */
+			if (val % 64 == 0 && (p[i] == 0 || p[i] == 0xFF)	/* At the top of a word full or empty so far? */
+				&& (n = span_bitmap(p + i, SS(fs) - i, p[i]) * 8) != 0) {
+				bv = p[i] & 1;		/* Take the whole span as one run */
+				if (n > end - val) n = end - val;
+				w = bv ? ~(QWORD)0 : 0;
+			} else {
+				w = ld_qword(p + i) >> (val % 64);	/* Bits from val to the end of the word */
+				n = 64 - val % 64;
+				if (n > end - val) n = end - val;
+				bv = (UINT)w & 1;
+			}
+			for (;;) {	/* Process the runs of the same bit value */
+				if (bv) {	/* Clusters in use: restart the scan after them */
+					r = (~w == 0) ? 64 : ctz64(~w);
+					if (r > n || n > 64) r = n;
+					scl = val + r; ctr = 0;
+				} else {	/* Free clusters: check if the run length is sufficient */
+					r = (w == 0) ? 64 : ctz64(w);
+					if (r > n || n > 64) r = n;
+					if (ctr + r >= ncl) return scl + 2;
+					ctr += r;
+				}
+				val += r; n -= r;
+				if (n == 0) break;
+				w >>= r; bv ^= 1;
+			}
+			if (val == end) {
+				if (end != nbit || clst == 0) return 0;	/* All cluster scanned? */
+				val = scl = ctr = 0; end = clst;	/* Wrap around without joining the runs at the ends */
+				break;
+			}
+		} while (val % (SS(fs) * 8) != 0);	/* Until the end of the sector */
+	}
+}
+#endif
 
 /*----------------------------------------*/
 /* Set/Clear a block of allocation bitmap */
@@ -1370,6 +1883,9 @@ static FRESULT change_bitmap (
 	LBA_t sect;
 
 
+#if FF_BITMAP_MIRROR
+	if (fs->bm_buf) return bm_change(fs, clst, ncl, bv);	/* Change it in the mirror */
+#endif
 	clst -= 2;	/* The first bit corresponds to cluster #2 */
 	sect = fs->bitbase + clst / 8 / SS(fs);	/* Sector address */
 	i = clst / 8 % SS(fs);					/* Byte offset in the sector */
@@ -1650,18 +2166,225 @@ static DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
 	FATFS *fs = fp->obj.fs;
 
 
-	tbl = fp->cltbl + 1;	/* Top of CLMT */
-	cl = (DWORD)(ofs / SS(fs) / fs->csize);	/* Cluster order from top of the file */
-	for (;;) {
-		ncl = *tbl++;			/* Number of cluters in the fragment */
-		if (ncl == 0) return 0;	/* End of table? (error) */
-		if (cl < ncl) break;	/* In this fragment? */
-		cl -= ncl; tbl++;		/* Next fragment */
+	tbl = fp->cltbl + 1;	/* Top of CLMT */
+	cl = (DWORD)(ofs / SS(fs) / fs->csize);	/* Cluster order from top of the file */
+	for (;;) {
+		ncl = *tbl++;			/* Number of cluters in the fragment */
+		if (ncl == 0) return 0;	/* End of table? (error) */
+		if (cl < ncl) break;	/* In this fragment? */
+		cl -= ncl; tbl++;		/* Next fragment */
+	}
+	return cl + *tbl;	/* Return the cluster number */
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Create link map table of the file                      */
+/*-----------------------------------------------------------------------*/
+
+static FRESULT create_clmt (	/* FR_OK, FR_NOT_ENOUGH_CORE (size required in tbl[0]), FR_INT_ERR or FR_DISK_ERR */
+	FIL* fp,		/* Pointer to the file object */
+	DWORD* tbl		/* Table to fill in, tbl[0] holds its size in items */
+)
+{
+	DWORD cl, pcl, ncl, tcl, tlen, ulen, *t;
+	FATFS *fs = fp->obj.fs;
+
+
+	t = tbl;
+	tlen = *t++; ulen = 2;	/* Given table size and required table size */
+	cl = fp->obj.sclust;		/* Origin of the chain */
+#if FF_FS_EXFAT
+	if (cl != 0 && fs->fs_type == FS_EXFAT && fp->obj.stat == 2 && fp->obj.objsize != 0) {	/* Contiguous: a single fragment without following the chain */
+		ulen += 2;
+		if (ulen <= tlen) {
+			*t++ = (DWORD)((fp->obj.objsize - 1) / SS(fs) / fs->csize) + 1; *t++ = cl;
+		}
+		cl = 0;
+	}
+#endif
+	if (cl != 0) {
+		do {
+			/* Get a fragment */
+			tcl = cl; ncl = 0; ulen += 2;	/* Top, length and used items */
+			do {
+				pcl = cl; ncl++;
+				cl = get_fat(&fp->obj, cl);
+				if (cl <= 1) return FR_INT_ERR;
+				if (cl == 0xFFFFFFFF) return FR_DISK_ERR;
+			} while (cl == pcl + 1);
+			if (ulen <= tlen) {		/* Store the length and top of the fragment */
+				*t++ = ncl; *t++ = tcl;
+			}
+		} while (cl < fs->n_fatent);	/* Repeat until end of chain */
+	}
+	*tbl = ulen;	/* Number of items used */
+	if (ulen > tlen) return FR_NOT_ENOUGH_CORE;	/* Given table size is smaller than required */
+	*t = 0;		/* Terminate table */
+	return FR_OK;
+}
+
+
+#if FF_FASTSEEK_AUTO
+static void auto_clmt (	/* Set up fast seek with a table sized to the file, stays in normal seek without memory */
+	FIL* fp		/* Pointer to the file object */
+)
+{
+	DWORD n = 8, *tbl;	/* Room for three fragments at first */
+	FRESULT res;
+
+
+	tbl = ff_memalloc(n * sizeof (DWORD));
+	if (!tbl) return;
+	tbl[0] = n;
+	res = create_clmt(fp, tbl);
+	if (res == FR_NOT_ENOUGH_CORE) {	/* More fragments: build it again at the size found */
+		n = tbl[0];
+		ff_memfree(tbl);
+		tbl = ff_memalloc(n * sizeof (DWORD));
+		if (!tbl) return;
+		tbl[0] = n;
+		res = create_clmt(fp, tbl);
+	}
+	if (res != FR_OK) {
+		ff_memfree(tbl);
+		return;
+	}
+	fp->cltbl = fp->cltbl_auto = tbl;
+}
+#endif
+
+#endif	/* FF_USE_FASTSEEK */
+
+
+
+
+#if FF_READ_AHEAD
+/*-----------------------------------------------------------------------*/
+/* File handling - Read ahead of sequential reading                      */
+/*-----------------------------------------------------------------------*/
+
+static DRESULT ra_wait (	/* Wait for a read in flight */
+	DWORD token		/* Token of the read */
+)
+{
+	DRESULT dres;
+
+
+	while ((dres = disk_poll(RaPdrv, token)) == RES_NOTRDY) ;
+	return dres;
+}
+
+
+static void ra_release (void)	/* Take the buffers back from their file */
+{
+	UINT i;
+
+
+	for (i = 0; i < FF_READ_AHEAD; i++) {
+		if (RaLen[i]) {
+			ra_wait(RaTok[i]);	/* The drive may still be filling it */
+			RaLen[i] = 0;
+		}
+	}
+	RaFil = 0;
+}
+
+
+static UINT ra_copy (	/* Returns the number of bytes copied (0:not prefetched) */
+	FIL* fp,		/* Pointer to the file object */
+	BYTE* dst,		/* Destination buffer */
+	UINT btr		/* Number of bytes to copy from fptr, whole sectors */
+)
+{
+	UINT i, ofs, n;
+
+
+	if (RaFil != fp || RaId != fp->obj.id) return 0;
+	for (i = 0; i < FF_READ_AHEAD; i++) {
+		if (RaLen[i] && fp->fptr >= RaOfs[i] && fp->fptr - RaOfs[i] < RaLen[i]) break;
+	}
+	if (i == FF_READ_AHEAD) return 0;
+	if (ra_wait(RaTok[i]) != RES_OK) {	/* Failed prefetch: leave it to disk_read() */
+		RaLen[i] = 0;
+		return 0;
+	}
+	ofs = (UINT)(fp->fptr - RaOfs[i]);
+	n = RaLen[i] - ofs;
+	if (n > btr) n = btr;
+	mem_cpy(dst, (BYTE*)RaBuf[i] + ofs, n);
+	if (ofs + n == RaLen[i]) RaLen[i] = 0;	/* Used up */
+	return n;
+}
+
+
+static void ra_fill (	/* Keep reads of the data following fptr in flight */
+	FIL* fp		/* Pointer to the file object, fp->clust holds the data before fptr */
+)
+{
+	FATFS *fs = fp->obj.fs;
+	FSIZE_t end, base, top;
+	DWORD clst, bcs;
+	LBA_t sect;
+	UINT i, n;
+
+
+	if (fp->fptr == 0 || fp->fptr >= fp->obj.objsize) return;
+	if (RaFil != fp || RaId != fp->obj.id) {	/* Take the buffers over */
+		if (RaFil) ra_release();
+		RaFil = fp; RaId = fp->obj.id; RaPdrv = fs->pdrv;
+	}
+	end = fp->fptr / SS(fs) * SS(fs);
+	for (n = 1; n; ) {		/* Find the end of the prefetched data contiguous from fptr */
+		for (n = i = 0; i < FF_READ_AHEAD; i++) {
+			if (RaLen[i] && RaOfs[i] <= end && RaOfs[i] + RaLen[i] > end) {
+				end = RaOfs[i] + RaLen[i]; n = 1;
+			}
+		}
+	}
+	for (i = 0; i < FF_READ_AHEAD; i++) {	/* Free the buffers out of it */
+		if (RaLen[i] && (RaOfs[i] + RaLen[i] <= fp->fptr || RaOfs[i] >= end)) {
+			ra_wait(RaTok[i]);
+			RaLen[i] = 0;
+		}
+	}
+
+	bcs = (DWORD)fs->csize * SS(fs);	/* Cluster size [byte] */
+	top = (fp->obj.objsize + SS(fs) - 1) / SS(fs) * SS(fs);	/* End of the file data on the disk */
+	clst = fp->clust;
+	base = (fp->fptr - 1) / bcs * bcs;	/* File offset of fp->clust */
+	for (i = 0; i < FF_READ_AHEAD && end < top; i++) {
+		if (RaLen[i]) continue;
+#if FF_USE_FASTSEEK
+		if (fp->cltbl) {
+			clst = clmt_clust(fp, end);		/* Get cluster# from the CLMT */
+			base = end / bcs * bcs;
+			if (clst < 2) return;
+		} else
+#endif
+		{
+			while (end - base >= bcs) {		/* Follow the cluster chain up to end */
+				clst = get_fat(&fp->obj, clst);
+				base += bcs;
+				if (clst < 2 || clst == 0xFFFFFFFF) return;
+			}
+		}
+		sect = clst2sect(fs, clst);
+		if (sect == 0) return;
+		sect += (DWORD)((end - base) / SS(fs));
+		n = FF_READ_AHEAD_SIZE;				/* Read up to the cluster end and the file end */
+		if (n > base + bcs - end) n = (UINT)(base + bcs - end);
+		if (n > top - end) n = (UINT)(top - end);
+		if (disk_read_async(fs->pdrv, (BYTE*)RaBuf[i], sect, n / SS(fs), &RaTok[i]) != RES_OK) return;
+		RaOfs[i] = end;
+		RaLen[i] = n;
+		end += n;
 	}
-	return cl + *tbl;	/* Return the cluster number */
 }
 
-#endif	/* FF_USE_FASTSEEK */
+#endif	/* FF_READ_AHEAD */
 
 
 
@@ -1683,7 +2406,10 @@ static FRESULT dir_clear (	/* Returns FR_OK or FR_DISK_ERR */
 
 	if (sync_window(fs) != FR_OK) return FR_DISK_ERR;	/* Flush disk access window */
 	sect = clst2sect(fs, clst);		/* Top of the cluster */
-	fs->winsect = sect;				/* Set window to top of the cluster */
+#if FF_WIN_CACHE > 1
+	wc_discard(fs, sect, fs->csize);	/* Cached sectors of the cluster are about to be stale */
+#endif
+	set_winsect(fs, sect);			/* Set window to top of the cluster */
 	mem_set(fs->win, 0, sizeof fs->win);	/* Clear window buffer */
 #if FF_USE_LFN == 3		/* Quick table clear by using multi-secter write */
 	/* Allocate a temporary buffer */
@@ -1814,6 +2540,130 @@ static FRESULT dir_next (	/* FR_OK(0):succeeded, FR_NO_FILE:End of table, FR_DEN
 
 
 
+#if FF_FS_EXFAT && FF_DIR_INDEX
+/*-----------------------------------------------------------------------*/
+/* exFAT: Directory index                                                */
+/*-----------------------------------------------------------------------*/
+/* The entry blocks of an indexed directory are held in an open addressing */
+/* hash table keyed by the name hash stored in the stream extension entry. */
+
+static int di_hit (	/* Index of the directory (-1:not indexed) */
+	DIR* dp			/* Directory object */
+)
+{
+	FATFS *fs = dp->obj.fs;
+	DWORD dir = DI_KEY(fs, dp);
+	int i;
+
+
+	for (i = 0; i < FF_DIR_INDEX_DIRS; i++) {
+		if (fs->di_stat[i] != 0 && fs->di_dir[i] == dir) {
+			fs->di_last[i] = ++fs->di_tick;
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+static int di_add (	/* 1:Added, 0:Index is full */
+	FATFS* fs,		/* Filesystem object */
+	int x,			/* Index */
+	WORD hash,		/* Name hash */
+	DWORD ofs		/* Offset of the entry block in the directory */
+)
+{
+	DWORD *tofs = fs->di_ofs + x * FF_DIR_INDEX;
+	UINT i;
+
+
+	for (i = hash & (FF_DIR_INDEX - 1); tofs[i] != 0 && tofs[i] != DI_DEL; i = (i + 1) & (FF_DIR_INDEX - 1)) ;
+	if (tofs[i] == 0) {	/* Taking an empty slot */
+		if (fs->di_used[x] >= FF_DIR_INDEX / 4 * 3) return 0;	/* Keep the probe sequences short */
+		fs->di_used[x]++;
+	}
+	tofs[i] = ofs + 1;
+	fs->di_hash[x * FF_DIR_INDEX + i] = hash;
+	return 1;
+}
+
+
+#if !FF_FS_READONLY
+static void di_del (
+	FATFS* fs,		/* Filesystem object */
+	int x,			/* Index */
+	WORD hash,		/* Name hash */
+	DWORD ofs		/* Offset of the entry block in the directory */
+)
+{
+	DWORD *tofs = fs->di_ofs + x * FF_DIR_INDEX;
+	UINT i;
+
+
+	for (i = hash & (FF_DIR_INDEX - 1); tofs[i] != 0; i = (i + 1) & (FF_DIR_INDEX - 1)) {
+		if (tofs[i] == ofs + 1) {
+			tofs[i] = DI_DEL;		/* Leave it deleted to keep the probe sequences */
+			if (fs->di_free[x] > ofs) fs->di_free[x] = ofs;
+			return;
+		}
+	}
+	fs->di_stat[x] = 0;	/* Not in the index, discard it */
+}
+#endif
+
+
+static FRESULT di_build (	/* FR_OK(0):succeeded (see fs->di_stat), !=0:error */
+	DIR* dp					/* Directory object to be indexed (moved) */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	DWORD fofs = DI_DEL;
+	BYTE type;
+	int x, i;
+
+
+	for (x = 0, i = 1; i < FF_DIR_INDEX_DIRS; i++) {	/* Take an unused or the least recently used index */
+		if (fs->di_stat[x] == 0) break;
+		if (fs->di_stat[i] == 0 || fs->di_last[i] - fs->di_last[x] > 0x7FFFFFFF) x = i;
+	}
+	fs->di_stat[x] = 0;
+	fs->di_dir[x] = DI_KEY(fs, dp);
+	fs->di_last[x] = ++fs->di_tick;
+	fs->di_used[x] = 0;
+	fs->di_free[x] = DI_DEL;
+	mem_set(fs->di_ofs + x * FF_DIR_INDEX, 0, FF_DIR_INDEX * sizeof (DWORD));
+	res = dir_sdi(dp, 0);
+	while (res == FR_OK) {
+		res = move_window(fs, dp->sect);
+		if (res != FR_OK) break;
+		type = dp->dir[XDIR_Type];
+		if (!(type & 0x80)) {			/* A free entry */
+			if (fs->di_free[x] == DI_DEL) fs->di_free[x] = dp->dptr;
+			if (type == 0) break;		/* End of the directory */
+		} else if (type == ET_FILEDIR) {
+			fofs = dp->dptr;
+		} else if (type == ET_STREAM && fofs + SZDIRE == dp->dptr) {	/* Stream extension entry of the block */
+			if (!di_add(fs, x, ld_word(dp->dir + XDIR_NameHash - SZDIRE), fofs)) {
+				fs->di_stat[x] = 2;		/* Too many items, the directory will be scanned */
+				return FR_OK;
+			}
+		}
+		res = dir_next(dp, 0);
+	}
+	if (res == FR_NO_FILE) res = FR_OK;	/* End of the last cluster */
+	if (res == FR_OK) {
+		if (fs->di_free[x] == DI_DEL) fs->di_free[x] = dp->dptr;	/* No free entry, start at the last one */
+		fs->di_stat[x] = 1;
+	}
+	return res;
+}
+
+#endif	/* FF_FS_EXFAT && FF_DIR_INDEX */
+
+
+
+
 #if !FF_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Reserve a block of directory entries             */
@@ -1827,9 +2677,21 @@ static FRESULT dir_alloc (	/* FR_OK(0):succeeded, !=0:error */
 	FRESULT res;
 	UINT n;
 	FATFS *fs = dp->obj.fs;
+	DWORD ofs = 0;
+#if FF_FS_EXFAT && FF_DIR_INDEX
+	int x = -1, skip = 0;
 
+	if (fs->fs_type == FS_EXFAT) {
+		x = di_hit(dp);
+		if (x >= 0 && fs->di_stat[x] == 1) {
+			ofs = fs->di_free[x];	/* The directory has no free entry before the hint */
+		} else {
+			x = -1;
+		}
+	}
+#endif
 
-	res = dir_sdi(dp, 0);
+	res = dir_sdi(dp, ofs);
 	if (res == FR_OK) {
 		n = 0;
 		do {
@@ -1842,6 +2704,9 @@ static FRESULT dir_alloc (	/* FR_OK(0):succeeded, !=0:error */
 #endif
 				if (++n == nent) break;	/* A block of contiguous free entries is found */
 			} else {
+#if FF_FS_EXFAT && FF_DIR_INDEX
+				if (n) skip = 1;		/* A short block of free entries is left behind */
+#endif
 				n = 0;					/* Not a blank entry. Restart to search */
 			}
 			res = dir_next(dp, 1);
@@ -1849,6 +2714,9 @@ static FRESULT dir_alloc (	/* FR_OK(0):succeeded, !=0:error */
 	}
 
 	if (res == FR_NO_FILE) res = FR_DENIED;	/* No directory entry to allocate */
+#if FF_FS_EXFAT && FF_DIR_INDEX
+	if (res == FR_OK && x >= 0 && !skip) fs->di_free[x] = dp->dptr;	/* Move the hint to the last allocated entry */
+#endif
 	return res;
 }
 
@@ -2435,6 +3303,60 @@ static FRESULT dir_read (
 
 
 
+#if FF_FS_EXFAT
+/*-----------------------------------------------------------------------*/
+/* exFAT: Compare the name in the entry block with the name to find      */
+/*-----------------------------------------------------------------------*/
+
+static int xname_cmp (	/* 1:Matched, 0:Not matched */
+	FATFS* fs			/* Filesystem object with the entry block in dirbuf and the name in lfnbuf */
+)
+{
+	BYTE nc;
+	UINT di, ni;
+
+
+#if FF_MAX_LFN < 255
+	if (fs->dirbuf[XDIR_NumName] > FF_MAX_LFN) return 0;	/* Inaccessible object name */
+#endif
+	for (nc = fs->dirbuf[XDIR_NumName], di = SZDIRE * 2, ni = 0; nc; nc--, di += 2, ni++) {	/* Compare the name */
+		if ((di % SZDIRE) == 0) di += 2;
+		if (ff_wtoupper(ld_word(fs->dirbuf + di)) != ff_wtoupper(fs->lfnbuf[ni])) break;
+	}
+	return (nc == 0 && !fs->lfnbuf[ni]);
+}
+
+
+
+#if FF_DIR_INDEX
+static FRESULT di_find (	/* FR_OK(0):found, FR_NO_FILE:not found, FR_INT_ERR:index is stale, others:error */
+	DIR* dp,				/* Directory object with the name to find in fs->lfnbuf */
+	int x,					/* Index of the directory */
+	WORD hash				/* Name hash */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	DWORD *tofs = fs->di_ofs + x * FF_DIR_INDEX, ofs;
+	UINT i;
+
+
+	for (i = hash & (FF_DIR_INDEX - 1); (ofs = tofs[i]) != 0; i = (i + 1) & (FF_DIR_INDEX - 1)) {
+		if (ofs == DI_DEL || fs->di_hash[x * FF_DIR_INDEX + i] != hash) continue;
+		res = dir_sdi(dp, ofs - 1);
+		if (res == FR_OK) res = DIR_READ_FILE(dp);	/* Load the entry block */
+		if (res == FR_NO_FILE || (res == FR_OK && dp->blk_ofs != ofs - 1)) res = FR_INT_ERR;
+		if (res != FR_OK) return res;
+		if (xname_cmp(fs)) return FR_OK;
+	}
+	return FR_NO_FILE;
+}
+#endif
+
+#endif	/* FF_FS_EXFAT */
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Find an object in the directory                  */
 /*-----------------------------------------------------------------------*/
@@ -2454,20 +3376,27 @@ static FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 	if (res != FR_OK) return res;
 #if FF_FS_EXFAT
 	if (fs->fs_type == FS_EXFAT) {	/* On the exFAT volume */
-		BYTE nc;
-		UINT di, ni;
 		WORD hash = xname_sum(fs->lfnbuf);		/* Hash value of the name to find */
 
-		while ((res = DIR_READ_FILE(dp)) == FR_OK) {	/* Read an item */
-#if FF_MAX_LFN < 255
-			if (fs->dirbuf[XDIR_NumName] > FF_MAX_LFN) continue;			/* Skip comparison if inaccessible object name */
+#if FF_DIR_INDEX
+		int x = di_hit(dp);
+
+		if (x < 0) {
+			res = di_build(dp);			/* Index the directory */
+			if (res != FR_OK) return res;
+			x = di_hit(dp);
+		}
+		if (x >= 0 && fs->di_stat[x] == 1) {
+			res = di_find(dp, x, hash);
+			if (res != FR_INT_ERR) return res;
+			fs->di_stat[x] = 0;			/* Discard the stale index and scan the directory */
+		}
+		res = dir_sdi(dp, 0);
+		if (res != FR_OK) return res;
 #endif
+		while ((res = DIR_READ_FILE(dp)) == FR_OK) {	/* Read an item */
 			if (ld_word(fs->dirbuf + XDIR_NameHash) != hash) continue;	/* Skip comparison if hash mismatched */
-			for (nc = fs->dirbuf[XDIR_NumName], di = SZDIRE * 2, ni = 0; nc; nc--, di += 2, ni++) {	/* Compare the name */
-				if ((di % SZDIRE) == 0) di += 2;
-				if (ff_wtoupper(ld_word(fs->dirbuf + di)) != ff_wtoupper(fs->lfnbuf[ni])) break;
-			}
-			if (nc == 0 && !fs->lfnbuf[ni]) break;	/* Name matched? */
+			if (xname_cmp(fs)) break;	/* Name matched? */
 		}
 		return res;
 	}
@@ -2529,6 +3458,9 @@ static FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too
 #if FF_USE_LFN		/* LFN configuration */
 	UINT n, nlen, nent;
 	BYTE sn[12], sum;
+#if FF_FS_EXFAT && FF_DIR_INDEX
+	int x;
+#endif
 
 
 	if (dp->fn[NSFLAG] & (NS_DOT | NS_NONAME)) return FR_INVALID_NAME;	/* Check name validity */
@@ -2562,6 +3494,10 @@ static FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too
 		}
 
 		create_xdir(fs->dirbuf, fs->lfnbuf);	/* Create on-memory directory block to be written later */
+#if FF_DIR_INDEX
+		x = di_hit(dp);
+		if (x >= 0 && fs->di_stat[x] == 1 && !di_add(fs, x, ld_word(fs->dirbuf + XDIR_NameHash), dp->blk_ofs)) fs->di_stat[x] = 0;	/* Add it to the index, discard the index if full */
+#endif
 		return FR_OK;
 	}
 #endif
@@ -2634,6 +3570,10 @@ static FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 	FATFS *fs = dp->obj.fs;
 #if FF_USE_LFN		/* LFN configuration */
 	DWORD last = dp->dptr;
+#if FF_FS_EXFAT && FF_DIR_INDEX
+	WORD hash = 0;
+	int x;
+#endif
 
 	res = (dp->blk_ofs == 0xFFFFFFFF) ? FR_OK : dir_sdi(dp, dp->blk_ofs);	/* Goto top of the entry block if LFN is exist */
 	if (res == FR_OK) {
@@ -2641,6 +3581,9 @@ static FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 			res = move_window(fs, dp->sect);
 			if (res != FR_OK) break;
 			if (FF_FS_EXFAT && fs->fs_type == FS_EXFAT) {	/* On the exFAT volume */
+#if FF_FS_EXFAT && FF_DIR_INDEX
+				if (dp->dptr == dp->blk_ofs + SZDIRE) hash = ld_word(dp->dir + XDIR_NameHash - SZDIRE);	/* Name hash in the stream extension entry */
+#endif
 				dp->dir[XDIR_Type] &= 0x7F;	/* Clear the entry InUse flag. */
 			} else {									/* On the FAT/FAT32 volume */
 				dp->dir[DIR_Name] = DDEM;	/* Mark the entry 'deleted'. */
@@ -2651,6 +3594,9 @@ static FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 		} while (res == FR_OK);
 		if (res == FR_NO_FILE) res = FR_INT_ERR;
 	}
+#if FF_FS_EXFAT && FF_DIR_INDEX
+	if (res == FR_OK && fs->fs_type == FS_EXFAT && (x = di_hit(dp)) >= 0 && fs->di_stat[x] == 1) di_del(fs, x, hash, dp->blk_ofs);	/* Remove it from the index */
+#endif
 #else			/* Non LFN configuration */
 
 	res = move_window(fs, dp->sect);
@@ -3295,7 +4241,11 @@ static UINT check_fs (	/* 0:FAT VBR, 1:exFAT VBR, 2:Valid BS but not FAT, 3:Inva
 	LBA_t sect			/* Sector to load and check if it is an FAT-VBR or not */
 )
 {
+#if FF_WIN_CACHE > 1
+	wc_reset(fs);									/* Invalidate cache */
+#else
 	fs->wflag = 0; fs->winsect = (LBA_t)0 - 1;		/* Invaidate window */
+#endif
 	if (move_window(fs, sect) != FR_OK) return 4;	/* Load the boot sector */
 
 	if (ld_word(fs->win + BS_55AA) != 0xAA55) return 3;	/* Check boot signature (always here regardless of the sector size) */
@@ -3410,6 +4360,9 @@ static FRESULT mount_volume (	/* FR_OK(0): successful, !=0: an error occurred */
 	/* Following code attempts to mount the volume. (find a FAT volume, analyze the BPB and initialize the filesystem object) */
 
 	fs->fs_type = 0;					/* Clear the filesystem object */
+#if FF_FS_EXFAT && !FF_FS_READONLY && FF_BITMAP_MIRROR
+	fs->bm_buf = 0;						/* No bitmap mirror until an exFAT volume is found */
+#endif
 	fs->pdrv = LD2PD(vol);				/* Volume hosting physical drive */
 	stat = disk_initialize(fs->pdrv);	/* Initialize the physical drive */
 	if (stat & STA_NOINIT) { 			/* Check if the initialization succeeded */
@@ -3490,6 +4443,13 @@ static FRESULT mount_volume (	/* FR_OK(0): successful, !=0: an error occurred */
 
 #if !FF_FS_READONLY
 		fs->last_clst = fs->free_clst = 0xFFFFFFFF;		/* Initialize cluster allocation information */
+#if FF_BITMAP_MIRROR
+		if (bm_load(fs, (BYTE*)BmMirror[vol]) != FR_OK) return FR_DISK_ERR;	/* Load the bitmap into the mirror if it fits */
+#endif
+#endif
+#if FF_DIR_INDEX
+		fs->di_ofs = DiOfs[vol]; fs->di_hash = DiHash[vol];
+		mem_set(fs->di_stat, 0, sizeof fs->di_stat);	/* No directory is indexed yet */
 #endif
 		fmt = FS_EXFAT;			/* FAT sub-type */
 	} else
@@ -3829,6 +4789,9 @@ FRESULT f_open (
 			}
 #if FF_USE_FASTSEEK
 			fp->cltbl = 0;			/* Disable fast seek mode */
+#if FF_FASTSEEK_AUTO
+			fp->cltbl_auto = 0;
+#endif
 #endif
 			fp->obj.fs = fs;	 	/* Validate the file object */
 			fp->obj.id = fs->id;
@@ -3836,6 +4799,11 @@ FRESULT f_open (
 			fp->err = 0;			/* Clear error flag */
 			fp->sect = 0;			/* Invalidate current data sector */
 			fp->fptr = 0;			/* Set file pointer top of the file */
+#if FF_READ_AHEAD
+			if (RaFil == fp) ra_release();	/* Buffers left by a file object not closed */
+			fp->ra_next = 0;
+			fp->ra_run = 0;
+#endif
 #if !FF_FS_READONLY
 #if !FF_FS_TINY
 			mem_set(fp->buf, 0, sizeof fp->buf);	/* Clear sector buffer */
@@ -3869,6 +4837,9 @@ FRESULT f_open (
 	}
 
 	if (res != FR_OK) fp->obj.fs = 0;	/* Invalidate file object on error */
+#if FF_USE_FASTSEEK && FF_FASTSEEK_AUTO
+	if (res == FR_OK && !(mode & FA_WRITE) && fp->obj.objsize >= FF_FASTSEEK_AUTO) auto_clmt(fp);	/* Large file for reading: fast seek */
+#endif
 
 	LEAVE_FF(fs, res);
 }
@@ -3880,11 +4851,12 @@ FRESULT f_open (
 /* Read File                                                             */
 /*-----------------------------------------------------------------------*/
 
-FRESULT f_read (
+static FRESULT read_file (
 	FIL* fp, 	/* Pointer to the file object */
 	void* buff,	/* Pointer to data buffer */
 	UINT btr,	/* Number of bytes to read */
-	UINT* br	/* Pointer to number of bytes read */
+	UINT* br,	/* Pointer to number of bytes read */
+	DWORD* token	/* Pointer to the token of the last sectors read directly (0:none in flight) */
 )
 {
 	FRESULT res;
@@ -3897,11 +4869,19 @@ FRESULT f_read (
 
 
 	*br = 0;	/* Clear read byte counter */
+	*token = 0;	/* Nothing to wait for */
 	res = validate(&fp->obj, &fs);				/* Check validity of the file object */
 	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
 	if (!(fp->flag & FA_READ)) LEAVE_FF(fs, FR_DENIED); /* Check access mode */
 	remain = fp->obj.objsize - fp->fptr;
 	if (btr > remain) btr = (UINT)remain;		/* Truncate btr by remaining bytes */
+#if FF_READ_AHEAD
+	if (fp->fptr == fp->ra_next) {				/* Count sequential reads */
+		if (fp->ra_run < 255) fp->ra_run++;
+	} else {
+		fp->ra_run = 0;
+	}
+#endif
 
 	for ( ;  btr;								/* Repeat until btr bytes read */
 		btr -= rcnt, *br += rcnt, rbuff += rcnt, fp->fptr += rcnt) {
@@ -3932,6 +4912,16 @@ FRESULT f_read (
 				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
 					cc = fs->csize - csect;
 				}
+#if FF_READ_AHEAD
+				if (!(fp->flag & FA_WRITE)) {	/* Read-only file: no dirty cache to merge */
+					rcnt = ra_copy(fp, rbuff, SS(fs) * cc);	/* Take prefetched data if any */
+					if (rcnt == 0) {			/* Else leave the read in flight */
+						if (disk_read_async(fs->pdrv, rbuff, sect, cc, token) != RES_OK) ABORT(fs, FR_DISK_ERR);
+						rcnt = SS(fs) * cc;
+					}
+					continue;
+				}
+#endif
 				if (disk_read(fs->pdrv, rbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
 #if !FF_FS_READONLY && FF_FS_MINIMIZE <= 2		/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if FF_FS_TINY
@@ -3954,6 +4944,9 @@ FRESULT f_read (
 					if (disk_write(fs->pdrv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
 					fp->flag &= (BYTE)~FA_DIRTY;
 				}
+#endif
+#if FF_READ_AHEAD
+				if ((fp->flag & FA_WRITE) || ra_copy(fp, fp->buf, SS(fs)) == 0)
 #endif
 				if (disk_read(fs->pdrv, fp->buf, sect, 1) != RES_OK)	ABORT(fs, FR_DISK_ERR);	/* Fill sector cache */
 			}
@@ -3970,10 +4963,39 @@ FRESULT f_read (
 #endif
 	}
 
+#if FF_READ_AHEAD
+	fp->ra_next = fp->fptr;
+	if (fp->ra_run >= 2 && !(fp->flag & FA_WRITE)) ra_fill(fp);	/* Sequential reading: stay ahead of it */
+#endif
+
 	LEAVE_FF(fs, FR_OK);
 }
 
 
+FRESULT f_read (
+	FIL* fp, 	/* Pointer to the file object */
+	void* buff,	/* Pointer to data buffer */
+	UINT btr,	/* Number of bytes to read */
+	UINT* br	/* Pointer to number of bytes read */
+)
+{
+	FRESULT res;
+	DWORD token;
+	DRESULT dres;
+
+
+	res = read_file(fp, buff, btr, br, &token);
+	if (token != 0) {	/* Wait for the direct reads, also after an error */
+		while ((dres = disk_poll(fp->obj.fs->pdrv, token)) == RES_NOTRDY) ;
+		if (dres != RES_OK && res == FR_OK) {
+			fp->err = (BYTE)FR_DISK_ERR;
+			res = FR_DISK_ERR;
+		}
+	}
+	return res;
+}
+
+
 
 
 #if !FF_FS_READONLY
@@ -3981,11 +5003,12 @@ FRESULT f_read (
 /* Write File                                                            */
 /*-----------------------------------------------------------------------*/
 
-FRESULT f_write (
+static FRESULT write_file (
 	FIL* fp,			/* Pointer to the file object */
 	const void* buff,	/* Pointer to the data to be written */
 	UINT btw,			/* Number of bytes to write */
-	UINT* bw			/* Pointer to number of bytes written */
+	UINT* bw,			/* Pointer to number of bytes written */
+	DWORD* token		/* Pointer to the token of the last sectors written directly (0:wait as f_write) */
 )
 {
 	FRESULT res;
@@ -3997,6 +5020,7 @@ FRESULT f_write (
 
 
 	*bw = 0;	/* Clear write byte counter */
+	if (token) *token = 0;	/* Nothing to wait for */
 	res = validate(&fp->obj, &fs);			/* Check validity of the file object */
 	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
 	if (!(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);	/* Check access mode */
@@ -4048,7 +5072,11 @@ FRESULT f_write (
 				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
 					cc = fs->csize - csect;
 				}
+#if FF_USE_ASYNC_WRITE
+				if (disk_write_async(fs->pdrv, wbuff, sect, cc, token) != RES_OK) ABORT(fs, FR_DISK_ERR);
+#else
 				if (disk_write(fs->pdrv, wbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
+#endif
 #if FF_FS_MINIMIZE <= 2
 #if FF_FS_TINY
 				if (fs->winsect - sect < cc) {	/* Refill sector cache if it gets invalidated by the direct write */
@@ -4097,6 +5125,71 @@ FRESULT f_write (
 }
 
 
+FRESULT f_write (
+	FIL* fp,			/* Pointer to the file object */
+	const void* buff,	/* Pointer to the data to be written */
+	UINT btw,			/* Number of bytes to write */
+	UINT* bw			/* Pointer to number of bytes written */
+)
+{
+	return write_file(fp, buff, btw, bw, 0);
+}
+
+
+
+#if FF_USE_ASYNC_WRITE
+/*-----------------------------------------------------------------------*/
+/* Write File Asynchronously                                             */
+/*-----------------------------------------------------------------------*/
+/* Whole sectors are written straight from the buffer and f_write_async  */
+/* returns as soon as they are submitted. The buffer must be left as is  */
+/* until f_write_done() reports the token complete. Directory entry and  */
+/* FAT updates are written only after all data before them is complete.  */
+
+FRESULT f_write_async (
+	FIL* fp,			/* Pointer to the file object */
+	const void* buff,	/* Pointer to the data to be written */
+	UINT btw,			/* Number of bytes to write */
+	UINT* bw,			/* Pointer to number of bytes written */
+	DWORD* token		/* Pointer to the completion token (0:no write left in flight) */
+)
+{
+	return write_file(fp, buff, btw, bw, token);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Check Completion of an Asynchronous Write                             */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_write_done (	/* FR_OK:complete, FR_TIMEOUT:still in flight, FR_DISK_ERR:failed */
+	FIL* fp,			/* Pointer to the file object */
+	DWORD token			/* Token from f_write_async() */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DRESULT dres;
+
+
+	res = validate(&fp->obj, &fs);	/* Check validity of the file object */
+	if (res == FR_OK && token != 0) {
+		dres = disk_poll(fs->pdrv, token);
+		if (dres == RES_NOTRDY) {
+			res = FR_TIMEOUT;
+		} else if (dres != RES_OK) {
+			res = FR_DISK_ERR;
+		}
+	}
+
+	LEAVE_FF(fs, res);
+}
+
+#endif /* FF_USE_ASYNC_WRITE */
+
+
 
 
 /*-----------------------------------------------------------------------*/
@@ -4204,6 +5297,16 @@ FRESULT f_close (
 #else
 			fp->obj.fs = 0;	/* Invalidate file object */
 #endif
+#if FF_READ_AHEAD
+			if (RaFil == fp) ra_release();	/* Give back the prefetch buffers */
+#endif
+#if FF_USE_FASTSEEK && FF_FASTSEEK_AUTO
+			if (fp->cltbl_auto) {	/* Free the table built by f_open() */
+				if (fp->cltbl == fp->cltbl_auto) fp->cltbl = 0;
+				ff_memfree(fp->cltbl_auto);
+				fp->cltbl_auto = 0;
+			}
+#endif
 #if FF_FS_REENTRANT
 			unlock_fs(fs, FR_OK);		/* Unlock volume */
 #endif
@@ -4410,7 +5513,6 @@ FRESULT f_lseek (
 	LBA_t nsect;
 	FSIZE_t ifptr;
 #if FF_USE_FASTSEEK
-	DWORD cl, pcl, ncl, tcl, tlen, ulen, *tbl;
 	LBA_t dsc;
 #endif
 
@@ -4426,30 +5528,8 @@ FRESULT f_lseek (
 #if FF_USE_FASTSEEK
 	if (fp->cltbl) {	/* Fast seek */
 		if (ofs == CREATE_LINKMAP) {	/* Create CLMT */
-			tbl = fp->cltbl;
-			tlen = *tbl++; ulen = 2;	/* Given table size and required table size */
-			cl = fp->obj.sclust;		/* Origin of the chain */
-			if (cl != 0) {
-				do {
-					/* Get a fragment */
-					tcl = cl; ncl = 0; ulen += 2;	/* Top, length and used items */
-					do {
-						pcl = cl; ncl++;
-						cl = get_fat(&fp->obj, cl);
-						if (cl <= 1) ABORT(fs, FR_INT_ERR);
-						if (cl == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
-					} while (cl == pcl + 1);
-					if (ulen <= tlen) {		/* Store the length and top of the fragment */
-						*tbl++ = ncl; *tbl++ = tcl;
-					}
-				} while (cl < fs->n_fatent);	/* Repeat until end of chain */
-			}
-			*fp->cltbl = ulen;	/* Number of items used */
-			if (ulen <= tlen) {
-				*tbl = 0;		/* Terminate table */
-			} else {
-				res = FR_NOT_ENOUGH_CORE;	/* Given table size is smaller than required */
-			}
+			res = create_clmt(fp, fp->cltbl);
+			if (res == FR_INT_ERR || res == FR_DISK_ERR) ABORT(fs, res);
 		} else {						/* Fast seek */
 			if (ofs > fp->obj.objsize) ofs = fp->obj.objsize;	/* Clip offset at the file size */
 			fp->fptr = ofs;				/* Set file pointer */
@@ -4823,11 +5903,19 @@ FRESULT f_getfree (
 					sect = fs->bitbase;			/* Bitmap sector */
 					i = 0;						/* Offset in the sector */
 					do {	/* Counts numbuer of bits with zero in the bitmap */
-						if (i == 0) {
-							res = move_window(fs, sect++);
-							if (res != FR_OK) break;
+#if !FF_FS_READONLY && FF_BITMAP_MIRROR
+						if (fs->bm_buf) {	/* The mirror is up to date, the bitmap on the disk may not be */
+							bm = fs->bm_buf[(fs->n_fatent - 2 - clst) / 8];
+						} else
+#endif
+						{
+							if (i == 0) {
+								res = move_window(fs, sect++);
+								if (res != FR_OK) break;
+							}
+							bm = fs->win[i];
 						}
-						for (b = 8, bm = fs->win[i]; b && clst; b--, clst--) {
+						for (b = 8; b && clst; b--, clst--) {
 							if (!(bm & 1)) nfree++;
 							bm >>= 1;
 						}
@@ -4931,6 +6019,9 @@ FRESULT f_unlink (
 	FATFS *fs;
 #if FF_FS_EXFAT
 	FFOBJID obj;
+#endif
+#if FF_FS_EXFAT && FF_DIR_INDEX
+	int x;
 #endif
 	DEF_NAMBUF
 
@@ -4992,6 +6083,11 @@ FRESULT f_unlink (
 			}
 			if (res == FR_OK) {
 				res = dir_remove(&dj);			/* Remove the directory entry */
+#if FF_FS_EXFAT && FF_DIR_INDEX
+				for (x = 0; dclst != 0 && x < FF_DIR_INDEX_DIRS; x++) {
+					if (fs->di_dir[x] == dclst) fs->di_stat[x] = 0;	/* Discard the index of the removed directory */
+				}
+#endif
 				if (res == FR_OK && dclst != 0) {	/* Remove the cluster chain if exist */
 #if FF_FS_EXFAT
 					res = remove_chain(&obj, dclst, 0);
@@ -5599,6 +6695,39 @@ FRESULT f_expand (
 	LEAVE_FF(fs, res);
 }
 
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Get the Sector Extent of a Contiguous File                            */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_extent (
+	FIL* fp,		/* Pointer to the file object */
+	LBA_t* sect,	/* Pointer to receive the first sector of the file */
+	LBA_t* nsect	/* Pointer to receive the number of sectors allocated to the file */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	FSIZE_t csz;
+
+
+	res = validate(&fp->obj, &fs);		/* Check validity of the file object */
+	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);
+	if (fp->obj.sclust == 0) LEAVE_FF(fs, FR_DENIED);	/* No clusters allocated */
+#if FF_FS_EXFAT
+	if (fs->fs_type != FS_EXFAT || fp->obj.stat != 2) LEAVE_FF(fs, FR_DENIED);	/* Only exFAT records a contiguous chain */
+#else
+	LEAVE_FF(fs, FR_DENIED);
+#endif
+	csz = (FSIZE_t)fs->csize * SS(fs);	/* Cluster size */
+	*sect = clst2sect(fs, fp->obj.sclust);
+	*nsect = (LBA_t)((fp->obj.objsize + csz - 1) / csz) * fs->csize;
+
+	LEAVE_FF(fs, FR_OK);
+}
+
 #endif /* FF_USE_EXPAND && !FF_FS_READONLY */
 
 
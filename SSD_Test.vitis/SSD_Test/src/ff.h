@@ -173,6 +173,28 @@ typedef struct {
 #endif
 	LBA_t	winsect;		/* Current sector appearing in the win[] */
 	BYTE	win[FF_MAX_SS];	/* Disk access window for Directory, FAT (and file data at tiny cfg) */
+#if FF_WIN_CACHE > 1
+	DWORD	wc_clock;		/* Window move counter */
+	BYTE	wc_dirty[FF_WIN_CACHE];	/* Dirty flag of each cache line */
+	DWORD	wc_stamp[FF_WIN_CACHE];	/* Last use of each line, for LRU replacement */
+	LBA_t	wc_sect[FF_WIN_CACHE];	/* Sector in each line ((LBA_t)0 - 1:empty) */
+	BYTE	wc_buf[FF_WIN_CACHE][FF_MAX_SS];	/* Sector cache behind the win[] */
+	BYTE	wc_wbuf[FF_WIN_CACHE * FF_MAX_SS];	/* Gather buffer for writing back contiguous dirty lines */
+#endif
+#if FF_FS_EXFAT && !FF_FS_READONLY && FF_BITMAP_MIRROR
+	BYTE*	bm_buf;			/* Allocation bitmap mirror (0:bitmap is not mirrored) */
+	BYTE	bm_dirty[(FF_BITMAP_MIRROR / FF_MIN_SS + 7) / 8];	/* Dirty flag of each mirrored sector */
+#endif
+#if FF_FS_EXFAT && FF_DIR_INDEX
+	DWORD*	di_ofs;			/* Directory indexes: entry block offset + 1 of each slot */
+	WORD*	di_hash;		/* Directory indexes: name hash of each slot */
+	DWORD	di_tick;		/* Directory index use counter */
+	DWORD	di_dir[FF_DIR_INDEX_DIRS];	/* Start cluster of each indexed directory */
+	DWORD	di_used[FF_DIR_INDEX_DIRS];	/* Number of slots in use, deleted ones included */
+	DWORD	di_free[FF_DIR_INDEX_DIRS];	/* Offset in the directory before which no entry is free */
+	DWORD	di_last[FF_DIR_INDEX_DIRS];	/* Last use of each index */
+	BYTE	di_stat[FF_DIR_INDEX_DIRS];	/* Index status (0:none, 1:valid for di_dir, 2:di_dir is too large) */
+#endif
 } FATFS;
 
 
@@ -215,6 +237,13 @@ typedef struct {
 #endif
 #if FF_USE_FASTSEEK
 	DWORD*	cltbl;			/* Pointer to the cluster link map table (nulled on open, set by application) */
+#if FF_FASTSEEK_AUTO
+	DWORD*	cltbl_auto;		/* Cluster link map table built by f_open() (freed on close) */
+#endif
+#endif
+#if FF_READ_AHEAD
+	FSIZE_t	ra_next;		/* File pointer the next sequential read starts at */
+	BYTE	ra_run;			/* Number of sequential reads in a row */
 #endif
 #if !FF_FS_TINY
 	BYTE	buf[FF_MAX_SS];	/* File private data read/write window */
@@ -305,6 +334,8 @@ FRESULT f_open (FIL* fp, const TCHAR* path, BYTE mode);				/* Open or create a f
 FRESULT f_close (FIL* fp);											/* Close an open file object */
 FRESULT f_read (FIL* fp, void* buff, UINT btr, UINT* br);			/* Read data from the file */
 FRESULT f_write (FIL* fp, const void* buff, UINT btw, UINT* bw);	/* Write data to the file */
+FRESULT f_write_async (FIL* fp, const void* buff, UINT btw, UINT* bw, DWORD* token);	/* Write data to the file without waiting for it */
+FRESULT f_write_done (FIL* fp, DWORD token);						/* Check completion of an asynchronous write */
 FRESULT f_lseek (FIL* fp, FSIZE_t ofs);								/* Move file pointer of the file object */
 FRESULT f_truncate (FIL* fp);										/* Truncate the file */
 FRESULT f_sync (FIL* fp);											/* Flush cached data of the writing file */
@@ -327,6 +358,7 @@ FRESULT f_getlabel (const TCHAR* path, TCHAR* label, DWORD* vsn);	/* Get volume
 FRESULT f_setlabel (const TCHAR* label);							/* Set volume label */
 FRESULT f_forward (FIL* fp, UINT(*func)(const BYTE*,UINT), UINT btf, UINT* bf);	/* Forward data to the stream */
 FRESULT f_expand (FIL* fp, FSIZE_t fsz, BYTE opt);					/* Allocate a contiguous block to the file */
+FRESULT f_extent (FIL* fp, LBA_t* sect, LBA_t* nsect);				/* Get the sectors of a contiguous file */
 FRESULT f_mount (FATFS* fs, const TCHAR* path, BYTE opt);			/* Mount/Unmount a logical drive */
 FRESULT f_mkfs (const TCHAR* path, const MKFS_PARM* opt, void* work, UINT len);	/* Create a FAT volume */
 FRESULT f_fdisk (BYTE pdrv, const LBA_t ptbl[], void* work);		/* Divide a physical drive into some partitions */
@@ -366,7 +398,7 @@ WCHAR ff_oem2uni (WCHAR oem, WORD cp);	/* OEM code to Unicode conversion */
 WCHAR ff_uni2oem (DWORD uni, WORD cp);	/* Unicode to OEM code conversion */
 DWORD ff_wtoupper (DWORD uni);			/* Unicode upper-case conversion */
 #endif
-#if FF_USE_LFN == 3						/* Dynamic memory allocation */
+#if FF_USE_LFN == 3 || FF_FASTSEEK_AUTO	/* Dynamic memory allocation */
 void* ff_memalloc (UINT msize);			/* Allocate memory block */
 void ff_memfree (void* mblock);			/* Free memory block */
 #endif
@@ -42,12 +42,41 @@
 /* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
 
 
-#define FF_USE_FASTSEEK	0
+#define FF_USE_FASTSEEK	1
 /* This option switches fast seek function. (0:Disable or 1:Enable) */
 
 
-#define FF_USE_EXPAND	0
-/* This option switches f_expand function. (0:Disable or 1:Enable) */
+#define FF_FASTSEEK_AUTO	(64UL << 20)
+/* This option sets the file size in bytes from which f_open() builds the cluster link
+/  map table by itself when a file is opened for reading only. (0:Disable) The table
+/  is sized to the file's fragments, allocated with ff_memalloc() and freed at
+/  f_close(). Seeking and reading then find clusters without following the FAT chain.
+/  A contiguous exFAT file needs a single fragment. Needs FF_USE_FASTSEEK. */
+
+
+#define FF_USE_EXPAND	1
+/* This option switches f_expand() and f_extent() functions. (0:Disable or 1:Enable) */
+
+
+#define FF_USE_ASYNC_WRITE	1
+/* This option switches f_write_async() and f_write_done() functions. (0:Disable or
+/  1:Enable) Whole sectors are then written with disk_write_async(), and f_write()
+/  returns while up to the number of writes set with disk_ioctl(CTRL_WRITE_BEHIND)
+/  are still in flight. The caller's buffer must stay unchanged until they finish.
+/  disk_write() must write only after all asynchronous writes are complete. */
+
+
+#define FF_READ_AHEAD		8
+#define FF_READ_AHEAD_SIZE	(256UL << 10)
+/* FF_READ_AHEAD sets the number of prefetch buffers for sequential reading. (0:Disable
+/  or 1-64) Once a file opened for reading only is read sequentially, f_read() leaves
+/  reads of the following data in flight in these buffers and serves the next calls
+/  from them. One file uses the buffers at a time, the last one read sequentially.
+/  Whole sectors of such a file read directly into the caller's buffer are submitted
+/  with disk_read_async() and waited for once before f_read() returns.
+/  FF_READ_AHEAD_SIZE sets the size of each buffer in bytes. (A multiple of FF_MAX_SS)
+/  It may exceed the drive's maximum transfer size: disk_read_async() splits each
+/  prefetch into as many commands as needed. The buffers take static memory. */
 
 
 #define FF_USE_CHMOD	0
@@ -228,6 +257,50 @@
 /  buffer in the filesystem object (FATFS) is used for the file data transfer. */
 
 
+#define FF_WIN_CACHE	8
+/* This option sets the number of sectors cached for FAT, allocation bitmap and
+/  directory access. (1:Single window as in the original FatFs, 2-255:N-way cache)
+/  Lines are replaced least recently used first. Dirty lines are written back only
+/  when replaced or synced, merged with contiguous dirty lines into multi-sector
+/  writes. Each line adds 2 * FF_MAX_SS bytes to the filesystem object. Must be 1
+/  at the tiny configuration. */
+
+
+#define FF_FAST_BITMAP	1
+/* This option selects how the exFAT allocation bitmap is scanned for a free cluster
+/  block. (0:Bit by bit as in the original FatFs, 1:64 bits at a time)
+/  At 1, with the sector cache (FF_WIN_CACHE > 1) the bitmap sectors ahead of the
+/  scan are fetched with a single multi-sector read. */
+
+
+#define FF_BITMAP_MIRROR	(1 << 20)
+/* This option sets the size in bytes of a RAM mirror of the exFAT allocation bitmap.
+/  (0:Disable or a multiple of FF_MAX_SS) If the bitmap fits, it is loaded at mount and
+/  allocation works on the mirror alone. Changed sectors are written back in batches
+/  when the volume is synced, e.g. at f_sync() and f_close(). A larger bitmap is
+/  accessed through the window as usual. The mirror is a static buffer per volume. */
+
+
+#define FF_FAST_MEM		1
+/* This option selects the memory copy, fill and compare used inside FatFs, which
+/  move sector buffers and directory entries. (0:Byte loops as in the original FatFs,
+/  1:32-bit words on aligned buffers)
+/  Enabling it needs C99 integer types. The word version needs GCC's may_alias
+/  attribute, and other compilers keep the byte loops. */
+
+
+#define FF_DIR_INDEX		16384
+#define FF_DIR_INDEX_DIRS	4
+/* FF_DIR_INDEX sets the number of slots of an in-memory index of an exFAT directory,
+/  keyed by the name hash of its entries. (0:Disable or a power of 2) An index is
+/  built on the first lookup in a directory and kept up to date when files are
+/  created, renamed and removed there, so neither lookups nor new entries scan the
+/  directory. A directory holding more than 3/4 that many files is scanned as usual.
+/  FF_DIR_INDEX_DIRS sets the number of directories indexed at a time per volume.
+/  (1-255) The least recently used index is rebuilt for another directory. Each slot
+/  takes 6 bytes of static memory. */
+
+
 #define FF_FS_EXFAT		1
 /* This option switches support for exFAT filesystem. (0:Disable or 1:Enable)
 /  To enable exFAT, also LFN needs to be enabled. (FF_USE_LFN >= 1)
@@ -7,7 +7,8 @@
 #include "ff.h"
 
 
-#if FF_USE_LFN == 3	/* Dynamic memory allocation */
+#if FF_USE_LFN == 3 || FF_FASTSEEK_AUTO	/* Dynamic memory allocation */
+#include <stdlib.h>
 
 /*------------------------------------------------------------------------*/
 /* Allocate a memory block                                                */
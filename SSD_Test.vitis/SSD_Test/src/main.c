@@ -7,6 +7,16 @@ NVMe SSD Test Application Main
 #include "nvme.h"
 #include "ff.h"
 #include "diskio.h"
+#include "thermal.h"
+#include "shell.h"
+#include "pattern.h"
+#include "pace.h"
+#include "ring.h"
+#include "perflog.h"
+#include "steady.h"
+#include "slc.h"
+#include "amp.h"
+#include "stream.h"
 #include "xtime_l.h"
 #include "xil_printf.h"
 #include "xil_cache.h"
@@ -14,12 +24,15 @@ NVMe SSD Test Application Main
 #include "xuartps.h"
 #include "sleep.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
 
 #define US_PER_COUNT 1000 / (COUNTS_PER_SECOND / 1000)
 
-// Test Configuration
+// Test Configuration Defaults (Adjustable at Runtime Through the UART Shell)
 #define TRIM_FIRST          1           // 0: Don't TRIM, 1: TRIM before test
-#define TRIM_DELAY          0           // Extra wait time after TRIM in [min]. 0 = Wait for keypress.
+#define TRIM_DELAY          0           // Extra wait time after TRIM in [min].
 #define USE_FS              0           // 0: Raw Disk Test, 1: File System Test
 #define TEST_READ           0           // 0: Write, 1: Read (Raw Disk Test Only)
 #define TOTAL_WRITE         1999        // Total write size in [GB].
@@ -29,16 +42,465 @@ NVMe SSD Test Application Main
 #define BLOCK_SIZE          (1 << 16)   // Block size in [B] as a power of 2.
 #define BLOCKS_PER_FILE     (1 << 18)   // Blocks written per file in FS mode. (File System Test Only)
 #define FS_AU_SIZE          (1 << 20)   // File system AU size in [B] as a power of 2. (File System Test Only)
+#define FS_STREAM           0           // 1: Preallocate each file and write it directly, 2: Also roll files in idle time. (File System Test Only)
 #define NVME_SLIP_ALLOWED   16          // Amount of NVMe commands allowed to be in flight.
+#define THERMAL_GOVERNOR    1           // 0: Fixed target write rate, 1: Pace writes to stay below WCTEMP.
+#define THERMAL_USE_HCTM    0           // 1: Also set Host Controlled Thermal Management just below WCTEMP.
+#define PACE_BURST          16          // Rate limiter bucket depth in blocks: how far the test may catch up after a stall.
+#define PACE_FPS            0           // 0: Smooth target rate, >0: Replay a camera frame cadence at this frame rate.
+#define PACE_FRAME_SIZE     (12 << 20)  // Frame size in [B] for frame cadence pacing.
+
+#define VERIFY              0           // 0: Off, 1: Raw disk tests write and check an LBA-stamped pattern.
+#define VERIFY_SEED         1           // Pattern seed. Change it to tell runs apart.
+#define VERIFY_PASS         0           // Pattern pass number. Change it to tell overwrites apart.
+
+#define PERF_LOG            0           // 1: Record a binary performance log in DDR during tests.
+#define PERF_INTERVAL_US    1000        // Performance log interval in [us].
+#define PERF_LAT_EVERY      16          // One latency sample per this many completions (0: none).
+
+#define PRECON_MODE         0           // Preconditioning: 0: Sequential whole-drive passes, 1: Random writes to a fill level.
+#define PRECON_PASSES       2           // Sequential preconditioning passes over the whole drive.
+#define PRECON_FILL         200         // Random preconditioning writes in [%] of the drive capacity.
+#define SS_ROUND_GB         32          // Steady-state measurement round size in [GB].
+#define SS_WINDOW           5           // Rounds in the steady-state window.
+#define SS_ROUNDS_MAX       25          // Give up after this many rounds.
+#define SS_EXCURSION        20          // Largest range within the window in [%] of its average.
+#define SS_SLOPE            10          // Largest best-fit line change across the window in [%] of its average.
+
+#define SLC_INTERVAL_MS     100         // SLC characterization rate sample interval in [ms].
+#define SLC_SETTLE          20          // Samples a rate change must last to count as a transition.
+#define SLC_DROP            70          // Cache is exhausted when the rate falls below this [%] of the burst rate.
+#define SLC_POST_S          60          // Keep writing this long in [s] after the cliff to measure the post-cache rate.
+#define SLC_MAX_GB          2000        // Stop the initial fill after this many [GB] even without a cliff.
+#define SLC_GC_STEP         30          // Report later rate steps larger than this [%] (e.g. GC).
+#define SLC_IDLE_S          15          // First idle time in [s] for the write/idle/write cycles, doubled each cycle.
+#define SLC_IDLE_STEPS      5           // Write/idle/write cycles.
+
+#define AMP_CORES           0           // Producer cores (psu_cortexa53_1 and up) that fill and check data. 0: Core 0 only.
+
+#define STRESS_CMDS         100000      // Writes per core for the multi-core submission stress test.
+#define STRESS_QD           8           // Writes each core keeps in flight during the stress test.
+
+#define CAPTURE_FRAMES      8           // Frame buffers in the capture ring.
+#define CAPTURE_FILL        0           // 0: Stamp frame number only, 1: LBA-stamped verify pattern, 2: Copy a synthetic frame.
+
+#define BLOCK_SIZE_MAX      (1 << 21)   // Largest block size in [B].
+
+// I/O Queue Arbitration, set before nvmeInit(). FatFs synchronous commands and fio jobs with queue 1 use the priority SQ.
+#define QUEUE_WRR           1           // 1: Weighted round robin with urgent priority class, if the drive supports it.
+#define QUEUE_PRIO_BULK     NVME_QPRIO_MEDIUM
+#define QUEUE_PRIO_PRIORITY NVME_QPRIO_URGENT
+#define QUEUE_WEIGHT_HIGH   15          // WRR weights, 0's based.
+#define QUEUE_WEIGHT_MEDIUM 7
+#define QUEUE_WEIGHT_LOW    0
+#define QUEUE_ARB_BURST     7           // Arbitration burst, 2^N commands. 7: No limit.
+#define QUEUE_AGGR_THR      0           // Completion aggregation threshold, 0's based. No effect while the CQ is polled.
+#define QUEUE_AGGR_TIME     0           // Completion aggregation time in [100us]. No effect while the CQ is polled.
+
+// Workload Engine Limits
+#define WORKLOAD_JOBS_MAX   4           // Jobs that can run concurrently.
+#define WORKLOAD_QD_MAX     48          // Total queue depth of all jobs. Must stay below the I/O queue size.
+#define WORKLOAD_TRACK_SIZE 256         // Outstanding command slots, indexed by CID. Must exceed WORKLOAD_QD_MAX.
+#define WORKLOAD_LAT_BINS   32          // Latency histogram bins, log2 of [us].
+
+#define CAPTURE_BYTES_MAX   (1 << 30)   // Capture ring plus synthetic source frame, from the start of the data buffer.
+#define DATA_BYTES_MAX      (1 << 30)   // Data buffer in use by any test: capture ring, I/O slots and stress buffers.
+
+#define SS_ROUNDS_LIMIT     100         // Upper bound for ss_rounds_max.
+#define SLC_SERIES_MAX      (1 << 18)   // Rate samples kept for SLC characterization.
+#define SLC_TRANSITIONS_MAX 8
+
+#define IO_SLOTS_MAX        (WORKLOAD_QD_MAX + 2 + 2 * AMP_CORES_MAX)   // Data buffer slots for raw disk tests in verify mode.
+
+#define STRESS_QD_MAX       (WORKLOAD_QD_MAX / (AMP_CORES_MAX + 1))     // Per core, so all cores together stay below the I/O queue size.
+#define STRESS_TIMEOUT_MS   1000        // A stress core gives up after this long without one of its writes completing.
+
+#define BITMAP_RUN          1024        // Clusters the bitmap scan benchmark looks for. Free gaps in its bitmap are shorter.
+
+#define IOV_BYTES           (1 << 16)   // Transfer size of the vectored I/O self-test.
+#define IOV_SEG_MAX         (IOV_BYTES / 512)
+
+// Data Buffer Slot States
+#define SLOT_FREE           0
+#define SLOT_FILLING        1           // Being filled by a producer core.
+#define SLOT_READY          2           // Filled, waiting to be written.
+#define SLOT_IO             3           // Command in flight.
+#define SLOT_CHECKING       4           // Being checked by a producer core.
+
+#define FS_STREAM_ROLL      2           // fs_stream mode that creates the next file ahead and closes the last one later.
+#define FS_FILE_FORMAT      "f%06u.bin" // File system write test file path, from the file number.
+
+// Runtime Test Configuration
+typedef struct
+{
+	u32 trimFirst;
+	u32 trimDelay;
+	u32 useFS;
+	u32 testRead;
+	u32 totalWrite;
+	u32 targetWriteRate;
+	u32 totalRead;
+	u32 targetReadRate;
+	u32 blockSize;
+	u32 blocksPerFile;
+	u32 fsAUSize;
+	u32 fsStream;
+	u32 slipAllowed;
+	u32 thermalGovernor;
+	u32 thermalUseHCTM;
+	u32 paceBurst;
+	u32 paceFPS;
+	u32 paceFrameSize;
+	u32 verify;
+	u32 verifySeed;
+	u32 verifyPass;
+	u32 captureFrames;
+	u32 captureFill;
+	u32 perfLog;
+	u32 perfIntervalUs;
+	u32 perfLatEvery;
+	u32 preconMode;
+	u32 preconPasses;
+	u32 preconFill;
+	u32 ssRoundGB;
+	u32 ssWindow;
+	u32 ssRoundsMax;
+	u32 ssExcursion;
+	u32 ssSlope;
+	u32 slcIntervalMs;
+	u32 slcSettle;
+	u32 slcDrop;
+	u32 slcPostS;
+	u32 slcMaxGB;
+	u32 slcGCStep;
+	u32 slcIdleS;
+	u32 slcIdleSteps;
+	u32 ampCores;
+	u32 stressCmds;
+	u32 stressQD;
+} testConfig_type;
+
+// Sustained Write Results, for preconditioning and steady-state rounds.
+typedef struct
+{
+	float rate;				// [MB/s]
+	float latencyAvg;		// [us]
+	float latencyMax;		// [us]
+} sustainedResult_type;
+
+// Rate Series, optionally recorded by sustainedWrite().
+typedef struct
+{
+	float * rate;			// Completed write rate in [MB/s] per interval.
+	u32 n;
+	u32 max;
+	u32 intervalMs;
+	float cliffFraction;	// >0: Stop postSamples after the rate falls below this fraction of the burst rate.
+	u32 settle;
+	u32 postSamples;
+	u32 cliff;				// Cliff sample index, n if none.
+} rateSeries_type;
+
+// Data Buffer Slot, for tests that need a separate buffer for each command in flight.
+typedef struct
+{
+	u8 state;
+	u8 check;				// Check the pattern when the read into this slot completes.
+	u64 lba;
+} ioSlot_type;
+
+// Stress Test Submitter, one per core. Written only by its core while the test runs.
+typedef struct
+{
+	u8 * buffer;			// STRESS_QD_MAX blocks
+	u64 lba;				// Start of this core's LBA region.
+	u32 lbaPerBlock;
+	u32 issued;				// Blocks of the region submitted, in order from its start.
+	u32 completed;
+	u32 errors;				// Submission errors and error completion status.
+	u32 retries;			// Submissions refused because the I/O queues were full.
+	u32 lost;				// Writes still outstanding at the timeout.
+} stressWorker_type;
+
+// Workload Engine Job Configuration
+typedef struct
+{
+	u32 enabled;
+	u32 random;             // 0: Sequential, 1: Random
+	u32 readPct;            // Reads as a percentage of commands.
+	u32 bsMin;              // Smallest block size in [B] as a power of 2.
+	u32 bsMax;              // Largest block size in [B] as a power of 2. Sizes in between are equally likely.
+	u32 qd;                 // Commands this job keeps in flight.
+	u32 offsetGB;           // Start of the LBA span in [GB].
+	u32 spanGB;             // Size of the LBA span in [GB]. 0 = To end of drive.
+	u32 time_s;             // Time limit in [s]. 0 = None.
+	u32 sizeGB;             // Byte limit in [GB]. 0 = None.
+	u32 queue;              // NVME_IOSQ_BULK or NVME_IOSQ_PRIORITY
+} workloadJob_type;
+
+// Workload Engine Job Results and State
+typedef struct
+{
+	u64 lbaStart;
+	u64 lbaCount;
+	u64 lbaNext;
+	u64 bytesSubmitted;
+	u64 bytesDone;
+	u64 bytesDonePrev;
+	u64 commandsDone;
+	u64 commandsDonePrev;
+	u32 inFlight;
+	u32 active;
+	u32 errors;
+	u64 latSum;             // [counts]
+	u64 latMin;             // [counts]
+	u64 latMax;             // [counts]
+	u32 latHist[WORKLOAD_LAT_BINS];
+} workloadStats_type;
+
+// Workload Engine Outstanding Command
+typedef struct
+{
+	u8 job;
+	u32 bytes;
+	XTime tSubmit;
+} workloadTrack_type;
+
+// Workload Engine Job Parameter, by offset into workloadJob_type.
+typedef struct
+{
+	const char * name;
+	u32 offset;
+	u32 min;
+	u32 max;
+	const char * help;
+} workloadParam_type;
 
 void trimWait(u32 waitMin);
-void diskWriteTest();
-void diskReadTest();
-void fsWriteTest();
+float diskWriteTest();
+float diskReadTest(u32 totalGB, u8 check);
+float fsWriteTest();
+float captureTest();
+void preconditionTest();
+void slcTest();
+void stressTest();
+void stressWorker(void * arg);
+void bitmapTest();
+FRESULT bitmapSearch(FATFS * fs, u8 mirror, u32 * clst, float * ms);
+void iovTest();
+int iovRun(const nvmeIOVec_type * iov, u16 iovCount, u64 lba, u8 * source, u8 * check);
+int iovWait(void);
+
+int cmdRun(int argc, char ** argv);
+int cmdTrim(int argc, char ** argv);
+int cmdWrite(int argc, char ** argv);
+int cmdRead(int argc, char ** argv);
+int cmdFS(int argc, char ** argv);
+int cmdVerify(int argc, char ** argv);
+int cmdCapture(int argc, char ** argv);
+int cmdPerfLog(int argc, char ** argv);
+int cmdPrecondition(int argc, char ** argv);
+int cmdSLC(int argc, char ** argv);
+int cmdStress(int argc, char ** argv);
+int cmdBitmap(int argc, char ** argv);
+int cmdIOV(int argc, char ** argv);
+int cmdJob(int argc, char ** argv);
+int cmdFio(int argc, char ** argv);
+int cmdExit(int argc, char ** argv);
+int testConfigValid(void);
+
+int workloadValid(void);
+void workloadRun(void);
+int workloadSubmit(u32 j, XTime tNow);
+void workloadReport(XTime tElapsed);
+u64 workloadRand(void);
+
+u8 * ioSlotBuffer(u32 slot);
+void ioSlotSubmit(u32 slot, u64 lba, u32 lbaPerBlock, u8 read);
+void ioSlotService(void);
+void verifyReport(void);
+u32 ioSlotCount(void);
+void ioSlotFillAhead(void);
+u32 ampStart(void);
+void ampReport(XTime tElapsed);
+int fsFileOpen(FIL * fil, streamFile_type * stream, u32 nFile);
+void fsFileClose(FIL * fil, streamFile_type * stream);
+void fsRollService(void);
+void ioServiceCompletions(void);
+void captureService(void);
+void captureReport(void);
+void testLogStart(void);
+void sustainedWrite(u64 bytes, u8 random, u8 progress, sustainedResult_type * result, rateSeries_type * series);
+float seriesBytes(const rateSeries_type * series, u32 from, u32 to);
+void testLogStop(void);
+void paceStart(float rate);
+void paceReport(void);
 
 // Large data buffer in RAM for write source and read destination.
 u8 * const data = (u8 * const) (0x20000000);
 
+testConfig_type cfg =
+{
+	.trimFirst = TRIM_FIRST,
+	.trimDelay = TRIM_DELAY,
+	.useFS = USE_FS,
+	.testRead = TEST_READ,
+	.totalWrite = TOTAL_WRITE,
+	.targetWriteRate = TARGET_WRITE_RATE,
+	.totalRead = TOTAL_READ,
+	.targetReadRate = TARGET_READ_RATE,
+	.blockSize = BLOCK_SIZE,
+	.blocksPerFile = BLOCKS_PER_FILE,
+	.fsAUSize = FS_AU_SIZE,
+	.fsStream = FS_STREAM,
+	.slipAllowed = NVME_SLIP_ALLOWED,
+	.thermalGovernor = THERMAL_GOVERNOR,
+	.thermalUseHCTM = THERMAL_USE_HCTM,
+	.paceBurst = PACE_BURST,
+	.paceFPS = PACE_FPS,
+	.paceFrameSize = PACE_FRAME_SIZE,
+	.verify = VERIFY,
+	.verifySeed = VERIFY_SEED,
+	.verifyPass = VERIFY_PASS,
+	.captureFrames = CAPTURE_FRAMES,
+	.captureFill = CAPTURE_FILL,
+	.perfLog = PERF_LOG,
+	.perfIntervalUs = PERF_INTERVAL_US,
+	.perfLatEvery = PERF_LAT_EVERY,
+	.preconMode = PRECON_MODE,
+	.preconPasses = PRECON_PASSES,
+	.preconFill = PRECON_FILL,
+	.ssRoundGB = SS_ROUND_GB,
+	.ssWindow = SS_WINDOW,
+	.ssRoundsMax = SS_ROUNDS_MAX,
+	.ssExcursion = SS_EXCURSION,
+	.ssSlope = SS_SLOPE,
+	.slcIntervalMs = SLC_INTERVAL_MS,
+	.slcSettle = SLC_SETTLE,
+	.slcDrop = SLC_DROP,
+	.slcPostS = SLC_POST_S,
+	.slcMaxGB = SLC_MAX_GB,
+	.slcGCStep = SLC_GC_STEP,
+	.slcIdleS = SLC_IDLE_S,
+	.slcIdleSteps = SLC_IDLE_STEPS,
+	.ampCores = AMP_CORES,
+	.stressCmds = STRESS_CMDS,
+	.stressQD = STRESS_QD
+};
+
+const shellParam_type testParams[] =
+{
+	{ "trim_first",        &cfg.trimFirst,        0, 1,              "0: Don't TRIM, 1: TRIM before run" },
+	{ "trim_delay",        &cfg.trimDelay,        0, 1440,           "Extra wait time after TRIM in [min]" },
+	{ "use_fs",            &cfg.useFS,            0, 1,              "run: 0: Raw Disk Test, 1: File System Test" },
+	{ "test_read",         &cfg.testRead,         0, 1,              "run: 0: Write, 1: Read (Raw Disk Test Only)" },
+	{ "total_write",       &cfg.totalWrite,       1, 100000,         "Total write size in [GB]" },
+	{ "target_write_rate", &cfg.targetWriteRate,  1, 100000,         "Target write speed in [MB/s]" },
+	{ "total_read",        &cfg.totalRead,        1, 100000,         "Total read size in [GB]" },
+	{ "target_read_rate",  &cfg.targetReadRate,   1, 100000,         "Target read speed in [MB/s]" },
+	{ "block_size",        &cfg.blockSize,        512, BLOCK_SIZE_MAX, "Block size in [B] as a power of 2" },
+	{ "blocks_per_file",   &cfg.blocksPerFile,    1, 0xFFFFFFFF,     "Blocks written per file in FS mode" },
+	{ "fs_au_size",        &cfg.fsAUSize,         4096, (1 << 25),   "File system AU size in [B] as a power of 2" },
+	{ "fs_stream",         &cfg.fsStream,         0, 2,              "1: Preallocate files and write them directly, 2: Also create the next file ahead" },
+	{ "slip_allowed",      &cfg.slipAllowed,      0, 48,             "NVMe commands allowed to be in flight" },
+	{ "thermal_governor",  &cfg.thermalGovernor,  0, 1,              "1: Pace writes to stay below WCTEMP" },
+	{ "thermal_use_hctm",  &cfg.thermalUseHCTM,   0, 1,              "1: Also set HCTM just below WCTEMP" },
+	{ "pace_burst",        &cfg.paceBurst,        1, 65536,          "Rate limiter burst allowance in [blocks]" },
+	{ "pace_fps",          &cfg.paceFPS,          0, 1000,           "0: Smooth rate, >0: Frame cadence in [fps]" },
+	{ "pace_frame_size",   &cfg.paceFrameSize,    512, (1 << 30),    "Frame size in [B] for frame cadence" },
+	{ "verify",            &cfg.verify,           0, 1,              "1: Write and check an LBA-stamped pattern" },
+	{ "verify_seed",       &cfg.verifySeed,       0, 0xFFFFFFFF,     "Pattern seed" },
+	{ "verify_pass",       &cfg.verifyPass,       0, 0xFFFFFFFF,     "Pattern pass number" },
+	{ "capture_frames",    &cfg.captureFrames,    1, RING_FRAMES_MAX, "Frame buffers in the capture ring" },
+	{ "capture_fill",      &cfg.captureFill,      0, 2,              "0: Stamp, 1: Verify pattern, 2: Copy frame" },
+	{ "perf_log",          &cfg.perfLog,          0, 1,              "1: Record a binary performance log during tests" },
+	{ "perf_interval_us",  &cfg.perfIntervalUs,   10, 1000000,       "Performance log interval in [us]" },
+	{ "perf_lat_every",    &cfg.perfLatEvery,     0, 1000000,        "One latency sample per this many commands" },
+	{ "precon_mode",       &cfg.preconMode,       0, 1,              "Preconditioning: 0: Sequential, 1: Random" },
+	{ "precon_passes",     &cfg.preconPasses,     0, 100,            "Sequential preconditioning passes" },
+	{ "precon_fill",       &cfg.preconFill,       0, 1000,           "Random preconditioning writes in [%] of capacity" },
+	{ "ss_round_gb",       &cfg.ssRoundGB,        1, 10000,          "Steady-state round size in [GB]" },
+	{ "ss_window",         &cfg.ssWindow,         2, 20,             "Rounds in the steady-state window" },
+	{ "ss_rounds_max",     &cfg.ssRoundsMax,      2, SS_ROUNDS_LIMIT, "Most steady-state rounds" },
+	{ "ss_excursion",      &cfg.ssExcursion,      1, 100,            "Window range limit in [%] of average" },
+	{ "ss_slope",          &cfg.ssSlope,          1, 100,            "Window best-fit change limit in [%] of average" },
+	{ "slc_interval_ms",   &cfg.slcIntervalMs,    10, 10000,         "SLC test rate sample interval in [ms]" },
+	{ "slc_settle",        &cfg.slcSettle,        1, 1000,           "Samples a rate change must last" },
+	{ "slc_drop",          &cfg.slcDrop,          1, 99,             "Cache cliff threshold in [%] of burst rate" },
+	{ "slc_post_s",        &cfg.slcPostS,         1, 100000,         "Writing after the cliff in [s]" },
+	{ "slc_max_gb",        &cfg.slcMaxGB,         1, 100000,         "Most [GB] for the initial fill" },
+	{ "slc_gc_step",       &cfg.slcGCStep,        1, 1000,           "Reported rate steps in [%]" },
+	{ "slc_idle_s",        &cfg.slcIdleS,         1, 100000,         "First idle time in [s], doubled each cycle" },
+	{ "slc_idle_steps",    &cfg.slcIdleSteps,     0, 16,             "Write/idle/write cycles" },
+	{ "amp_cores",         &cfg.ampCores,         0, AMP_CORES_MAX,  "Producer cores for fill and check, 0: None" },
+	{ "stress_cmds",       &cfg.stressCmds,       1, 0xFFFFFFFF,     "Writes per core for the stress test" },
+	{ "stress_qd",         &cfg.stressQD,         1, STRESS_QD_MAX,  "Writes in flight per core for the stress test" }
+};
+
+const shellCommand_type testCommands[] =
+{
+	{ "run",   cmdRun,   "TRIM if trim_first, then run the test selected by use_fs and test_read." },
+	{ "trim",  cmdTrim,  "TRIM the whole drive and wait trim_delay minutes." },
+	{ "write", cmdWrite, "Run the raw disk write test." },
+	{ "read",  cmdRead,  "Run the raw disk read test." },
+	{ "fs",    cmdFS,    "Format the drive and run the file system write test." },
+	{ "capture", cmdCapture, "Emulate a recorder: frames at pace_fps into a ring, written from the ring." },
+	{ "precon", cmdPrecondition, "TRIM if trim_first, precondition, then measure rounds until steady state." },
+	{ "slc",   cmdSLC,   "TRIM if trim_first, then characterize the SLC cache, post-cache rate and idle recovery." },
+	{ "stress", cmdStress, "Write stress_cmds blocks from core 0 and each producer core at once, then check them." },
+	{ "bitmap", cmdBitmap, "Format the drive, fragment the allocation bitmap and time a contiguous cluster search." },
+	{ "iov",   cmdIOV,   "Write and read back LBAs from 0 with vectored commands, as PRPs and as SGLs." },
+	{ "perflog", cmdPerfLog, "Dump the performance log: perflog uart [<records>] | perflog disk" },
+	{ "verify", cmdVerify, "Read back total_write GB from LBA 0 and check the pattern." },
+	{ "job",   cmdJob,   "job <n> [<param> <value>]: Show or set a workload engine job." },
+	{ "fio",   cmdFio,   "Run all enabled workload engine jobs concurrently." },
+	{ "exit",  cmdExit,  "Leave the shell and finish." }
+};
+
+// Workload engine jobs. By default, job 0 is a 10s sequential 64KiB write at QD16.
+workloadJob_type jobs[WORKLOAD_JOBS_MAX] =
+{
+	{ .enabled = 1, .random = 0, .readPct = 0, .bsMin = (1 << 16), .bsMax = (1 << 16), .qd = 16, .time_s = 10 },
+	{ .bsMin = (1 << 12), .bsMax = (1 << 12), .qd = 1, .time_s = 10 },
+	{ .bsMin = (1 << 12), .bsMax = (1 << 12), .qd = 1, .time_s = 10 },
+	{ .bsMin = (1 << 12), .bsMax = (1 << 12), .qd = 1, .time_s = 10 }
+};
+workloadStats_type jobStats[WORKLOAD_JOBS_MAX];
+workloadTrack_type jobTrack[WORKLOAD_TRACK_SIZE];
+u64 workloadSeed = 0x9E3779B97F4A7C15ULL;
+
+ioSlot_type ioSlot[IO_SLOTS_MAX];
+u8 ioSlotByCID[WORKLOAD_TRACK_SIZE];
+patternStats_type verifyStats;
+u8 frameByCID[WORKLOAD_TRACK_SIZE];
+u32 frameSeq[RING_FRAMES_MAX];
+u8 captureAMP = 0;
+u64 sustainedCursor = 0;
+float slcSeries[SLC_SERIES_MAX];
+u32 ioErrors = 0;
+u8 ioSlotAMP = 0;					// Slots are filled and checked by producer cores.
+u32 ioSlotsN = 0;
+u64 ioFillNext = 0;					// Next block to fill ahead, in verify write mode with producer cores.
+u64 ioFillEnd = 0;
+u32 ioFillLBAPerBlock = 0;
+stressWorker_type stressWorkers[AMP_CORES_MAX + 1];
+streamRoll_type fsRoll;
+
+const workloadParam_type jobParams[] =
+{
+	{ "enabled",  offsetof(workloadJob_type, enabled),  0, 1,              "0: Off, 1: Run with fio" },
+	{ "random",   offsetof(workloadJob_type, random),   0, 1,              "0: Sequential, 1: Random offsets" },
+	{ "read_pct", offsetof(workloadJob_type, readPct),  0, 100,            "Reads as percent of commands" },
+	{ "bs_min",   offsetof(workloadJob_type, bsMin),    512, BLOCK_SIZE_MAX, "Smallest block size in [B], power of 2" },
+	{ "bs_max",   offsetof(workloadJob_type, bsMax),    512, BLOCK_SIZE_MAX, "Largest block size in [B], power of 2" },
+	{ "qd",       offsetof(workloadJob_type, qd),       1, WORKLOAD_QD_MAX, "Commands kept in flight" },
+	{ "offset",   offsetof(workloadJob_type, offsetGB), 0, 100000,         "Start of LBA span in [GB]" },
+	{ "span",     offsetof(workloadJob_type, spanGB),   0, 100000,         "Size of LBA span in [GB], 0 = to end" },
+	{ "time",     offsetof(workloadJob_type, time_s),   0, 0xFFFFFFFF,     "Time limit in [s], 0 = none" },
+	{ "size",     offsetof(workloadJob_type, sizeGB),   0, 100000,         "Byte limit in [GB], 0 = none" },
+	{ "queue",    offsetof(workloadJob_type, queue),    0, NVME_IOSQ_COUNT - 1, "0: Bulk SQ, 1: Priority SQ" }
+};
+
 // GPIO Global Variables
 XGpioPs Gpio;
 XGpioPs_Config *gpioConfig;
@@ -68,6 +530,18 @@ int main()
     // Start NVMe Driver
 	u32 nvmeStatus;
 	char strResult[128];
+	nvmeQueueConfig_type queueConfig =
+	{
+		.wrr = QUEUE_WRR,
+		.sqPriority = { QUEUE_PRIO_BULK, QUEUE_PRIO_PRIORITY },
+		.weightHigh = QUEUE_WEIGHT_HIGH,
+		.weightMedium = QUEUE_WEIGHT_MEDIUM,
+		.weightLow = QUEUE_WEIGHT_LOW,
+		.arbitrationBurst = QUEUE_ARB_BURST,
+		.aggrThreshold = QUEUE_AGGR_THR,
+		.aggrTime = QUEUE_AGGR_TIME
+	};
+    nvmeSetQueueConfig(&queueConfig);
     nvmeStatus = nvmeInit();
     if (nvmeStatus == NVME_OK)
     {
@@ -85,33 +559,250 @@ int main()
 
     usleep(10000);
 
-    // TRIM if indicated.
-    if (TRIM_FIRST)
+    // Register the data buffer so that commands using it don't rebuild their PRP lists.
+    if (nvmeRegisterBuffer(data, DATA_BYTES_MAX) != NVME_REG_OK)
     {
-    	trimWait(TRIM_DELAY);
+    	xil_printf("Data buffer registration failed. Commands build their own PRP lists.\r\n");
     }
 
-    // Select and run test.
-    if (USE_FS)
-    {
-    	fsWriteTest();
-    }
-    else if (TEST_READ)
-    {
-    	diskReadTest();
-    }
-    else
-    {
-    	diskWriteTest();
-    }
+    // Set up and run tests from the UART shell.
+    shellInit(testCommands, sizeof(testCommands) / sizeof(shellCommand_type),
+    		  testParams, sizeof(testParams) / sizeof(shellParam_type));
+    shellRun();
 
     // Deinit
+    nvmeUnregisterBuffer(data);
     pcieDeinit();
     xil_printf("NVMe SSD test application finished.\r\n");
     cleanup_platform();
     return 0;
 }
 
+// Shell Commands
+int cmdRun(int argc, char ** argv)
+{
+	if (!testConfigValid()) { return SHELL_ERROR; }
+
+	// TRIM if indicated.
+	if (cfg.trimFirst)
+	{
+		trimWait(cfg.trimDelay);
+	}
+
+	// Select and run test.
+	if (cfg.useFS)
+	{
+		fsWriteTest();
+	}
+	else if (cfg.testRead)
+	{
+		diskReadTest(cfg.totalRead, cfg.verify);
+	}
+	else
+	{
+		diskWriteTest();
+	}
+
+	return SHELL_OK;
+}
+
+int cmdTrim(int argc, char ** argv)
+{
+	trimWait(cfg.trimDelay);
+	return SHELL_OK;
+}
+
+int cmdWrite(int argc, char ** argv)
+{
+	if (!testConfigValid()) { return SHELL_ERROR; }
+	diskWriteTest();
+	return SHELL_OK;
+}
+
+int cmdRead(int argc, char ** argv)
+{
+	if (!testConfigValid()) { return SHELL_ERROR; }
+	diskReadTest(cfg.totalRead, cfg.verify);
+	return SHELL_OK;
+}
+
+int cmdFS(int argc, char ** argv)
+{
+	if (!testConfigValid()) { return SHELL_ERROR; }
+	fsWriteTest();
+	return SHELL_OK;
+}
+
+int cmdVerify(int argc, char ** argv)
+{
+	if (!testConfigValid()) { return SHELL_ERROR; }
+	diskReadTest(cfg.totalWrite, 1);
+	return SHELL_OK;
+}
+
+int cmdCapture(int argc, char ** argv)
+{
+	if (!testConfigValid()) { return SHELL_ERROR; }
+	captureTest();
+	return SHELL_OK;
+}
+
+int cmdPrecondition(int argc, char ** argv)
+{
+	if (!testConfigValid()) { return SHELL_ERROR; }
+	if (cfg.ssWindow > cfg.ssRoundsMax) { xil_printf("ss_window must not exceed ss_rounds_max.\r\n"); return SHELL_ERROR; }
+
+	if (cfg.trimFirst)
+	{
+		trimWait(cfg.trimDelay);
+	}
+	preconditionTest();
+	return SHELL_OK;
+}
+
+int cmdSLC(int argc, char ** argv)
+{
+	if (!testConfigValid()) { return SHELL_ERROR; }
+
+	if (cfg.trimFirst)
+	{
+		trimWait(cfg.trimDelay);
+	}
+	slcTest();
+	return SHELL_OK;
+}
+
+int cmdStress(int argc, char ** argv)
+{
+	if (!testConfigValid()) { return SHELL_ERROR; }
+
+	stressTest();
+	return SHELL_OK;
+}
+
+int cmdBitmap(int argc, char ** argv)
+{
+	if (!testConfigValid()) { return SHELL_ERROR; }
+
+	bitmapTest();
+	return SHELL_OK;
+}
+
+int cmdIOV(int argc, char ** argv)
+{
+	iovTest();
+	return SHELL_OK;
+}
+
+int cmdPerfLog(int argc, char ** argv)
+{
+	char strWorking[128];
+	u64 lbaStart;
+	int status;
+
+	if ((argc >= 2) && (strcmp(argv[1], "uart") == 0))
+	{
+		perfLogDumpUART((argc >= 3) ? strtoull(argv[2], NULL, 0) : 0);
+		return SHELL_OK;
+	}
+	if ((argc == 2) && (strcmp(argv[1], "disk") == 0))
+	{
+		status = perfLogDumpDisk(&lbaStart);
+		if (status != PERFLOG_OK)
+		{
+			sprintf(strWorking, "Performance log dump failed. Error Code: %d\r\n", status);
+			xil_printf(strWorking);
+			return SHELL_ERROR;
+		}
+		sprintf(strWorking, "Performance log written at LBA %llu.\r\n", (unsigned long long)lbaStart);
+		xil_printf(strWorking);
+		return SHELL_OK;
+	}
+
+	sprintf(strWorking, "%llu records logged.\r\n", (unsigned long long)perfLogGetCount());
+	xil_printf(strWorking);
+	xil_printf("Usage: perflog uart [<records>] | perflog disk\r\n");
+	return SHELL_OK;
+}
+
+int cmdJob(int argc, char ** argv)
+{
+	char strWorking[128];
+	u32 j, value;
+	char * end;
+
+	if ((argc != 2) && (argc != 4)) { xil_printf("Usage: job <n> [<param> <value>]\r\n"); return SHELL_ERROR; }
+
+	j = strtoul(argv[1], &end, 0);
+	if ((*end != '\0') || (j >= WORKLOAD_JOBS_MAX)) { xil_printf("Bad job number.\r\n"); return SHELL_ERROR; }
+
+	for (u32 p = 0; p < sizeof(jobParams) / sizeof(workloadParam_type); p++)
+	{
+		u32 * field = (u32 *)((u8 *)&jobs[j] + jobParams[p].offset);
+
+		if (argc == 2)
+		{
+			sprintf(strWorking, "%-10s %12u   %s\r\n", jobParams[p].name, *field, jobParams[p].help);
+			xil_printf(strWorking);
+		}
+		else if (strcmp(argv[2], jobParams[p].name) == 0)
+		{
+			value = strtoul(argv[3], &end, 0);
+			if ((*end != '\0') || (value < jobParams[p].min) || (value > jobParams[p].max))
+			{
+				sprintf(strWorking, "%s must be in [%u, %u].\r\n", jobParams[p].name, jobParams[p].min, jobParams[p].max);
+				xil_printf(strWorking);
+				return SHELL_ERROR;
+			}
+			*field = value;
+			return SHELL_OK;
+		}
+	}
+
+	if (argc == 4) { xil_printf("Unknown job parameter.\r\n"); return SHELL_ERROR; }
+
+	return SHELL_OK;
+}
+
+int cmdFio(int argc, char ** argv)
+{
+	if (!workloadValid()) { return SHELL_ERROR; }
+	workloadRun();
+	return SHELL_OK;
+}
+
+int cmdExit(int argc, char ** argv)
+{
+	return SHELL_EXIT;
+}
+
+// Checks that aren't covered by the parameter ranges.
+int testConfigValid(void)
+{
+	if ((cfg.blockSize & (cfg.blockSize - 1)) || (cfg.blockSize < nvmeGetLBASize()))
+	{
+		xil_printf("block_size must be a power of 2 and at least one LBA.\r\n");
+		return 0;
+	}
+	if (cfg.blockSize > nvmeGetMaxTransferSize())
+	{
+		xil_printf("block_size is larger than the drive's maximum transfer size of %d B.\r\n", nvmeGetMaxTransferSize());
+		return 0;
+	}
+	if (cfg.fsAUSize & (cfg.fsAUSize - 1))
+	{
+		xil_printf("fs_au_size must be a power of 2.\r\n");
+		return 0;
+	}
+	if (cfg.verify && (cfg.slipAllowed + 2 + 2 * cfg.ampCores > IO_SLOTS_MAX))
+	{
+		xil_printf("slip_allowed is too large for verify mode.\r\n");
+		return 0;
+	}
+
+	return 1;
+}
+
 // TRIM and Wait for Garbage Collection
 void trimWait(u32 trimDelay)
 {
@@ -162,15 +853,6 @@ void trimWait(u32 trimDelay)
 
 	xil_printf("Finished deallocating SSD.\r\n");
 
-	if(trimDelay == 0)
-	{
-		xil_printf("Enter S to start test...\r\n");
-		do
-		{
-			while(!XUartPs_IsReceiveData(XUartPs_LookupConfig(XPAR_XUARTPS_0_DEVICE_ID)->BaseAddress));
-		} while (XUartPs_RecvByte(XUartPs_LookupConfig(XPAR_XUARTPS_0_DEVICE_ID)->BaseAddress) != 'S');
-	}
-
 	while(trimDelay)
 	{
 		sprintf(strWorking, "Waiting after TRIM, %d minutes remaining...\r\n", trimDelay);
@@ -182,90 +864,181 @@ void trimWait(u32 trimDelay)
 }
 
 // Raw Disk Write Test
-void diskWriteTest()
+float diskWriteTest()
 {
 	char strWorking[128];
 
 	xil_printf("Raw disk write test started.\r\n");
 
 	// Setup for write test.
-	u64 bytesToWrite = (u64)TOTAL_WRITE * 1000000000ULL;
-	u32 blocksToWrite = bytesToWrite / BLOCK_SIZE;
+	u64 bytesToWrite = (u64)cfg.totalWrite * 1000000000ULL;
+	u32 blocksToWrite = bytesToWrite / cfg.blockSize;
 	u32 blocksWritten = 0;
 	u32 blocksWrittenPrev = 0;
-	u32 lbaPerBlock = BLOCK_SIZE / 512;
+	u32 lbaPerBlock = cfg.blockSize / nvmeGetLBASize();
 	u32 lbaDest = 0;
-	u64 countsPerBlock = (u64)BLOCK_SIZE * (u64)COUNTS_PER_SECOND / (u64)(TARGET_WRITE_RATE * 1000000ULL);
+	u32 nSlots = ioSlotCount();
+	u32 slot;
+	void (*service)(void) = cfg.verify ? ioSlotService : ioServiceCompletions;
 
-	XTime tStart, tPrev, tNow;
+	XTime tStart, tNow;
 	u32 sElapsed = 0;
 	float rate = 0.0f;
 	float totalWrittenGB = 0.0f;
+	float rateLimit;
+
+	paceStart((float)cfg.targetWriteRate);
+	rateLimit = paceGetRate();
+
+	if (cfg.thermalGovernor)
+	{
+		thermalInit(rateLimit, cfg.thermalUseHCTM);
+	}
+
+	if (cfg.verify)
+	{
+		memset(ioSlot, 0, sizeof(ioSlot));
+		ioSlotAMP = (ampStart() > 0);
+		if (ioSlotAMP) { ampResetStats(); }
+		ioSlotsN = nSlots;
+		ioFillNext = 0;
+		ioFillEnd = blocksToWrite;
+		ioFillLBAPerBlock = lbaPerBlock;
+		xil_printf("Writing verify pattern.\r\n");
+	}
 
 	XTime_GetTime(&tStart);
-	tPrev = tStart;
+	testLogStart();
 
-	xil_printf("Time [s], Rate [MB/s], Total [GB]\r\n");
+	xil_printf("Time [s], Rate [MB/s], Total [GB], Temp [C], Limit [MB/s]\r\n");
 
 	// Block writing loop.
 	while(blocksWritten < blocksToWrite)
 	{
 		// Target data rate limiter.
-		do { XTime_GetTime(&tNow); }
-		while (tNow - tPrev < countsPerBlock);
-		tPrev = tNow;
+		paceWait(service);
+		XTime_GetTime(&tNow);
 
 		// 1Hz progress update.
 		if((tNow - tStart) / COUNTS_PER_SECOND > sElapsed)
 		{
 			sElapsed = (tNow - tStart) / COUNTS_PER_SECOND;
 
-			rate = (float)((blocksWritten - blocksWrittenPrev) * BLOCK_SIZE) * 1e-6f;
+			rate = (float)((u64)(blocksWritten - blocksWrittenPrev) * (u64)cfg.blockSize) * 1e-6f;
 			blocksWrittenPrev = blocksWritten;
 
-			totalWrittenGB = (float)((u64)blocksWritten * (u64)BLOCK_SIZE) * 1e-9f;
+			totalWrittenGB = (float)((u64)blocksWritten * (u64)cfg.blockSize) * 1e-9f;
 
-			sprintf(strWorking, "%8d,%12.3f,%11.3f\r\n", sElapsed, rate, totalWrittenGB);
+			// Thermal governor adjusts the target write rate.
+			if (cfg.thermalGovernor)
+			{
+				rateLimit = thermalGovern(rate);
+				paceSetRate(rateLimit);
+			}
+
+			sprintf(strWorking, "%8d,%12.3f,%11.3f,%9.1f,%13.0f\r\n", sElapsed, rate, totalWrittenGB, thermalGetTemp(), rateLimit);
 			xil_printf(strWorking);
 		}
 
-		// Add marker to data.
-		*(u32 *) data = blocksWritten;
+		if (cfg.verify)
+		{
+			// Each command in flight has its own buffer, refilled only after its previous write completes.
+			slot = blocksWritten % nSlots;
+			if (ioSlotAMP)
+			{
+				// Producer cores fill slots ahead of the writes.
+				while(ioSlot[slot].state != SLOT_READY)
+				{ ioSlotService(); }
+			}
+			else
+			{
+				while(ioSlot[slot].state != SLOT_FREE)
+				{ ioSlotService(); }
+				patternFill(ioSlotBuffer(slot), lbaDest, lbaPerBlock, nvmeGetLBASize(), cfg.verifyPass, cfg.verifySeed);
+			}
+
+			// Write block.
+			ioSlotSubmit(slot, lbaDest, lbaPerBlock, 0);
+			while(nvmeGetIOSlip() > cfg.slipAllowed)
+			{ ioSlotService(); }
+		}
+		else
+		{
+			// Add marker to data.
+			*(u32 *) data = blocksWritten;
 
-		// Write block.
-		nvmeWrite(data, (u64) lbaDest, lbaPerBlock);
-		while(nvmeGetIOSlip() > NVME_SLIP_ALLOWED)
-		{ nvmeServiceIOCompletions(16); }
+			// Write block.
+			nvmeWrite(data, (u64) lbaDest, lbaPerBlock);
+			while(nvmeGetIOSlip() > cfg.slipAllowed)
+			{ nvmeServiceIOCompletions(16); }
+		}
 		blocksWritten++;
 		lbaDest += lbaPerBlock;
 	}
 
+	// Finish all slipped commands so that the next test starts from an empty queue.
+	while(nvmeGetIOSlip() > 0)
+	{ service(); }
+
+	testLogStop();
+
+	// Average rate over the whole test, for comparing runs.
+	XTime_GetTime(&tNow);
+	rate = (float)((u64)blocksWritten * (u64)cfg.blockSize) * 1e-6f / ((float)(tNow - tStart) / (float)COUNTS_PER_SECOND);
+	sprintf(strWorking, "Result: %d B blocks, %.3f GB, %.3f MB/s average.\r\n", cfg.blockSize,
+			(float)((u64)blocksWritten * (u64)cfg.blockSize) * 1e-9f, rate);
+	xil_printf(strWorking);
+
+	paceReport();
+
+	if (cfg.verify && ioSlotAMP)
+	{
+		ampReport(tNow - tStart);
+	}
+
 	xil_printf("Raw disk write test finished.\r\n");
+
+	return rate;
 }
 
-// Raw Disk Read Test
-void diskReadTest()
+// Raw Disk Read Test, optionally checking the verify pattern inline.
+float diskReadTest(u32 totalGB, u8 check)
 {
 	char strWorking[128];
 
 	xil_printf("Raw disk I/O read test started.\r\n");
 
 	// Setup for read test.
-	u64 bytesToRead = (u64)TOTAL_READ * 1000000000ULL;
-	u32 blocksToRead = bytesToRead / BLOCK_SIZE;
+	u64 bytesToRead = (u64)totalGB * 1000000000ULL;
+	u32 blocksToRead = bytesToRead / cfg.blockSize;
 	u32 blocksRead = 0;
 	u32 blocksReadPrev = 0;
-	u32 lbaPerBlock = BLOCK_SIZE / 512;
+	u32 lbaPerBlock = cfg.blockSize / nvmeGetLBASize();
 	u32 lbaSrc = 0;
-	u64 countsPerBlock = (u64)BLOCK_SIZE * (u64)COUNTS_PER_SECOND / (u64)(TARGET_READ_RATE * 1000000ULL);
+	u32 nSlots = ioSlotCount();
+	u32 slot;
+	void (*service)(void) = check ? ioSlotService : ioServiceCompletions;
 
-	XTime tStart, tPrev, tNow;
+	XTime tStart, tNow;
 	u32 sElapsed = 0;
 	float rate = 0.0f;
 	float totalReadGB = 0.0f;
 
+	paceStart((float)cfg.targetReadRate);
+
+	if (check)
+	{
+		memset(ioSlot, 0, sizeof(ioSlot));
+		patternResetStats(&verifyStats);
+		ioErrors = 0;
+		ioSlotAMP = (ampStart() > 0);
+		ioFillEnd = 0;
+		if (ioSlotAMP) { ampResetStats(); }
+		xil_printf("Checking verify pattern.\r\n");
+	}
+
 	XTime_GetTime(&tStart);
-	tPrev = tStart;
+	testLogStart();
 
 	xil_printf("Time [s], Rate [MB/s], Total [GB]\r\n");
 
@@ -273,52 +1046,94 @@ void diskReadTest()
 	while(blocksRead < blocksToRead)
 	{
 		// Target data rate limiter.
-		do { XTime_GetTime(&tNow); }
-		while (tNow - tPrev < countsPerBlock);
-		tPrev = tNow;
+		paceWait(service);
+		XTime_GetTime(&tNow);
 
 		// 1Hz progress update.
 		if((tNow - tStart) / COUNTS_PER_SECOND > sElapsed)
 		{
 			sElapsed = (tNow - tStart) / COUNTS_PER_SECOND;
 
-			rate = (float)((blocksRead - blocksReadPrev) * BLOCK_SIZE) * 1e-6f;
+			rate = (float)((u64)(blocksRead - blocksReadPrev) * (u64)cfg.blockSize) * 1e-6f;
 			blocksReadPrev = blocksRead;
 
-			totalReadGB = (float)((u64)blocksRead * (u64)BLOCK_SIZE) * 1e-9f;
+			totalReadGB = (float)((u64)blocksRead * (u64)cfg.blockSize) * 1e-9f;
 
 			sprintf(strWorking, "%8d,%12.3f,%11.3f\r\n", sElapsed, rate, totalReadGB);
 			xil_printf(strWorking);
 		}
 
-		// Read block.
-		nvmeRead(data, (u64) lbaSrc, lbaPerBlock);
-		while(nvmeGetIOSlip() > NVME_SLIP_ALLOWED)
-		{ nvmeServiceIOCompletions(16); }
+		if (check)
+		{
+			// Each command in flight has its own buffer, checked when the read into it completes.
+			slot = blocksRead % nSlots;
+			while(ioSlot[slot].state != SLOT_FREE)
+			{ ioSlotService(); }
+
+			// Read block.
+			ioSlotSubmit(slot, lbaSrc, lbaPerBlock, 1);
+			while(nvmeGetIOSlip() > cfg.slipAllowed)
+			{ ioSlotService(); }
+		}
+		else
+		{
+			// Read block.
+			nvmeRead(data, (u64) lbaSrc, lbaPerBlock);
+			while(nvmeGetIOSlip() > cfg.slipAllowed)
+			{ nvmeServiceIOCompletions(16); }
+		}
 		blocksRead++;
 		lbaSrc += lbaPerBlock;
 	}
 
+	// Finish all slipped commands so that the next test starts from an empty queue.
+	while(nvmeGetIOSlip() > 0)
+	{ service(); }
+
+	testLogStop();
+
+	// Average rate over the whole test, for comparing runs.
+	XTime_GetTime(&tNow);
+	rate = (float)((u64)blocksRead * (u64)cfg.blockSize) * 1e-6f / ((float)(tNow - tStart) / (float)COUNTS_PER_SECOND);
+	sprintf(strWorking, "Result: %d B blocks, %.3f GB, %.3f MB/s average.\r\n", cfg.blockSize,
+			(float)((u64)blocksRead * (u64)cfg.blockSize) * 1e-9f, rate);
+	xil_printf(strWorking);
+
+	paceReport();
+
+	if (check)
+	{
+		// Wait for the last checks on producer cores.
+		while (ioSlotAMP && (ampGetPending() > 0))
+		{ ioSlotService(); }
+		verifyReport();
+		if (ioSlotAMP) { ampReport(tNow - tStart); }
+	}
+
 	xil_printf("Raw disk I/O read test finished.\r\n");
+
+	return rate;
 }
 
 // File System Write Test
-void fsWriteTest()
+float fsWriteTest()
 {
 	char strWorking[128];
 
 	xil_printf("File system write test started.\r\n");
 	xil_printf("Formatting disk...\r\n");
 
-	// Set up the file system and format the drive.
-	FATFS fs;
+	// Set up the file system and format the drive. The filesystem object holds the sector cache, so keep it off the stack.
+	static FATFS fs;
 	MKFS_PARM opt;
-	FIL fil;
+	static FIL fil;
+	static streamFile_type stream;
 	FRESULT res;
+	int status;
 	UINT bw;
 	BYTE work[FF_MAX_SS];
 	opt.fmt = FM_EXFAT;
-	opt.au_size = FS_AU_SIZE;
+	opt.au_size = cfg.fsAUSize;
 	opt.align = 1;
 	opt.n_fat = 1;
 	opt.n_root = 512;
@@ -326,7 +1141,7 @@ void fsWriteTest()
 	if(res)
 	{
 		xil_printf("Failed to create file system on disk.\r\n");
-		return;
+		return 0.0f;
 	}
 
 	// Mount the drive.
@@ -334,53 +1149,77 @@ void fsWriteTest()
 	if(res)
 	{
 		xil_printf("Failed to mount disk.\r\n");
-		return;
+		return 0.0f;
 	}
 	xil_printf("Disk formatted and mounted successfully.\r\n");
 
 	// Create first file.
 	u32 nFile = 0;
-	sprintf(strWorking, "f%06d.bin\n", nFile);
-	f_open(&fil, strWorking, FA_CREATE_NEW | FA_WRITE);
+	u8 fileOpen = fsFileOpen(&fil, &stream, nFile);
+	if (!fileOpen)
+	{
+		f_mount(0, "", 0);
+		return 0.0f;
+	}
+
+	// Let f_write() return with up to slip_allowed writes from the data buffer in flight. Only the block number stamp
+	// changes between writes, so the test doesn't wait for the buffer to be released.
+	UINT writeBehind = cfg.slipAllowed;
+	disk_ioctl(0, CTRL_WRITE_BEHIND, &writeBehind);
 
 	// Setup for write test.
-	u64 bytesToWrite = (u64)TOTAL_WRITE * 1000000000ULL;
-	u32 blocksToWrite = bytesToWrite / BLOCK_SIZE;
+	u64 bytesToWrite = (u64)cfg.totalWrite * 1000000000ULL;
+	u32 blocksToWrite = bytesToWrite / cfg.blockSize;
 	u32 blocksWritten = 0;
 	u32 blocksWrittenPrev = 0;
-	u32 lbaPerBlock = BLOCK_SIZE / 512;
+	u32 lbaPerBlock = cfg.blockSize / nvmeGetLBASize();
 	u32 lbaDest = 0;
-	u64 countsPerBlock = (u64)BLOCK_SIZE * (u64)COUNTS_PER_SECOND / (u64)(TARGET_WRITE_RATE * 1000000ULL);
 
-	XTime tStart, tPrev, tNow;
+	XTime tStart, tNow;
 	u32 sElapsed = 0;
 	float rate = 0.0f;
 	float totalWrittenGB = 0.0f;
+	void (*service)(void) = (cfg.fsStream == FS_STREAM_ROLL) ? fsRollService : ioServiceCompletions;
+	float rateLimit;
+
+	paceStart((float)cfg.targetWriteRate);
+	rateLimit = paceGetRate();
+
+	if (cfg.thermalGovernor)
+	{
+		thermalInit(rateLimit, cfg.thermalUseHCTM);
+	}
 
 	XTime_GetTime(&tStart);
-	tPrev = tStart;
+	testLogStart();
 
-	xil_printf("Time [s], Rate [MB/s], Total [GB]\r\n");
+	xil_printf("Time [s], Rate [MB/s], Total [GB], Temp [C], Limit [MB/s]\r\n");
 
 	// Block writing loop.
 	while(blocksWritten < blocksToWrite)
 	{
 		// Target data rate limiter.
-		do { XTime_GetTime(&tNow); }
-		while (tNow - tPrev < countsPerBlock);
-		tPrev = tNow;
+		paceWait(service);
+		XTime_GetTime(&tNow);
 
 		// 1Hz progress update.
 		if((tNow - tStart) / COUNTS_PER_SECOND > sElapsed)
 		{
 			sElapsed = (tNow - tStart) / COUNTS_PER_SECOND;
 
-			rate = (float)((blocksWritten - blocksWrittenPrev) * BLOCK_SIZE) * 1e-6f;
+			rate = (float)((u64)(blocksWritten - blocksWrittenPrev) * (u64)cfg.blockSize) * 1e-6f;
 			blocksWrittenPrev = blocksWritten;
 
-			totalWrittenGB = (float)((u64)blocksWritten * (u64)BLOCK_SIZE) * 1e-9f;
+			totalWrittenGB = (float)((u64)blocksWritten * (u64)cfg.blockSize) * 1e-9f;
 
-			sprintf(strWorking, "%8d,%12.3f,%11.3f\r\n", sElapsed, rate, totalWrittenGB);
+			// Thermal governor adjusts the target write rate.
+			if (cfg.thermalGovernor)
+			{
+				rateLimit = thermalGovern(rate);
+				paceSetRate(rateLimit);
+			}
+
+			sprintf(strWorking, "%8d,%12.3f,%11.3f,%9.1f,%13.0f\r\n", sElapsed, rate, totalWrittenGB, thermalGetTemp(), rateLimit);
 			xil_printf(strWorking);
 		}
 
@@ -388,23 +1227,1502 @@ void fsWriteTest()
 		*(u32 *) data = blocksWritten;
 
 		// Write block.
-		f_write(&fil, data, BLOCK_SIZE, &bw);
+		if (cfg.fsStream == FS_STREAM_ROLL)
+		{
+			// Rolls to the next file by itself, normally one created ahead in idle time.
+			if (streamRollWrite(&fsRoll, data, lbaPerBlock) != STREAM_OK)
+			{
+				xil_printf("Failed to roll to the next file.\r\n");
+				break;
+			}
+			while(nvmeGetIOSlip() > cfg.slipAllowed)
+			{ nvmeServiceIOCompletions(16); }
+		}
+		else if (cfg.fsStream)
+		{
+			// Straight into the file's preallocated extent, at the raw disk test's queue depth.
+			status = streamWrite(&stream, data, lbaPerBlock);
+			if (status != STREAM_OK)
+			{
+				sprintf(strWorking, "Failed to write file %d. Error Code: %d\r\n", nFile, status);
+				xil_printf(strWorking);
+				break;
+			}
+			while(nvmeGetIOSlip() > cfg.slipAllowed)
+			{ nvmeServiceIOCompletions(16); }
+		}
+		else
+		{
+			f_write(&fil, data, cfg.blockSize, &bw);
+		}
 		blocksWritten++;
 		lbaDest += lbaPerBlock;
 
 		// Create new files as-needed.
-		if((blocksWritten % BLOCKS_PER_FILE) == 0)
+		if((cfg.fsStream != FS_STREAM_ROLL) && ((blocksWritten % cfg.blocksPerFile) == 0))
 		{
-			f_close(&fil);
+			fsFileClose(&fil, &stream);
 			nFile++;
-			sprintf(strWorking, "f%06d.bin\n", nFile);
-			f_open(&fil, strWorking, FA_CREATE_NEW | FA_WRITE);
+			fileOpen = fsFileOpen(&fil, &stream, nFile);
+			if (!fileOpen) { break; }
 		}
 	}
 
 	// Clean up file system.
-	f_close(&fil);
+	if (fileOpen) { fsFileClose(&fil, &stream); }
 	f_mount(0, "", 0);
+	writeBehind = 0;
+	disk_ioctl(0, CTRL_WRITE_BEHIND, &writeBehind);
+
+	testLogStop();
+
+	// Average rate over the whole test, for comparing runs.
+	XTime_GetTime(&tNow);
+	rate = (float)((u64)blocksWritten * (u64)cfg.blockSize) * 1e-6f / ((float)(tNow - tStart) / (float)COUNTS_PER_SECOND);
+	sprintf(strWorking, "Result: %d B blocks, %.3f GB, %.3f MB/s average.\r\n", cfg.blockSize,
+			(float)((u64)blocksWritten * (u64)cfg.blockSize) * 1e-9f, rate);
+	xil_printf(strWorking);
+
+	paceReport();
 
 	xil_printf("File system write test finished.\r\n");
+
+	return rate;
+}
+
+// File System Write Test: Create file number nFile, preallocated for blocks_per_file blocks in fs_stream mode.
+// Returns 0 if it couldn't be created.
+int fsFileOpen(FIL * fil, streamFile_type * stream, u32 nFile)
+{
+	char strWorking[128];
+	int status;
+
+	sprintf(strWorking, FS_FILE_FORMAT, nFile);
+	if (!cfg.fsStream)
+	{
+		f_open(fil, strWorking, FA_CREATE_NEW | FA_WRITE);
+		return 1;
+	}
+
+	if (cfg.fsStream == FS_STREAM_ROLL) { status = streamRollOpen(&fsRoll, FS_FILE_FORMAT, (u64)cfg.blocksPerFile * cfg.blockSize); }
+	else { status = streamOpen(stream, strWorking, (u64)cfg.blocksPerFile * cfg.blockSize); }
+	if (status != STREAM_OK)
+	{
+		sprintf(strWorking, "Failed to preallocate file %d. Error Code: %d\r\n", nFile, status);
+		xil_printf(strWorking);
+		return 0;
+	}
+
+	return 1;
+}
+
+// File System Write Test: Close the current file. In fs_stream mode, this waits for its writes and sets its size.
+void fsFileClose(FIL * fil, streamFile_type * stream)
+{
+	char strWorking[128];
+
+	if (cfg.fsStream == FS_STREAM_ROLL)
+	{
+		streamRollClose(&fsRoll);
+		sprintf(strWorking, "%u file rolls, %u of them waited for file system work.\r\n", fsRoll.rolls, fsRoll.rollsWaited);
+		xil_printf(strWorking);
+	}
+	else if (cfg.fsStream) { streamClose(stream); }
+	else { f_close(fil); }
+}
+
+// File System Write Test: Pacing idle time in rolling mode, used to finish the last file and create the next one.
+void fsRollService(void)
+{
+	nvmeServiceIOCompletions(16);
+	streamRollIdle(&fsRoll);
+}
+
+// Capture Emulation Test
+// A producer fills frames into a ring at the camera's frame rate, and the writer submits them to the SSD one block at
+// a time as queue slots free up. A frame buffer is reused only after all of its writes complete. Frames that arrive
+// while the ring is full are dropped, so the ring occupancy shows how much buffering absorbs the SSD's latency.
+float captureTest()
+{
+	char strWorking[128];
+
+	// Setup for capture test.
+	u32 lbaSize = nvmeGetLBASize();
+	u32 frameSize = (cfg.paceFrameSize + cfg.blockSize - 1) / cfg.blockSize * cfg.blockSize;
+	u32 lbaPerFrame = frameSize / lbaSize;
+	u32 lbaPerBlock = cfg.blockSize / lbaSize;
+	u64 framesToCapture = (u64)cfg.totalWrite * 1000000000ULL / frameSize;
+	u64 framesArrived = 0;
+	u64 framesFilled = 0;
+	u64 blocksWritten = 0;
+	u64 blocksWrittenPrev = 0;
+	u64 lbaDest = 0;
+	u8 * source = data + (u64)cfg.captureFrames * frameSize;
+	u8 * frame;
+	u8 * block;
+	u16 frameIdx;
+	u16 cid;
+	ampJob_type job;
+	float fps = (cfg.paceFPS > 0) ? (float)cfg.paceFPS : (float)cfg.targetWriteRate * 1e6f / (float)frameSize;
+
+	XTime tStart, tNow;
+	u32 sElapsed = 0;
+	float rate = 0.0f;
+	ringStats_type stats;
+
+	if ((u64)(cfg.captureFrames + 1) * frameSize > CAPTURE_BYTES_MAX)
+	{
+		xil_printf("Capture ring doesn't fit in the data buffer.\r\n");
+		return 0.0f;
+	}
+	if (ringInit(data, cfg.captureFrames, frameSize, cfg.blockSize) != RING_OK)
+	{
+		xil_printf("Bad capture ring configuration.\r\n");
+		return 0.0f;
+	}
+
+	// Synthetic sensor frame, copied into the ring for each frame in capture_fill mode 2.
+	if (cfg.captureFill == 2)
+	{
+		for (u32 i = 0; i < frameSize / sizeof(u32); i++) { ((u32 *) source)[i] = i * 0x9E3779B9; }
+	}
+
+	// Producer cores fill frames if configured. Stamping alone is left to this core.
+	captureAMP = (cfg.captureFill != 0) && (ampStart() > 0);
+	if (captureAMP) { ampResetStats(); }
+
+	// One token per frame, no burst: a late producer loses the frame just like a late consumer does.
+	paceInit(frameSize, (float)frameSize * fps * 1e-6f, 1);
+
+	sprintf(strWorking, "Capturing %d B frames at %.2f fps into %d buffers.\r\n", frameSize, fps, cfg.captureFrames);
+	xil_printf(strWorking);
+	xil_printf("Time [s], Rate [MB/s], Total [GB], Occupancy, Dropped\r\n");
+
+	ioErrors = 0;
+	XTime_GetTime(&tStart);
+	testLogStart();
+
+	while ((framesArrived < framesToCapture) || (ringGetOccupancy() > 0))
+	{
+		// Producer: A new frame is due.
+		if ((framesArrived < framesToCapture) && paceTry())
+		{
+			framesArrived++;
+			frame = ringAcquire(&frameIdx);
+			if (frame)
+			{
+				// Frames are written back-to-back in the order they were acquired, so this one lands at framesFilled.
+				frameSeq[frameIdx] = (u32) framesArrived;
+				job.op = (cfg.captureFill == 1) ? AMP_OP_FILL : AMP_OP_COPY;
+				job.buffer = frame;
+				job.source = source;
+				job.lba = framesFilled * lbaPerFrame;
+				job.numLBA = lbaPerFrame;
+				job.lbaSize = lbaSize;
+				job.pass = cfg.verifyPass;
+				job.seed = cfg.verifySeed;
+				job.tag = frameIdx;
+				framesFilled++;
+
+				if (captureAMP && ampSubmit(&job))
+				{
+					// Published by captureService() when the producer core is done.
+				}
+				else
+				{
+					if (cfg.captureFill == 1) { patternFill(frame, job.lba, lbaPerFrame, lbaSize, cfg.verifyPass, cfg.verifySeed); }
+					else if (cfg.captureFill == 2) { memcpy(frame, source, frameSize); }
+					if (cfg.captureFill != 1) { *(u32 *) frame = frameSeq[frameIdx]; }
+					ringPublish(frameIdx);
+				}
+			}
+		}
+
+		// Consumer: Write blocks from published frames while queue slots are free.
+		while (nvmeGetIOSlip() < cfg.slipAllowed)
+		{
+			block = ringConsume(&frameIdx);
+			if (!block) { break; }
+
+			// A block that can't be submitted is dropped along with its frame and doesn't take up disk space.
+			if (nvmeWriteCID(block, lbaDest, lbaPerBlock, &cid) != NVME_RW_OK)
+			{
+				ioErrors++;
+				ringRelease(frameIdx);
+				continue;
+			}
+			frameByCID[cid & (WORKLOAD_TRACK_SIZE - 1)] = frameIdx;
+			lbaDest += lbaPerBlock;
+			blocksWritten++;
+		}
+
+		captureService();
+
+		// 1Hz progress update.
+		XTime_GetTime(&tNow);
+		if ((tNow - tStart) / COUNTS_PER_SECOND > sElapsed)
+		{
+			sElapsed = (tNow - tStart) / COUNTS_PER_SECOND;
+
+			rate = (float)((blocksWritten - blocksWrittenPrev) * (u64)cfg.blockSize) * 1e-6f;
+			blocksWrittenPrev = blocksWritten;
+
+			ringGetStats(&stats);
+			sprintf(strWorking, "%8d,%12.3f,%11.3f,%10d,%8llu\r\n", sElapsed, rate,
+					(float)(blocksWritten * (u64)cfg.blockSize) * 1e-9f, ringGetOccupancy(),
+					(unsigned long long)stats.framesDropped);
+			xil_printf(strWorking);
+		}
+	}
+
+	// Finish all slipped commands so that the next test starts from an empty queue.
+	while (nvmeGetIOSlip() > 0)
+	{ captureService(); }
+
+	testLogStop();
+
+	// Average rate over the whole test, for comparing runs.
+	XTime_GetTime(&tNow);
+	rate = (float)(blocksWritten * (u64)cfg.blockSize) * 1e-6f / ((float)(tNow - tStart) / (float)COUNTS_PER_SECOND);
+	sprintf(strWorking, "Result: %d B blocks, %.3f GB, %.3f MB/s average.\r\n", cfg.blockSize,
+			(float)(blocksWritten * (u64)cfg.blockSize) * 1e-9f, rate);
+	xil_printf(strWorking);
+
+	captureReport();
+	if (ioErrors)
+	{
+		sprintf(strWorking, "%d I/O errors.\r\n", ioErrors);
+		xil_printf(strWorking);
+	}
+	if (captureAMP) { ampReport(tNow - tStart); }
+
+	xil_printf("Capture test finished.\r\n");
+
+	return rate;
+}
+
+// Capture Emulation: Retire completions, returning each frame to the producer after its last block.
+void captureService(void)
+{
+	nvmeCompletion_type completions[16];
+	ampJob_type job;
+	u32 nCompleted;
+
+	nCompleted = nvmeServiceIOCompletionsCID(completions, 16);
+	for (u32 c = 0; c < nCompleted; c++)
+	{
+		if (completions[c].status) { ioErrors++; }
+		ringRelease(frameByCID[completions[c].cid & (WORKLOAD_TRACK_SIZE - 1)]);
+	}
+
+	// Frames filled by producer cores.
+	while (captureAMP && ampPoll(&job))
+	{
+		if (job.op == AMP_OP_COPY) { *(u32 *) job.buffer = frameSeq[job.tag]; }
+		ringPublish(job.tag);
+	}
+}
+
+void captureReport(void)
+{
+	char strWorking[128];
+	ringStats_type stats;
+	u64 samples = 0;
+
+	ringGetStats(&stats);
+	sprintf(strWorking, "Frames: %llu written, %llu dropped, max occupancy %d of %d.\r\n",
+			(unsigned long long)stats.framesWritten, (unsigned long long)stats.framesDropped,
+			stats.occupancyMax, cfg.captureFrames);
+	xil_printf(strWorking);
+
+	for (u32 n = 0; n <= cfg.captureFrames; n++) { samples += stats.occupancyHist[n]; }
+	if (samples == 0) { return; }
+
+	xil_printf("Occupancy, Frames [%%]\r\n");
+	for (u32 n = 0; n <= cfg.captureFrames; n++)
+	{
+		if (stats.occupancyHist[n] == 0) { continue; }
+		sprintf(strWorking, "%9d,%11.3f\r\n", n, 100.0f * (float)stats.occupancyHist[n] / (float)samples);
+		xil_printf(strWorking);
+	}
+}
+
+// Preconditioning and Steady-State Test
+// Brings the drive out of its fresh-out-of-box state by writing it sequentially precon_passes times, or randomly
+// precon_fill % of its capacity, then runs ss_round_gb write rounds of the same kind until throughput and average
+// latency over the last ss_window rounds are both within the excursion and slope limits (SNIA SSS PTS style).
+void preconditionTest()
+{
+	char strWorking[128];
+	u64 capacity = nvmeGetLBACount() * nvmeGetLBASize();
+	u64 preconBytes;
+	float ssRate[SS_ROUNDS_LIMIT];
+	float ssLatency[SS_ROUNDS_LIMIT];
+	sustainedResult_type round;
+	steadyResult_type rateResult, latencyResult;
+	u8 random = cfg.preconMode;
+	u32 r, first;
+
+	sustainedCursor = 0;
+	testLogStart();
+
+	// Preconditioning.
+	if (random) { preconBytes = capacity / 100 * cfg.preconFill; }
+	else { preconBytes = capacity * cfg.preconPasses; }
+
+	sprintf(strWorking, "Preconditioning: %.3f GB of %s writes.\r\n", (float)preconBytes * 1e-9f, random ? "random" : "sequential");
+	xil_printf(strWorking);
+	sustainedWrite(preconBytes, random, 1, &round, NULL);
+	sprintf(strWorking, "Preconditioning done: %.3f MB/s average.\r\n", round.rate);
+	xil_printf(strWorking);
+
+	// Measurement rounds.
+	xil_printf("Round, Rate [MB/s], Latency Avg [us], Latency Max [us], Rate Steady, Latency Steady\r\n");
+	for (r = 0; r < cfg.ssRoundsMax; r++)
+	{
+		sustainedWrite((u64)cfg.ssRoundGB * 1000000000ULL, random, 0, &round, NULL);
+		ssRate[r] = round.rate;
+		ssLatency[r] = round.latencyAvg;
+
+		rateResult.steady = 0;
+		latencyResult.steady = 0;
+		if (r + 1 >= cfg.ssWindow)
+		{
+			first = r + 1 - cfg.ssWindow;
+			steadyCheck(&ssRate[first], cfg.ssWindow, cfg.ssExcursion * 0.01f, cfg.ssSlope * 0.01f, &rateResult);
+			steadyCheck(&ssLatency[first], cfg.ssWindow, cfg.ssExcursion * 0.01f, cfg.ssSlope * 0.01f, &latencyResult);
+		}
+
+		sprintf(strWorking, "%5d,%12.3f,%18.1f,%18.1f,%12d,%15d\r\n", r + 1, round.rate, round.latencyAvg, round.latencyMax,
+				rateResult.steady, latencyResult.steady);
+		xil_printf(strWorking);
+
+		if (rateResult.steady && latencyResult.steady) { break; }
+	}
+
+	testLogStop();
+
+	if (r < cfg.ssRoundsMax)
+	{
+		sprintf(strWorking, "Steady state reached in rounds %d-%d.\r\n", r + 2 - cfg.ssWindow, r + 1);
+		xil_printf(strWorking);
+		sprintf(strWorking, "Result: %.3f MB/s (range %.1f%%, slope %.1f%%), %.1f us average latency (range %.1f%%, slope %.1f%%).\r\n",
+				rateResult.average, rateResult.excursion * 100.0f, rateResult.slopeExcursion * 100.0f,
+				latencyResult.average, latencyResult.excursion * 100.0f, latencyResult.slopeExcursion * 100.0f);
+		xil_printf(strWorking);
+	}
+	else
+	{
+		xil_printf("Steady state not reached.\r\n");
+	}
+
+	xil_printf("Preconditioning test finished.\r\n");
+}
+
+// SLC Cache Characterization Test
+// Writes sequentially until the rate falls off the SLC cache cliff, then for slc_post_s more, and reports the burst
+// rate, cache size, post-cache rate and later rate steps (e.g. GC). Then runs write/idle/write cycles with doubling
+// idle times, measuring how much fast cache each idle time restores.
+void slcTest()
+{
+	char strWorking[160];
+	rateSeries_type series;
+	sustainedResult_type result;
+	slcTransition_type transitions[SLC_TRANSITIONS_MAX];
+	u32 nTransitions, idle;
+	float burst, post, cacheGB, probeGB;
+
+	series.rate = slcSeries;
+	series.max = SLC_SERIES_MAX;
+	series.intervalMs = cfg.slcIntervalMs;
+	series.cliffFraction = cfg.slcDrop * 0.01f;
+	series.settle = cfg.slcSettle;
+	series.postSamples = cfg.slcPostS * 1000 / cfg.slcIntervalMs;
+
+	sustainedCursor = 0;
+	testLogStart();
+
+	// Initial fill, through the cliff.
+	xil_printf("Writing until the SLC cache is exhausted.\r\n");
+	sustainedWrite((u64)cfg.slcMaxGB * 1000000000ULL, 0, 1, &result, &series);
+
+	burst = slcBurstLevel(series.rate, series.n, series.settle);
+	if (series.cliff >= series.n)
+	{
+		sprintf(strWorking, "No cache cliff within %d GB. Rate: %.3f MB/s.\r\n", cfg.slcMaxGB, result.rate);
+		xil_printf(strWorking);
+		testLogStop();
+		return;
+	}
+
+	cacheGB = seriesBytes(&series, 0, series.cliff) * 1e-9f;
+	post = slcMean(series.rate, (series.cliff + series.settle < series.n) ? series.cliff + series.settle : series.cliff, series.n);
+	sprintf(strWorking, "Burst rate: %.3f MB/s. Cache exhausted after %.3f s, %.3f GB. Post-cache rate: %.3f MB/s.\r\n",
+			burst, (float)series.cliff * series.intervalMs * 0.001f, cacheGB, post);
+	xil_printf(strWorking);
+
+	nTransitions = slcFindTransitions(series.rate, series.n, cfg.slcGCStep * 0.01f, series.settle, transitions, SLC_TRANSITIONS_MAX);
+	if (nTransitions > 0)
+	{
+		xil_printf("Time [s], Before [MB/s], After [MB/s]\r\n");
+		for (u32 t = 0; t < nTransitions; t++)
+		{
+			sprintf(strWorking, "%8.1f,%14.3f,%13.3f\r\n", (float)transitions[t].index * series.intervalMs * 0.001f,
+					transitions[t].before, transitions[t].after);
+			xil_printf(strWorking);
+		}
+	}
+
+	// Write/idle/write cycles. Each probe writes up to twice the initial cache size, stopping shortly after its cliff.
+	if (cfg.slcIdleSteps > 0)
+	{
+		series.postSamples = series.settle;
+		probeGB = 2.0f * cacheGB + 1.0f;
+		xil_printf("Idle [s], Recovered [GB], Burst [MB/s], Post [MB/s]\r\n");
+	}
+	for (u32 k = 0; k < cfg.slcIdleSteps; k++)
+	{
+		idle = cfg.slcIdleS << k;
+		if (cfg.perfLog) { perfLogMark(idle); }
+		sleep(idle);
+
+		sustainedWrite((u64)(probeGB * 1e9f), 0, 0, &result, &series);
+		burst = slcBurstLevel(series.rate, series.n, series.settle);
+		post = slcMean(series.rate, series.cliff, series.n);
+		sprintf(strWorking, "%8d,%s%14.3f,%13.3f,%12.3f\r\n", idle, (series.cliff >= series.n) ? ">" : " ",
+				seriesBytes(&series, 0, series.cliff) * 1e-9f, burst, post);
+		xil_printf(strWorking);
+	}
+
+	testLogStop();
+
+	xil_printf("SLC cache test finished.\r\n");
+}
+
+// Multi-Core Submission Stress Test
+// Core 0 and each producer core write their own LBA region at the same time, each keeping stress_qd writes in flight
+// and all of them reaping completions, so SQ slot reservation, doorbell ordering and CQ reaping are contended from up
+// to four cores. The regions are then read back and checked, which catches lost, repeated or misplaced commands.
+void stressTest()
+{
+	char strWorking[160];
+	u32 lbaSize = nvmeGetLBASize();
+	u32 lbaPerBlock = cfg.blockSize / lbaSize;
+	u64 regionLBA = (u64)cfg.stressCmds * lbaPerBlock;
+	u32 lbaPerRead = nvmeGetMaxTransferSize() / lbaSize;
+	u32 nCores, nPending, n;
+	u64 lba, lbaEnd, issued = 0, completed = 0;
+	u16 cid, status;
+	ampJob_type job;
+	stressWorker_type * w;
+	XTime tStart, tEnd, tNow;
+
+	nCores = ampStart() + 1;
+	if (regionLBA * nCores > nvmeGetLBACount())
+	{
+		xil_printf("stress_cmds blocks per core don't fit on the drive.\r\n");
+		return;
+	}
+
+	sprintf(strWorking, "Stress test: %d cores, %d writes of %d B each, %d in flight per core.\r\n",
+			nCores, cfg.stressCmds, cfg.blockSize, cfg.stressQD);
+	xil_printf(strWorking);
+
+	memset(stressWorkers, 0, sizeof(stressWorkers));
+	for (u32 core = 0; core < nCores; core++)
+	{
+		stressWorkers[core].buffer = data + (u64)core * STRESS_QD_MAX * cfg.blockSize;
+		stressWorkers[core].lba = core * regionLBA;
+		stressWorkers[core].lbaPerBlock = lbaPerBlock;
+	}
+
+	// Start the producers one job apiece, then run core 0's share here.
+	XTime_GetTime(&tStart);
+	memset(&job, 0, sizeof(ampJob_type));
+	job.op = AMP_OP_RUN;
+	job.run = stressWorker;
+	for (u32 core = 1; core < nCores; core++)
+	{
+		job.arg = &stressWorkers[core];
+		job.tag = core;
+		ampSubmit(&job);
+	}
+	stressWorker(&stressWorkers[0]);
+
+	nPending = nCores - 1;
+	while (nPending > 0)
+	{
+		if (ampPoll(&job)) { nPending--; }
+		else { ioServiceCompletions(); }
+	}
+	XTime_GetTime(&tEnd);
+
+	// Anything a timed-out core left behind.
+	XTime_GetTime(&tNow);
+	while ((nvmeGetIOSlip() > 0) && ((tNow - tEnd) < (u64)STRESS_TIMEOUT_MS * COUNTS_PER_SECOND / 1000))
+	{
+		ioServiceCompletions();
+		XTime_GetTime(&tNow);
+	}
+
+	for (u32 core = 0; core < nCores; core++)
+	{
+		w = &stressWorkers[core];
+		sprintf(strWorking, "Core %d: %u written, %u errors, %u queue full retries, %u lost.\r\n",
+				core, w->completed, w->errors, w->retries, w->lost);
+		xil_printf(strWorking);
+		issued += w->issued;
+		completed += w->completed;
+	}
+	sprintf(strWorking, "%llu writes in %.3f s: %.0f IOPS, %.3f MB/s. %d commands never completed.\r\n",
+			(unsigned long long)completed, (float)(tEnd - tStart) / COUNTS_PER_SECOND,
+			(float)completed * COUNTS_PER_SECOND / (float)(tEnd - tStart),
+			(float)(completed * cfg.blockSize) * COUNTS_PER_SECOND / (float)(tEnd - tStart) * 1e-6f, nvmeGetIOSlip());
+	xil_printf(strWorking);
+
+	// Read back every block each core submitted, one read at a time from core 0.
+	xil_printf("Checking...\r\n");
+	patternResetStats(&verifyStats);
+	ioErrors = 0;
+	ioSlotAMP = 0;
+	for (u32 core = 0; core < nCores; core++)
+	{
+		lbaEnd = stressWorkers[core].lba + (u64)stressWorkers[core].issued * lbaPerBlock;
+		for (lba = stressWorkers[core].lba; lba < lbaEnd; lba += n)
+		{
+			n = ((lbaEnd - lba) < lbaPerRead) ? (u32)(lbaEnd - lba) : lbaPerRead;
+			if (nvmeReadCID(data, lba, n, &cid) != NVME_RW_OK) { ioErrors++; continue; }
+			while (!nvmeIsIOComplete(cid, &status)) { ioServiceCompletions(); }
+			if (status) { ioErrors++; continue; }
+			patternCheck(data, lba, n, lbaSize, cfg.verifyPass, cfg.verifySeed, &verifyStats);
+		}
+	}
+	verifyReport();
+
+	xil_printf("Stress test finished.\r\n");
+}
+
+// Allocation Bitmap Scan Benchmark
+// Formats the drive, then fragments the exFAT allocation bitmap on disk: runs of 1-64 clusters in use (one in eight up
+// to 64K) separated by free gaps shorter than BITMAP_RUN, leaving only the end of the volume free. Then times finding
+// BITMAP_RUN contiguous clusters with f_expand(), which has to scan the whole bitmap. A small fs_au_size makes a large
+// bitmap. Build with FF_FAST_BITMAP 0 and 1 to compare the scanners. The first search reads the bitmap from the drive
+// through the sector window (the word scan with prefetch_window()), the second scans the RAM mirror, if the bitmap fits
+// in FF_BITMAP_MIRROR.
+void bitmapTest()
+{
+	char strWorking[160];
+	static FATFS fs;
+	MKFS_PARM opt;
+	BYTE work[FF_MAX_SS];
+	FRESULT res;
+	u32 lbaSize = nvmeGetLBASize();
+	u32 bitsPerSect = lbaSize * 8;
+	u32 sectPerChunk = BLOCK_SIZE_MAX / lbaSize;
+	u32 nBit, nBitmapSect, bitEnd, n, clst;
+	u32 runLeft = 0;
+	u8 runUsed = 0;
+	u64 v, vEnd;
+	float ms;
+
+	xil_printf("Allocation bitmap scan benchmark started.\r\n");
+	xil_printf("Formatting disk...\r\n");
+
+	opt.fmt = FM_EXFAT;
+	opt.au_size = cfg.fsAUSize;
+	opt.align = 1;
+	opt.n_fat = 1;
+	opt.n_root = 512;
+	res = f_mkfs("", &opt, work, sizeof work);
+	if (res)
+	{
+		xil_printf("Failed to create file system on disk.\r\n");
+		return;
+	}
+	res = f_mount(&fs, "", 1);
+	if (res)
+	{
+		xil_printf("Failed to mount disk.\r\n");
+		return;
+	}
+
+	nBit = fs.n_fatent - 2;
+	nBitmapSect = (nBit + bitsPerSect - 1) / bitsPerSect;
+	bitEnd = (nBit > 2 * BITMAP_RUN) ? (nBit - 2 * BITMAP_RUN) : 0;
+	sprintf(strWorking, "%u clusters, %u bitmap sectors. Fragmenting the bitmap...\r\n", nBit, nBitmapSect);
+	xil_printf(strWorking);
+
+	// Fragment the bitmap in place, a data buffer at a time. Clusters already allocated by the format stay in use.
+	for (u32 s = 0; s < nBitmapSect; s += n)
+	{
+		n = ((nBitmapSect - s) < sectPerChunk) ? (nBitmapSect - s) : sectPerChunk;
+		if (disk_read(0, data, fs.bitbase + s, n) != RES_OK) { break; }
+
+		vEnd = (u64)(s + n) * bitsPerSect;
+		if (vEnd > bitEnd) { vEnd = bitEnd; }
+		for (v = (u64)s * bitsPerSect; v < vEnd; v++)
+		{
+			if (runLeft == 0)
+			{
+				runUsed ^= 1;
+				if (runUsed) { runLeft = 1 + (u32)(workloadRand() % (((workloadRand() & 7) == 0) ? 65536 : 64)); }
+				else { runLeft = 1 + (u32)(workloadRand() % (BITMAP_RUN - 1)); }
+			}
+			if (runUsed) { data[(v - (u64)s * bitsPerSect) / 8] |= 1 << (v % 8); }
+			runLeft--;
+		}
+
+		if (disk_write(0, data, fs.bitbase + s, n) != RES_OK) { break; }
+	}
+	while (nvmeGetIOSlip() > 0) { nvmeServiceIOCompletions(16); }
+
+	for (u8 mirror = 0; mirror < 2; mirror++)
+	{
+		res = bitmapSearch(&fs, mirror, &clst, &ms);
+		if (res == FR_NOT_ENABLED)
+		{
+			xil_printf("Mirror: The bitmap doesn't fit in FF_BITMAP_MIRROR, skipped.\r\n");
+			continue;
+		}
+		if (res)
+		{
+			sprintf(strWorking, "Contiguous cluster search failed. Error Code: %d\r\n", res);
+			xil_printf(strWorking);
+			return;
+		}
+
+		sprintf(strWorking, "%s: %u clusters found at cluster %u, %u bits scanned in %.3f ms (%.1f Mbit/s, %s scan).\r\n",
+				mirror ? "Mirror" : "Drive", BITMAP_RUN, clst, clst - 2 + BITMAP_RUN, ms,
+				(float)(clst - 2 + BITMAP_RUN) * 1e-3f / ms, FF_FAST_BITMAP ? "word" : "bit");
+		xil_printf(strWorking);
+	}
+
+	xil_printf("Allocation bitmap scan benchmark finished.\r\n");
+}
+
+// Allocation Bitmap Scan Benchmark: Remount so that none of the bitmap is cached, then time f_expand() searching from
+// the top of the volume, through the mirror or through the sector window. The file is deleted again, so that every
+// search scans the same bitmap. Returns FR_NOT_ENABLED if the mirror is asked for but doesn't hold the bitmap.
+FRESULT bitmapSearch(FATFS * fs, u8 mirror, u32 * clst, float * ms)
+{
+	static FIL fil;
+	LBA_t sect, nSect;
+	FRESULT res;
+	XTime tStart, tEnd;
+
+	f_mount(0, "", 0);
+	res = f_mount(fs, "", 1);
+	if (res) { return res; }
+
+#if FF_BITMAP_MIRROR
+	// Right after mounting, the bitmap on the drive is the same as the mirror, so the mirror can just be dropped.
+	if (!mirror) { fs->bm_buf = 0; }
+	if (mirror && !fs->bm_buf) { f_mount(0, "", 0); return FR_NOT_ENABLED; }
+#else
+	if (mirror) { f_mount(0, "", 0); return FR_NOT_ENABLED; }
+#endif
+
+	res = f_open(&fil, "bitmap.bin", FA_CREATE_ALWAYS | FA_WRITE);
+	if (res) { f_mount(0, "", 0); return res; }
+
+	XTime_GetTime(&tStart);
+	res = f_expand(&fil, (FSIZE_t)BITMAP_RUN * fs->csize * nvmeGetLBASize(), 1);
+	XTime_GetTime(&tEnd);
+	if (res == FR_OK) { res = f_extent(&fil, &sect, &nSect); }
+	f_close(&fil);
+	if (res == FR_OK) { res = f_unlink("bitmap.bin"); }
+	f_mount(0, "", 0);
+	if (res) { return res; }
+
+	*clst = (u32)((sect - fs->database) / fs->csize) + 2;
+	*ms = (float)(tEnd - tStart) * 1000.0f / (float)COUNTS_PER_SECOND;
+
+	return FR_OK;
+}
+
+// Vectored I/O Self-Test
+// Writes IOV_BYTES of the verify pattern from scattered segments with nvmeWritev(), checks it with a contiguous read,
+// then reads it back into the segments with nvmeReadv() and checks that too. The PRP layout uses whole pages with a
+// page gap between them. The SGL layout uses one LBA per segment at odd DWORD offsets, which only SGLs can describe.
+void iovTest()
+{
+	char strWorking[128];
+	static nvmeIOVec_type iov[IOV_SEG_MAX];
+	u32 lbaSize = nvmeGetLBASize();
+	u8 * source = data;
+	u8 * check = data + IOV_BYTES;
+	u8 * segments = data + 2 * IOV_BYTES;
+	u16 nSeg;
+	int status;
+
+	patternResetStats(&verifyStats);
+	ioErrors = 0;
+	ioSlotAMP = 0;
+
+	// PRP: Page-aligned segments of one page each.
+	nSeg = IOV_BYTES >> 12;
+	for (u16 i = 0; i < nSeg; i++)
+	{
+		iov[i].base = segments + ((u64)i << 13);
+		iov[i].len = 1 << 12;
+	}
+	status = iovRun(iov, nSeg, 0, source, check);
+	sprintf(strWorking, "PRP: %d segments, %s.\r\n", nSeg, (status == NVME_RW_OK) ? "submitted" : "rejected");
+	xil_printf(strWorking);
+
+	// SGL: One LBA per segment, DWORD- but not page-aligned.
+	nSeg = IOV_BYTES / lbaSize;
+	for (u16 i = 0; i < nSeg; i++)
+	{
+		iov[i].base = segments + (u64)i * (lbaSize + 4096) + 4 * (i + 1);
+		iov[i].len = lbaSize;
+	}
+	status = iovRun(iov, nSeg, IOV_BYTES / lbaSize, source, check);
+	if (status == NVME_RW_BAD_ALIGNMENT) { xil_printf("SGL: Not supported by the drive, skipped.\r\n"); }
+	else
+	{
+		sprintf(strWorking, "SGL: %d segments, %s.\r\n", nSeg, (status == NVME_RW_OK) ? "submitted" : "rejected");
+		xil_printf(strWorking);
+	}
+
+	verifyReport();
+
+	xil_printf("Vectored I/O test finished.\r\n");
+}
+
+// Vectored I/O Self-Test: Write the pattern for lba through the segments, then check it read contiguously and read
+// back through the segments. Returns the NVME_RW_* status of the first rejected submission.
+int iovRun(const nvmeIOVec_type * iov, u16 iovCount, u64 lba, u8 * source, u8 * check)
+{
+	u32 lbaSize = nvmeGetLBASize();
+	u32 numLBA = IOV_BYTES / lbaSize;
+	u32 offset;
+	int status;
+
+	patternFill(source, lba, numLBA, lbaSize, cfg.verifyPass, cfg.verifySeed);
+	offset = 0;
+	for (u16 i = 0; i < iovCount; i++)
+	{
+		memcpy(iov[i].base, source + offset, iov[i].len);
+		offset += iov[i].len;
+	}
+
+	status = nvmeWritev(iov, iovCount, lba);
+	if (status != NVME_RW_OK) { return status; }
+	ioErrors += iovWait();
+
+	// Gathered correctly?
+	memset(check, 0, IOV_BYTES);
+	status = nvmeRead(check, lba, numLBA);
+	if (status != NVME_RW_OK) { return status; }
+	ioErrors += iovWait();
+	patternCheck(check, lba, numLBA, lbaSize, cfg.verifyPass, cfg.verifySeed, &verifyStats);
+
+	// Scattered correctly?
+	for (u16 i = 0; i < iovCount; i++) { memset(iov[i].base, 0, iov[i].len); }
+	status = nvmeReadv(iov, iovCount, lba);
+	if (status != NVME_RW_OK) { return status; }
+	ioErrors += iovWait();
+	offset = 0;
+	for (u16 i = 0; i < iovCount; i++)
+	{
+		memcpy(check + offset, iov[i].base, iov[i].len);
+		offset += iov[i].len;
+	}
+	patternCheck(check, lba, numLBA, lbaSize, cfg.verifyPass, cfg.verifySeed, &verifyStats);
+
+	return NVME_RW_OK;
+}
+
+// Vectored I/O Self-Test: Wait for everything in flight. Returns the number of commands that failed.
+int iovWait(void)
+{
+	nvmeCompletion_type completions[16];
+	int nErrors = 0;
+	int nCompleted;
+
+	while (nvmeGetIOSlip() > 0)
+	{
+		nCompleted = nvmeServiceIOCompletionsCID(completions, 16);
+		for (int c = 0; c < nCompleted; c++) { if (completions[c].status) { nErrors++; } }
+	}
+
+	return nErrors;
+}
+
+// Stress Test: One core's share. Runs on core 0 and, as an AMP_OP_RUN job, on each producer core. Writes its region in
+// order, refilling each buffer with the verify pattern once its previous write has completed, and reaps completions for
+// every core in between. Gives up if none of its writes completes for STRESS_TIMEOUT_MS.
+void stressWorker(void * arg)
+{
+	stressWorker_type * w = (stressWorker_type *) arg;
+	u32 lbaSize = nvmeGetLBASize();
+	u16 cid[STRESS_QD_MAX];
+	u8 busy[STRESS_QD_MAX] = {0};
+	u8 filled[STRESS_QD_MAX] = {0};
+	u32 inFlight = 0;
+	u16 status;
+	u8 * block;
+	int result;
+	XTime tLast, tNow;
+
+	XTime_GetTime(&tLast);
+	while ((w->issued < cfg.stressCmds) || (inFlight > 0))
+	{
+		for (u32 s = 0; s < cfg.stressQD; s++)
+		{
+			if (busy[s] && nvmeIsIOComplete(cid[s], &status))
+			{
+				busy[s] = 0;
+				inFlight--;
+				w->completed++;
+				if (status) { w->errors++; }
+				XTime_GetTime(&tLast);
+			}
+
+			if (busy[s] || (w->issued >= cfg.stressCmds)) { continue; }
+
+			block = w->buffer + (u64)s * cfg.blockSize;
+			if (!filled[s])
+			{
+				patternFill(block, w->lba + (u64)w->issued * w->lbaPerBlock, w->lbaPerBlock, lbaSize,
+						    cfg.verifyPass, cfg.verifySeed);
+				filled[s] = 1;
+			}
+
+			result = nvmeWriteCID(block, w->lba + (u64)w->issued * w->lbaPerBlock, w->lbaPerBlock, &cid[s]);
+			if (result == NVME_RW_QUEUE_FULL) { w->retries++; continue; }
+
+			filled[s] = 0;
+			w->issued++;
+			if (result != NVME_RW_OK) { w->errors++; continue; }
+			busy[s] = 1;
+			inFlight++;
+		}
+
+		nvmeServiceIOCompletions(16);
+
+		XTime_GetTime(&tNow);
+		if ((inFlight > 0) && ((tNow - tLast) > (u64)STRESS_TIMEOUT_MS * COUNTS_PER_SECOND / 1000))
+		{
+			w->lost = inFlight;
+			break;
+		}
+	}
+}
+
+// Unthrottled writes of block_size at slip_allowed queue depth, sequential from where the previous call stopped
+// (wrapping at the end of the drive) or at random block-aligned LBAs. Measures throughput and latency, and optionally
+// records the completed write rate per interval into series, stopping early after a cliff if one is configured.
+void sustainedWrite(u64 bytes, u8 random, u8 progress, sustainedResult_type * result, rateSeries_type * series)
+{
+	char strWorking[128];
+	nvmeCompletion_type completions[16];
+	u32 lbaPerBlock = cfg.blockSize / nvmeGetLBASize();
+	u64 nBlocksDrive = nvmeGetLBACount() / lbaPerBlock;
+	u64 blocksToWrite = bytes / cfg.blockSize;
+	u64 blocksWritten = 0;
+	u64 blocksWrittenPrev = 0;
+	u64 block;
+	u64 latencySum = 0;
+	u32 latencyMax = 0;
+	u64 nCompletedTotal = 0;
+	u64 nCompletedPrev = 0;
+	u32 nCompleted;
+	u32 cliffFrom = 0;
+	u32 cliff;
+
+	XTime tStart, tNow, tSample = 0;
+	u64 countsPerSample = 0;
+	u32 sElapsed = 0;
+	float rate;
+
+	XTime_GetTime(&tStart);
+
+	if (series)
+	{
+		series->n = 0;
+		series->cliff = 0;
+		countsPerSample = (u64)series->intervalMs * COUNTS_PER_SECOND / 1000;
+		tSample = tStart + countsPerSample;
+	}
+
+	if (progress) { xil_printf("Time [s], Rate [MB/s], Total [GB]\r\n"); }
+
+	while ((blocksWritten < blocksToWrite) || (nvmeGetIOSlip() > 0))
+	{
+		// Keep the queue full.
+		while ((blocksWritten < blocksToWrite) && (nvmeGetIOSlip() < cfg.slipAllowed))
+		{
+			if (random) { block = workloadRand() % nBlocksDrive; }
+			else
+			{
+				block = sustainedCursor;
+				sustainedCursor = (sustainedCursor + 1) % nBlocksDrive;
+			}
+			nvmeWrite(data, block * lbaPerBlock, lbaPerBlock);
+			blocksWritten++;
+		}
+
+		nCompleted = nvmeServiceIOCompletionsCID(completions, 16);
+		for (u32 c = 0; c < nCompleted; c++)
+		{
+			latencySum += completions[c].latency;
+			if (completions[c].latency > latencyMax) { latencyMax = completions[c].latency; }
+		}
+		nCompletedTotal += nCompleted;
+
+		// Rate series sample.
+		if (series)
+		{
+			XTime_GetTime(&tNow);
+			if (tNow >= tSample)
+			{
+				series->rate[series->n++] = (float)((nCompletedTotal - nCompletedPrev) * (u64)cfg.blockSize) * 1e-6f
+										  * 1000.0f / (float)series->intervalMs;
+				nCompletedPrev = nCompletedTotal;
+				tSample += countsPerSample;
+
+				// Stop submitting once the series is full, or postSamples after the cliff.
+				if (series->cliffFraction > 0.0f)
+				{
+					if (series->cliff == 0)
+					{
+						cliff = slcFindCliff(series->rate, series->n, series->cliffFraction, series->settle, cliffFrom);
+						if (cliff < series->n) { series->cliff = cliff; }
+						else if (series->n > series->settle) { cliffFrom = series->n - series->settle; }
+					}
+					if ((series->cliff > 0) && (series->n >= series->cliff + series->postSamples)) { blocksToWrite = blocksWritten; }
+				}
+				if (series->n == series->max) { blocksToWrite = blocksWritten; }
+			}
+		}
+
+		// 1Hz progress update.
+		if (progress)
+		{
+			XTime_GetTime(&tNow);
+			if ((tNow - tStart) / COUNTS_PER_SECOND > sElapsed)
+			{
+				sElapsed = (tNow - tStart) / COUNTS_PER_SECOND;
+				rate = (float)((blocksWritten - blocksWrittenPrev) * (u64)cfg.blockSize) * 1e-6f;
+				blocksWrittenPrev = blocksWritten;
+				sprintf(strWorking, "%8d,%12.3f,%11.3f\r\n", sElapsed, rate, (float)(blocksWritten * (u64)cfg.blockSize) * 1e-9f);
+				xil_printf(strWorking);
+			}
+		}
+	}
+
+	XTime_GetTime(&tNow);
+	result->rate = (float)(blocksWritten * (u64)cfg.blockSize) * 1e-6f / ((float)(tNow - tStart) / (float)COUNTS_PER_SECOND);
+	result->latencyAvg = (nCompletedTotal > 0) ? (float)latencySum / (float)nCompletedTotal * 1e6f / (float)COUNTS_PER_SECOND : 0.0f;
+	result->latencyMax = (float)latencyMax * 1e6f / (float)COUNTS_PER_SECOND;
+
+	if (series && (series->cliff == 0)) { series->cliff = series->n; }
+}
+
+// Bytes written over samples [from, to) of a rate series.
+float seriesBytes(const rateSeries_type * series, u32 from, u32 to)
+{
+	return slcMean(series->rate, from, to) * (float)(to - from) * 1e6f * (float)series->intervalMs * 0.001f;
+}
+
+// Performance Log: Start and stop recording around a test, if enabled.
+void testLogStart(void)
+{
+	if (cfg.perfLog)
+	{
+		perfLogStart(cfg.perfIntervalUs, cfg.perfLatEvery);
+	}
+}
+
+void testLogStop(void)
+{
+	char strWorking[128];
+
+	if (cfg.perfLog)
+	{
+		perfLogStop();
+		sprintf(strWorking, "Performance log: %llu records.\r\n", (unsigned long long)perfLogGetCount());
+		xil_printf(strWorking);
+	}
+}
+
+// Rate Limiter: Start pacing at rate in [MB/s], or at the configured frame cadence.
+void paceStart(float rate)
+{
+	if (cfg.paceFPS > 0)
+	{
+		paceInitFrames(cfg.blockSize, (float)cfg.paceFPS, cfg.paceFrameSize, cfg.paceBurst);
+	}
+	else
+	{
+		paceInit(cfg.blockSize, rate, cfg.paceBurst);
+	}
+}
+
+void paceReport(void)
+{
+	char strWorking[128];
+	paceStats_type stats;
+
+	paceGetStats(&stats);
+	sprintf(strWorking, "Pacing: %.3f GB dropped, %u of %u blocks max backlog.\r\n",
+			(float)(stats.blocksDropped * (u64)cfg.blockSize) * 1e-9f, stats.backlogMax, stats.depth);
+	xil_printf(strWorking);
+}
+
+void ioServiceCompletions(void)
+{
+	nvmeServiceIOCompletions(16);
+}
+
+// Data Buffer Slots: Buffer for a slot, one block apiece after the start of the data buffer.
+u8 * ioSlotBuffer(u32 slot)
+{
+	return data + (u64)slot * cfg.blockSize;
+}
+
+// Data Buffer Slots: Submit a block read or write from a slot's buffer and mark the slot busy until it completes.
+void ioSlotSubmit(u32 slot, u64 lba, u32 lbaPerBlock, u8 read)
+{
+	u16 cid;
+	int status;
+
+	if (read) { status = nvmeReadCID(ioSlotBuffer(slot), lba, lbaPerBlock, &cid); }
+	else { status = nvmeWriteCID(ioSlotBuffer(slot), lba, lbaPerBlock, &cid); }
+	if (status != NVME_RW_OK) { ioErrors++; return; }
+
+	ioSlotByCID[cid & (WORKLOAD_TRACK_SIZE - 1)] = slot;
+	ioSlot[slot].state = SLOT_IO;
+	ioSlot[slot].check = read;
+	ioSlot[slot].lba = lba;
+}
+
+// Data Buffer Slots: Retire completions, freeing their slots and checking read data. With producer cores, checks are
+// handed to them, and finished fills and checks are collected.
+void ioSlotService(void)
+{
+	nvmeCompletion_type completions[16];
+	ampJob_type job;
+	u32 nCompleted;
+	u32 slot;
+
+	nCompleted = nvmeServiceIOCompletionsCID(completions, 16);
+	for (u32 c = 0; c < nCompleted; c++)
+	{
+		slot = ioSlotByCID[completions[c].cid & (WORKLOAD_TRACK_SIZE - 1)];
+		ioSlot[slot].state = SLOT_FREE;
+
+		if (completions[c].status)
+		{
+			ioErrors++;
+		}
+		else if (ioSlot[slot].check && ioSlotAMP)
+		{
+			job.op = AMP_OP_CHECK;
+			job.buffer = ioSlotBuffer(slot);
+			job.lba = ioSlot[slot].lba;
+			job.numLBA = cfg.blockSize / nvmeGetLBASize();
+			job.lbaSize = nvmeGetLBASize();
+			job.pass = cfg.verifyPass;
+			job.seed = cfg.verifySeed;
+			job.tag = slot;
+			if (ampSubmit(&job)) { ioSlot[slot].state = SLOT_CHECKING; }
+			else
+			{
+				patternCheck(job.buffer, job.lba, job.numLBA, job.lbaSize, job.pass, job.seed, &verifyStats);
+			}
+		}
+		else if (ioSlot[slot].check)
+		{
+			patternCheck(ioSlotBuffer(slot), ioSlot[slot].lba, cfg.blockSize / nvmeGetLBASize(), nvmeGetLBASize(),
+					     cfg.verifyPass, cfg.verifySeed, &verifyStats);
+		}
+	}
+
+	if (!ioSlotAMP) { return; }
+
+	// Finished fills are ready to write, finished checks free their slots.
+	while (ampPoll(&job))
+	{
+		ioSlot[job.tag].state = (job.op == AMP_OP_FILL) ? SLOT_READY : SLOT_FREE;
+	}
+	ioSlotFillAhead();
+}
+
+// Data Buffer Slots: Slots in use, one per command allowed in flight plus enough to keep the producers busy.
+u32 ioSlotCount(void)
+{
+	return cfg.slipAllowed + 2 + 2 * cfg.ampCores;
+}
+
+// Data Buffer Slots: Hand free slots to producer cores to fill with the blocks that will be written from them.
+void ioSlotFillAhead(void)
+{
+	ampJob_type job;
+	u32 slot;
+
+	while (ioFillNext < ioFillEnd)
+	{
+		slot = ioFillNext % ioSlotsN;
+		if (ioSlot[slot].state != SLOT_FREE) { break; }
+
+		job.op = AMP_OP_FILL;
+		job.buffer = ioSlotBuffer(slot);
+		job.lba = ioFillNext * ioFillLBAPerBlock;
+		job.numLBA = ioFillLBAPerBlock;
+		job.lbaSize = nvmeGetLBASize();
+		job.pass = cfg.verifyPass;
+		job.seed = cfg.verifySeed;
+		job.tag = slot;
+		if (!ampSubmit(&job)) { break; }
+
+		ioSlot[slot].state = SLOT_FILLING;
+		ioFillNext++;
+	}
+}
+
+// AMP: Start producer cores as configured. Returns the number in use, 0 if none or if they couldn't be started.
+u32 ampStart(void)
+{
+	char strWorking[128];
+	int status;
+
+	status = ampInit(cfg.ampCores);
+	if (status != AMP_OK)
+	{
+		sprintf(strWorking, "Producer cores failed to start. Error Code: %d\r\n", status);
+		xil_printf(strWorking);
+		ampInit(0);
+	}
+
+	return ampGetCores();
+}
+
+// AMP: Jobs and busy time of each producer core over a test of tElapsed counts.
+void ampReport(XTime tElapsed)
+{
+	char strWorking[128];
+	u64 busy, jobs;
+
+	for (u32 core = 1; core <= ampGetCores(); core++)
+	{
+		ampGetBusy(core, &busy, &jobs);
+		sprintf(strWorking, "Core %d: %llu jobs, %.1f%% busy.\r\n", core, (unsigned long long)jobs,
+				100.0f * (float)busy / (float)tElapsed);
+		xil_printf(strWorking);
+	}
+}
+
+void verifyReport(void)
+{
+	char strWorking[160];
+	patternStats_type ampStats;
+
+	// Merge the results of checks done on producer cores.
+	if (ioSlotAMP)
+	{
+		ampGetCheckStats(&ampStats);
+		if ((ampStats.lbaBad > 0) && ((verifyStats.lbaBad == 0) || (ampStats.firstBadLBA < verifyStats.firstBadLBA)))
+		{
+			verifyStats.firstBadLBA = ampStats.firstBadLBA;
+			verifyStats.firstBadStampLBA = ampStats.firstBadStampLBA;
+		}
+		verifyStats.lbaChecked += ampStats.lbaChecked;
+		verifyStats.lbaBad += ampStats.lbaBad;
+		verifyStats.wordsBad += ampStats.wordsBad;
+		verifyStats.bitsBad += ampStats.bitsBad;
+		verifyStats.bits0to1 += ampStats.bits0to1;
+		verifyStats.bits1to0 += ampStats.bits1to0;
+	}
+
+	sprintf(strWorking, "Verify: %llu LBAs checked, %llu bad, %u I/O errors.\r\n",
+			(unsigned long long)verifyStats.lbaChecked, (unsigned long long)verifyStats.lbaBad, ioErrors);
+	xil_printf(strWorking);
+
+	if (verifyStats.lbaBad > 0)
+	{
+		sprintf(strWorking, "First bad LBA: %llu (stamped as LBA %llu).\r\n",
+				(unsigned long long)verifyStats.firstBadLBA, (unsigned long long)verifyStats.firstBadStampLBA);
+		xil_printf(strWorking);
+		sprintf(strWorking, "Bad words: %llu, bad bits: %llu (%llu 0->1, %llu 1->0).\r\n",
+				(unsigned long long)verifyStats.wordsBad, (unsigned long long)verifyStats.bitsBad,
+				(unsigned long long)verifyStats.bits0to1, (unsigned long long)verifyStats.bits1to0);
+		xil_printf(strWorking);
+	}
+}
+
+// Workload Engine: Checks that aren't covered by the parameter ranges.
+int workloadValid(void)
+{
+	u32 qdTotal = 0;
+	u32 nEnabled = 0;
+
+	for (u32 j = 0; j < WORKLOAD_JOBS_MAX; j++)
+	{
+		if (!jobs[j].enabled) { continue; }
+		nEnabled++;
+		qdTotal += jobs[j].qd;
+
+		if ((jobs[j].bsMin & (jobs[j].bsMin - 1)) || (jobs[j].bsMax & (jobs[j].bsMax - 1))
+		 || (jobs[j].bsMin > jobs[j].bsMax) || (jobs[j].bsMin < nvmeGetLBASize()))
+		{
+			xil_printf("bs_min and bs_max must be powers of 2, at least one LBA, with bs_min <= bs_max.\r\n");
+			return 0;
+		}
+		if (jobs[j].bsMax > nvmeGetMaxTransferSize())
+		{
+			xil_printf("bs_max is larger than the drive's maximum transfer size of %d B.\r\n", nvmeGetMaxTransferSize());
+			return 0;
+		}
+		if ((jobs[j].time_s == 0) && (jobs[j].sizeGB == 0))
+		{
+			xil_printf("Each enabled job needs a time or size limit.\r\n");
+			return 0;
+		}
+		if ((u64)jobs[j].offsetGB * 1000000000ULL / nvmeGetLBASize() + (jobs[j].bsMax / nvmeGetLBASize()) > nvmeGetLBACount())
+		{
+			xil_printf("Job offset is beyond the end of the drive.\r\n");
+			return 0;
+		}
+	}
+
+	if (nEnabled == 0) { xil_printf("No jobs enabled.\r\n"); return 0; }
+	if (qdTotal > WORKLOAD_QD_MAX) { xil_printf("Total queue depth of enabled jobs is too large.\r\n"); return 0; }
+
+	return 1;
+}
+
+// Workload Engine: Run all enabled jobs concurrently until each reaches its limit.
+void workloadRun(void)
+{
+	char strWorking[128];
+	nvmeCompletion_type completions[16];
+	u64 lbaDrive = nvmeGetLBACount();
+	u32 lbaSize = nvmeGetLBASize();
+	u32 nActive, nInFlight, nCompleted;
+	workloadTrack_type * track;
+	workloadStats_type * st;
+	u64 lat;
+	u32 bin;
+	float rate, iops;
+
+	XTime tStart, tNow;
+	u32 sElapsed = 0;
+
+	xil_printf("Workload engine started.\r\n");
+
+	// Set up each job's LBA span, aligned to its largest block size.
+	memset(jobStats, 0, sizeof(jobStats));
+	for (u32 j = 0; j < WORKLOAD_JOBS_MAX; j++)
+	{
+		st = &jobStats[j];
+		if (!jobs[j].enabled) { continue; }
+
+		st->lbaStart = (u64)jobs[j].offsetGB * 1000000000ULL / lbaSize;
+		st->lbaStart -= st->lbaStart % (jobs[j].bsMax / lbaSize);
+		st->lbaCount = (jobs[j].spanGB == 0) ? (lbaDrive - st->lbaStart) : ((u64)jobs[j].spanGB * 1000000000ULL / lbaSize);
+		if (st->lbaStart + st->lbaCount > lbaDrive) { st->lbaCount = lbaDrive - st->lbaStart; }
+		st->lbaNext = st->lbaStart;
+		st->latMin = 0xFFFFFFFFFFFFFFFFULL;
+		st->active = 1;
+	}
+
+	XTime_GetTime(&tStart);
+	testLogStart();
+
+	sprintf(strWorking, "Time [s]");
+	xil_printf(strWorking);
+	for (u32 j = 0; j < WORKLOAD_JOBS_MAX; j++)
+	{
+		if (!jobs[j].enabled) { continue; }
+		sprintf(strWorking, ", Job %d [MB/s], Job %d [IOPS]", j, j);
+		xil_printf(strWorking);
+	}
+	xil_printf("\r\n");
+
+	while (1)
+	{
+		XTime_GetTime(&tNow);
+
+		// Top up each active job to its queue depth.
+		nActive = 0;
+		nInFlight = 0;
+		for (u32 j = 0; j < WORKLOAD_JOBS_MAX; j++)
+		{
+			st = &jobStats[j];
+			if (!jobs[j].enabled) { continue; }
+
+			if (st->active)
+			{
+				if ((jobs[j].time_s && ((tNow - tStart) >= (u64)jobs[j].time_s * COUNTS_PER_SECOND))
+				 || (jobs[j].sizeGB && (st->bytesSubmitted >= (u64)jobs[j].sizeGB * 1000000000ULL)))
+				{
+					st->active = 0;
+				}
+			}
+
+			while (st->active && (st->inFlight < jobs[j].qd))
+			{
+				if (workloadSubmit(j, tNow)) { st->active = 0; }
+			}
+
+			nActive += st->active;
+			nInFlight += st->inFlight;
+		}
+
+		if ((nActive == 0) && (nInFlight == 0)) { break; }
+
+		// Retire completions and attribute them to their jobs.
+		nCompleted = nvmeServiceIOCompletionsCID(completions, 16);
+		if (nCompleted > 0) { XTime_GetTime(&tNow); }
+		for (u32 c = 0; c < nCompleted; c++)
+		{
+			track = &jobTrack[completions[c].cid & (WORKLOAD_TRACK_SIZE - 1)];
+			st = &jobStats[track->job];
+
+			st->inFlight--;
+			if (completions[c].status) { st->errors++; continue; }
+
+			st->bytesDone += track->bytes;
+			st->commandsDone++;
+
+			lat = tNow - track->tSubmit;
+			st->latSum += lat;
+			if (lat < st->latMin) { st->latMin = lat; }
+			if (lat > st->latMax) { st->latMax = lat; }
+			lat = lat * 1000000ULL / COUNTS_PER_SECOND;
+			for (bin = 0; (lat >> bin) && (bin < WORKLOAD_LAT_BINS - 1); bin++);
+			st->latHist[bin]++;
+		}
+
+		// 1Hz progress update.
+		if ((tNow - tStart) / COUNTS_PER_SECOND > sElapsed)
+		{
+			sElapsed = (tNow - tStart) / COUNTS_PER_SECOND;
+
+			sprintf(strWorking, "%8d", sElapsed);
+			xil_printf(strWorking);
+			for (u32 j = 0; j < WORKLOAD_JOBS_MAX; j++)
+			{
+				st = &jobStats[j];
+				if (!jobs[j].enabled) { continue; }
+
+				rate = (float)(st->bytesDone - st->bytesDonePrev) * 1e-6f;
+				iops = (float)(st->commandsDone - st->commandsDonePrev);
+				st->bytesDonePrev = st->bytesDone;
+				st->commandsDonePrev = st->commandsDone;
+
+				sprintf(strWorking, ",%15.3f,%15.0f", rate, iops);
+				xil_printf(strWorking);
+			}
+			xil_printf("\r\n");
+		}
+	}
+
+	testLogStop();
+	nvmeSelectIOQueue(NVME_IOSQ_BULK);
+
+	XTime_GetTime(&tNow);
+	workloadReport(tNow - tStart);
+
+	xil_printf("Workload engine finished.\r\n");
+}
+
+// Workload Engine: Submit one command for job j. Returns nonzero if the job can't continue.
+int workloadSubmit(u32 j, XTime tNow)
+{
+	workloadJob_type * job = &jobs[j];
+	workloadStats_type * st = &jobStats[j];
+	workloadTrack_type * track;
+	u32 lbaSize = nvmeGetLBASize();
+	u32 bs = job->bsMin;
+	u32 nSizes = 1;
+	u32 lbaPerBlock;
+	u64 lba;
+	u16 cid;
+	int status;
+
+	// Block size: equally likely among the powers of 2 from bsMin to bsMax.
+	while ((job->bsMin << nSizes) <= job->bsMax) { nSizes++; }
+	bs <<= workloadRand() % nSizes;
+	lbaPerBlock = bs / lbaSize;
+	if (st->lbaCount < lbaPerBlock) { return 1; }
+
+	if (job->random)
+	{
+		lba = st->lbaStart + (workloadRand() % (st->lbaCount / lbaPerBlock)) * lbaPerBlock;
+	}
+	else
+	{
+		if (st->lbaNext + lbaPerBlock > st->lbaStart + st->lbaCount) { st->lbaNext = st->lbaStart; }
+		lba = st->lbaNext;
+		st->lbaNext += lbaPerBlock;
+	}
+
+	nvmeSelectIOQueue(job->queue);
+	if ((workloadRand() % 100) < job->readPct)
+	{
+		status = nvmeReadCID(data, lba, lbaPerBlock, &cid);
+	}
+	else
+	{
+		status = nvmeWriteCID(data, lba, lbaPerBlock, &cid);
+	}
+	if (status != NVME_RW_OK) { st->errors++; return 1; }
+
+	track = &jobTrack[cid & (WORKLOAD_TRACK_SIZE - 1)];
+	track->job = j;
+	track->bytes = bs;
+	track->tSubmit = tNow;
+
+	st->inFlight++;
+	st->bytesSubmitted += bs;
+
+	return 0;
+}
+
+// Workload Engine: Per-job throughput and latency summary.
+void workloadReport(XTime tElapsed)
+{
+	char strWorking[160];
+	workloadStats_type * st;
+	float sElapsed = (float)tElapsed / (float)COUNTS_PER_SECOND;
+	float usPerCount = 1e6f / (float)COUNTS_PER_SECOND;
+	u64 nBelow;
+	u32 p99;
+
+	xil_printf("Job, Commands, Errors, IOPS, Rate [MB/s], Lat Min [us], Lat Avg [us], Lat p99 <= [us], Lat Max [us]\r\n");
+	for (u32 j = 0; j < WORKLOAD_JOBS_MAX; j++)
+	{
+		st = &jobStats[j];
+		if (!jobs[j].enabled) { continue; }
+		if (st->commandsDone == 0) { st->latMin = 0; }
+
+		// 99th percentile, to the upper edge of its log2 histogram bin.
+		nBelow = 0;
+		for (p99 = 0; p99 < WORKLOAD_LAT_BINS - 1; p99++)
+		{
+			nBelow += st->latHist[p99];
+			if (nBelow * 100 >= st->commandsDone * 99) { break; }
+		}
+
+		sprintf(strWorking, "%3d,%9llu,%7u,%10.0f,%12.3f,%13.1f,%13.1f,%16u,%13.1f\r\n", j,
+				(unsigned long long)st->commandsDone, st->errors,
+				(float)st->commandsDone / sElapsed, (float)st->bytesDone * 1e-6f / sElapsed,
+				(float)st->latMin * usPerCount,
+				(st->commandsDone ? (float)st->latSum / (float)st->commandsDone * usPerCount : 0.0f),
+				(1u << p99), (float)st->latMax * usPerCount);
+		xil_printf(strWorking);
+	}
+}
+
+// Workload Engine: xorshift64* pseudo-random numbers for offsets, sizes and the read/write mix.
+u64 workloadRand(void)
+{
+	workloadSeed ^= workloadSeed >> 12;
+	workloadSeed ^= workloadSeed << 25;
+	workloadSeed ^= workloadSeed >> 27;
+	return workloadSeed * 0x2545F4914F6CDD1DULL;
 }
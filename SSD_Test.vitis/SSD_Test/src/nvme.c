@@ -45,6 +45,37 @@ THE SOFTWARE.
 
 #define WORKLOAD_SEQUENTIAL 0x2     // Workload Hint for NVMe Controller
 
+#define KELVIN_OFFSET 273.15f
+
+// Registered buffers get a persistent PRP list of up to REG_PRP_LIST_PAGES pages each.
+#define REG_BUFFERS_MAX 4
+#define REG_PRP_LIST_PAGES 512      // 512 * 512 PRPs * 4KiB = 1GiB Maximum Registered Buffer Size
+#define REG_PRP_PER_LIST_PAGE (DDR_PAGE_SIZE >> 3)
+
+// Vectored I/O with PRPs uses the per-command PRP list page.
+#define IOV_PRP_MAX (DDR_PAGE_SIZE / sizeof(u64))
+
+// SGLs get SGL_PAGES_PER_CMD pages per command, one segment per page.
+#define SGL_PAGES_PER_CMD 4
+#define SGL_PER_PAGE (DDR_PAGE_SIZE / sizeof(sglDesc_type))
+#define SGL_MAX (SGL_PAGES_PER_CMD * (SGL_PER_PAGE - 1) + 1)
+
+// Use a single SGL descriptor instead of PRPs for contiguous, unregistered transfers of at least this size.
+#define SGL_THRESHOLD (1 << 15)
+
+// Largest transfer per read or write command: one PRP list page of 4KiB pages (2MiB), or the controller's MDTS if less.
+#define IO_TRANSFER_MAX ((DDR_PAGE_SIZE >> 3) << DDR_PAGE_EXP)
+
+// Per-command tracking for latency, indexed by the low bits of the CID. Covers more commands than both I/O SQs hold.
+#define IO_TRACK_SIZE 256
+
+// A53 cores that may submit I/O, each with its own I/O SQ selection.
+#define IO_CORES 4
+
+#if (NVME_IO_SLOTS != IOSQ_SIZE + 1) || (NVME_IO_QUEUE_DEPTH > IOCQ_SIZE)
+#error I/O queue depth or slot count do not match the queue sizes
+#endif
+
 // Private Type Definitions --------------------------------------------------------------------------------------------
 
 // Private Function Prototypes -----------------------------------------------------------------------------------------
@@ -56,6 +87,8 @@ int nvmeIdentifyController(u32 tTimeout_ms);
 int nvmeIdentifyNamespace(u32 tTimeout_ms);
 int nvmeSetPowerState(u8 PS, u8 WH, u32 tTimeout_ms);
 int nvmeCreateIOQueues(u32 tTimeout_ms);
+int nvmeSetArbitration(u32 tTimeout_ms);
+int nvmeSetInterruptCoalescing(u32 tTimeout_ms);
 int nvmeGetSMARTHealth(void);
 
 void nvmeParsePowerStates();
@@ -63,9 +96,20 @@ void nvmeParsePowerStates();
 int nvmeAdminCommand(const sqe_prp_type * sqe, cqe_type * cqe, u32 tTimeout_ms);
 void nvmeSubmitAdminCommand(const sqe_prp_type * sqe);
 int nvmeCompleteAdminCommand(cqe_type * cqe, u32 tTimeout_ms);
+void nvmeServiceAdminCompletions(void);
 
-void nvmeSubmitIOCommand(const sqe_prp_type * sqe);
-int nvmeCompleteIOCommands(cqe_type * cqe, u16 maxCompletions);
+int nvmeReserveIOCommand(sqe_prp_type * sqe);
+void nvmeReleaseIOCommand(u16 cid);
+u8 nvmeGetCore(void);
+int nvmeSubmitIOCommand(const sqe_prp_type * sqe);
+int nvmeCompleteIOCommands(cqe_type * cqe, nvmeCompletion_type * completions, u16 maxCompletions);
+
+int nvmeBuildDataPointer(sqe_prp_type * sqe, const u8 * buffer, u32 numLBA);
+void nvmeBuildPRP(sqe_prp_type * sqe, const u8 * buffer, u32 numLBA);
+int nvmeBuildRegisteredPRP(sqe_prp_type * sqe, const u8 * buffer, u32 numLBA);
+int nvmeBuildIOV(sqe_prp_type * sqe, const nvmeIOVec_type * iov, u16 iovCount);
+int nvmeBuildIOVPRP(sqe_prp_type * sqe, const nvmeIOVec_type * iov, u16 iovCount);
+int nvmeBuildSGL(sqe_prp_type * sqe, const nvmeIOVec_type * iov, u16 iovCount);
 
 int nvmeCheckTimeout(XTime tStart, u32 tTimeout_ms);
 
@@ -88,14 +132,16 @@ u64 * regASQ =     (u64 *)(0xB0000028);					// Admin Submission Queue Base Addre
 u64 * regACQ =     (u64 *)(0xB0000030);					// Admin Completion Queue Base Address
 u32 * regSQ0TDBL = (u32 *)(0xB0001000);					// Admin Submission Queue Tail Doorbell
 u32 * regCQ0HDBL = (u32 *)(0xB0001004);					// Admin Completion Queue Head Doorbell
-u32 * regSQ1TDBL = (u32 *)(0xB0001008);					// I/O Submission Queue Tail Doorbell
+u32 * regSQ1TDBL = (u32 *)(0xB0001008);					// I/O Submission Queue 1 Tail Doorbell
 u32 * regCQ1HDBL = (u32 *)(0xB000100C);					// I/O Completion Queue Head Doorbell
+u32 * regSQ2TDBL = (u32 *)(0xB0001010);					// I/O Submission Queue 2 Tail Doorbell
 
 // Submission and Completion Queues
 // Must be page-aligned at least large enough to fit the queue sizes defined above.
 sqe_prp_type * asq =  (sqe_prp_type *)(0x10000000);		// Admin Submission Queue
 cqe_type * acq =          (cqe_type *)(0x10001000);		// Admin Completion Queue
-sqe_prp_type * iosq = (sqe_prp_type *)(0x10002000);		// I/O Submission Queue
+sqe_prp_type * iosq = (sqe_prp_type *)(0x10002000);		// I/O Submission Queue 1 (Bulk)
+sqe_prp_type * iosq2 = (sqe_prp_type *)(0x10168000);	// I/O Submission Queue 2 (Priority)
 cqe_type * iocq =         (cqe_type *)(0x10003000);		// I/O Completion Queue
 
 // Identify Structures
@@ -110,12 +156,20 @@ dsmRange_type * dsmRange = (dsmRange_type *)(0x10007000);
 // Heap size is (IOSQ_SIZE + 1) * DDR_PAGE_SIZE.
 u64 * prpListHeap = (u64 *)(0x10008000);
 
+// Heap space for persistent PRP lists of registered buffers.
+// Heap size is REG_BUFFERS_MAX * REG_PRP_LIST_PAGES * DDR_PAGE_SIZE (8MiB).
+u64 * prpRegHeap = (u64 *)(0x10200000);
+regBuffer_type regBuffer[REG_BUFFERS_MAX];
+
+// Heap space for SGL segments for IO Transfers.
+// Heap size is (IOSQ_SIZE + 1) * SGL_PAGES_PER_CMD * DDR_PAGE_SIZE.
+sglDesc_type * sglHeap = (sglDesc_type *)(0x10068000);
+
 descPowerState_type descPowerState[32];
 
 u16 asq_tail_local = 0;
 u16 acq_head_local = 0;
 u8 acq_phase = 0;
-u16 iosq_tail_local = 0;
 u16 iocq_head_local = 0;
 u8 iocq_phase = 0;
 
@@ -123,10 +177,44 @@ int nvmeStatus = NVME_NOINIT;
 u32 nsid = 1;
 u8 lba_exp = 9;
 u8 ps_idle = 0;
+u8 sgl_support = ID_SGLS_SUPPORT_NONE;
 u32 lba_size = 512;
+u32 io_transfer_max = IO_TRANSFER_MAX;			// Largest transfer per read or write command in [B].
 u16 admin_cid = 0;
-u16 io_cid = 0;
-u16 io_cid_last_completed = 0xFFFF;
+u16 smart_cid = 0;
+u8 smart_pending = 0;
+u64 io_slot_free = ~0ULL;						// Command slots (IOSQ_SIZE + 1 of them), one bit each, set while free.
+u8 io_slot_next = 0;							// Where to start looking for a free slot.
+u16 io_slot_gen[IOSQ_SIZE + 1];					// Times each slot has been allocated, the upper bits of its CIDs.
+u16 io_credit = 0;								// Commands holding an I/O CQ credit, free-running.
+u16 io_submitted = 0;							// Commands published to an SQ doorbell, free-running.
+u16 io_completed = 0;							// Commands completed, free-running. Written by the CQ owner only.
+u16 iosq_reserved[NVME_IOSQ_COUNT] = {0};		// SQ slot tickets handed out, free-running.
+u16 iosq_published[NVME_IOSQ_COUNT] = {0};		// SQ slot tickets visible to the controller, free-running.
+u8 iocq_lock = 0;								// Held while reaping the I/O CQ.
+u8 io_sq_sel[IO_CORES] = {NVME_IOSQ_BULK};		// I/O SQ selected by each core.
+u8 ams_wrr = 0;
+
+XTime io_submit_time[IO_TRACK_SIZE];
+u32 io_submit_lba[IO_TRACK_SIZE];
+u16 io_done_cid[IO_TRACK_SIZE];					// CID of the last command completed in each track, or ~CID while pending.
+u16 io_done_status[IO_TRACK_SIZE];
+nvmeCompletionHook_type io_completion_hook[NVME_COMPLETION_HOOKS_MAX];
+u8 io_completion_hooks = 0;
+
+// WRR if supported, no coalescing, unless configured otherwise. Coalescing only affects interrupt-driven completion,
+// so it has no effect while the I/O CQ is polled.
+nvmeQueueConfig_type queueConfig =
+{
+	.wrr = 1,
+	.sqPriority = { NVME_QPRIO_MEDIUM, NVME_QPRIO_URGENT },
+	.weightHigh = 15,
+	.weightMedium = 7,
+	.weightLow = 0,
+	.arbitrationBurst = 7,
+	.aggrThreshold = 0,
+	.aggrTime = 0
+};
 
 // Interrupt Handlers --------------------------------------------------------------------------------------------------
 
@@ -156,6 +244,12 @@ int nvmeInit(void)
 	nvmeStatus |= nvmeCreateIOQueues(10);
 	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
 
+	nvmeStatus |= nvmeSetArbitration(10);
+	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
+
+	nvmeStatus |= nvmeSetInterruptCoalescing(10);
+	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
+
 	nvmeGetMetrics();
 
 	return nvmeStatus;
@@ -182,8 +276,25 @@ u16 nvmeGetLBASize(void)
 	{ return 0; }
 }
 
+// Largest transfer in [B] one read or write command can carry. Longer transfers must be split by the caller.
+u32 nvmeGetMaxTransferSize(void)
+{
+	if(nvmeStatus == NVME_OK)
+	{ return io_transfer_max; }
+	else
+	{ return 0; }
+}
+
+// Request a SMART / Health Information update without waiting for it. Safe to call periodically: completions
+// of earlier requests are retired here, and a new request is only issued once the previous one has completed.
 int nvmeGetMetrics(void)
 {
+	nvmeServiceAdminCompletions();
+	if(smart_pending) { return NVME_OK; }
+
+	smart_cid = admin_cid;
+	smart_pending = 1;
+
 	return nvmeGetSMARTHealth();
 }
 
@@ -209,55 +320,88 @@ float nvmeGetTemp(void)
 	return nvmeTf;
 }
 
+void nvmeGetThermal(nvmeThermal_type * thermal)
+{
+	thermal->tComposite = (float) logSMARTHealth->Composite_Temperature - KELVIN_OFFSET;
+	thermal->tWarning = (idController->WCTEMP > 0) ? ((float) idController->WCTEMP - KELVIN_OFFSET) : 0.0f;
+	thermal->tCritical = (idController->CCTEMP > 0) ? ((float) idController->CCTEMP - KELVIN_OFFSET) : 0.0f;
+	thermal->tWarningTime_min = logSMARTHealth->Warning_Composite_Temperature_Time;
+	thermal->tCriticalTime_min = logSMARTHealth->Critical_Composite_Temperature_Time;
+	thermal->tmt1Count = logSMARTHealth->Thermal_Management_Temperature_1_Transition_Count;
+	thermal->tmt2Count = logSMARTHealth->Thermal_Management_Temperature_2_Transition_Count;
+	thermal->tmt1Time_s = logSMARTHealth->Total_Time_For_Thermal_Management_Temperature_1;
+	thermal->tmt2Time_s = logSMARTHealth->Total_Time_For_Thermal_Management_Temperature_2;
+	thermal->hctmSupported = idController->HCTMA & 0x1;
+}
+
+// Set Host Controlled Thermal Management temperatures in [degC]. The controller starts light throttling at TMT1
+// and heavy throttling at TMT2. Values are clamped to the controller's MNTMT/MXTMT range. 0 disables a threshold.
+int nvmeSetThermalManagement(float tmt1, float tmt2)
+{
+	u32 nvmeStatus = NVME_OK;
+	sqe_prp_type sqe;
+	cqe_type cqe;
+	u16 tmtK[2];
+	float tmt[2] = { tmt1, tmt2 };
+
+	if((idController->HCTMA & 0x1) == 0) { return NVME_ERROR_SET_FEATURES; }
+
+	for(int i = 0; i < 2; i++)
+	{
+		if(tmt[i] <= 0.0f) { tmtK[i] = 0; continue; }
+
+		tmtK[i] = (u16)(tmt[i] + KELVIN_OFFSET);
+		if(tmtK[i] < idController->MNTMT) { tmtK[i] = idController->MNTMT; }
+		if(tmtK[i] > idController->MXTMT) { tmtK[i] = idController->MXTMT; }
+	}
+
+	// TMT1 must be below TMT2 if both are enabled.
+	if(tmtK[0] && tmtK[1] && (tmtK[0] >= tmtK[1])) { return NVME_ERROR_SET_FEATURES; }
+
+	// Set Features 10h: Host Controlled Thermal Management
+	memset(&sqe, 0, sizeof(sqe_prp_type));
+	sqe.CID = admin_cid;
+	sqe.OPC = 0x09;
+	sqe.CDW10 = 0x10;
+	sqe.CDW11 = (tmtK[0] << 16) | tmtK[1];
+	nvmeStatus = nvmeAdminCommand(&sqe, &cqe, 10);
+	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
+	if(cqe.SF_P >> 1) { return NVME_ERROR_SET_FEATURES; }
+
+	return NVME_OK;
+}
+
 int nvmeWrite(const u8 * srcByte, u64 destLBA, u32 numLBA)
+{
+	u16 cid;
+
+	return nvmeWriteCID(srcByte, destLBA, numLBA, &cid);
+}
+
+// Same as nvmeWrite(), but also returns the CID the command was given, for callers on cores other than the one
+// reaping completions. See nvmeIsIOComplete().
+int nvmeWriteCID(const u8 * srcByte, u64 destLBA, u32 numLBA, u16 * cid)
 {
 	sqe_prp_type sqe;
-	int nLBA = numLBA;
-	int nPRP;
-	int offset;
-	u64 * prpList = prpListHeap + ((io_cid & IOSQ_SIZE) * (DDR_PAGE_SIZE >> 3));
+	int nvmeRWStatus;
 
-	if ((u64) srcByte & 0x3) { return 1; } 	// Must be DWORD-aligned!
+	if((numLBA == 0) || (((u64) numLBA << lba_exp) > io_transfer_max)) { return NVME_RW_BAD_LENGTH; }
 
 	memset(&sqe, 0, sizeof(sqe_prp_type));
-	sqe.CID = io_cid;
 	sqe.OPC = 0x01;
 	sqe.NSID = nsid;
-	sqe.PRP1 = (u64) srcByte;
 	sqe.CDW10 = destLBA & 0xFFFFFFFF;
 	sqe.CDW11 = (destLBA >> 32) & 0XFFFFFFFF;
 	sqe.CDW12 = numLBA - 1; // 0's Based
 
-	// Subtract off the integer number of LBAs covered by the first PRP.
-	offset = (u64) srcByte & DDR_PAGE_MASK;
-	nLBA -= (DDR_PAGE_SIZE - offset) >> lba_exp;
-
-	// If there is more data to transfer...
-	if(nLBA > 0)
-	{
-		// Move the source pointer to its page boundary.
-		srcByte -= (u64) offset;
+	// DWORD-aligned unless the controller supports byte-granular SGLs.
+	nvmeRWStatus = nvmeReserveIOCommand(&sqe);
+	if(nvmeRWStatus != NVME_RW_OK) { return nvmeRWStatus; }
+	nvmeRWStatus = nvmeBuildDataPointer(&sqe, srcByte, numLBA);
+	if(nvmeRWStatus != NVME_RW_OK) { nvmeReleaseIOCommand(sqe.CID); return nvmeRWStatus; }
 
-		nPRP = ((nLBA - 1) >> (DDR_PAGE_EXP - lba_exp)) + 1;
-		if(nPRP > 1)
-		{
-			// 2 or more PRPs remaining, use a list.
-			sqe.PRP2 = (u64) prpList;
-			for(int p = 1; p <= nPRP; p++)
-			{
-				prpList[p-1] = (u64)(srcByte + (p << DDR_PAGE_EXP));
-			}
-		}
-		else
-		{
-			// 1 PRP remaining, fits in the command itself.
-			sqe.PRP2 = (u64) (srcByte + (1 << DDR_PAGE_EXP));
-		}
-	}
-
-	nvmeSubmitIOCommand(&sqe);
-
-	return 0;
+	*cid = sqe.CID;
+	return nvmeSubmitIOCommand(&sqe);
 }
 
 int nvmeFlush()
@@ -267,64 +411,84 @@ int nvmeFlush()
 	XTime_GetTime(&tStart);
 
 	memset(&sqe, 0, sizeof(sqe_prp_type));
-	sqe.CID = io_cid;
 	sqe.OPC = 0x00;
 	sqe.NSID = nsid;
 
-	nvmeSubmitIOCommand(&sqe);
+	if(nvmeReserveIOCommand(&sqe) != NVME_RW_OK) { return NVME_RW_QUEUE_FULL; }
 
-	return 0;
+	return nvmeSubmitIOCommand(&sqe);
 }
 
 int nvmeRead(u8 * destByte, u64 srcLBA, u32 numLBA)
+{
+	u16 cid;
+
+	return nvmeReadCID(destByte, srcLBA, numLBA, &cid);
+}
+
+// Same as nvmeRead(), but also returns the CID the command was given. See nvmeWriteCID().
+int nvmeReadCID(u8 * destByte, u64 srcLBA, u32 numLBA, u16 * cid)
 {
 	sqe_prp_type sqe;
-	int nLBA = numLBA;
-	int nPRP;
-	int offset;
-	u64 * prpList = prpListHeap + ((io_cid & IOSQ_SIZE) * (DDR_PAGE_SIZE >> 3));
+	int nvmeRWStatus;
 
-	if ((u64) destByte & 0x3) { return 1; } 	// Must be DWORD-aligned!
+	if((numLBA == 0) || (((u64) numLBA << lba_exp) > io_transfer_max)) { return NVME_RW_BAD_LENGTH; }
 
 	memset(&sqe, 0, sizeof(sqe_prp_type));
-	sqe.CID = io_cid;
 	sqe.OPC = 0x02;
 	sqe.NSID = nsid;
-	sqe.PRP1 = (u64) destByte;
 	sqe.CDW10 = srcLBA & 0xFFFFFFFF;
 	sqe.CDW11 = (srcLBA >> 32) & 0XFFFFFFFF;
 	sqe.CDW12 = numLBA - 1; // 0's Based
 
-	// Subtract off the integer number of LBAs covered by the first PRP.
-	offset = (u64) destByte & DDR_PAGE_MASK;
-	nLBA -= (DDR_PAGE_SIZE - offset) >> lba_exp;
+	// DWORD-aligned unless the controller supports byte-granular SGLs.
+	nvmeRWStatus = nvmeReserveIOCommand(&sqe);
+	if(nvmeRWStatus != NVME_RW_OK) { return nvmeRWStatus; }
+	nvmeRWStatus = nvmeBuildDataPointer(&sqe, destByte, numLBA);
+	if(nvmeRWStatus != NVME_RW_OK) { nvmeReleaseIOCommand(sqe.CID); return nvmeRWStatus; }
 
-	// If there is more data to transfer...
-	if(nLBA > 0)
-	{
-		// Move the destination pointer to its page boundary.
-		destByte -= (u64) offset;
+	*cid = sqe.CID;
+	return nvmeSubmitIOCommand(&sqe);
+}
 
-		nPRP = ((nLBA - 1) >> (DDR_PAGE_EXP - lba_exp)) + 1;
-		if(nPRP > 1)
-		{
-			// 2 or more PRPs remaining, use a list.
-			sqe.PRP2 = (u64) prpList;
-			for(int p = 1; p <= nPRP; p++)
-			{
-				prpList[p-1] = (u64)(destByte + (p << DDR_PAGE_EXP));
-			}
-		}
-		else
-		{
-			// 1 PRP remaining, fits in the command itself.
-			sqe.PRP2 = (u64) (destByte + (1 << DDR_PAGE_EXP));
-		}
-	}
+// Vectored Write: Gather the segments into one command. The total length must be a whole number of LBAs.
+int nvmeWritev(const nvmeIOVec_type * iov, u16 iovCount, u64 destLBA)
+{
+	sqe_prp_type sqe;
+	int numLBA;
+
+	memset(&sqe, 0, sizeof(sqe_prp_type));
+	if(nvmeReserveIOCommand(&sqe) != NVME_RW_OK) { return NVME_RW_QUEUE_FULL; }
+	numLBA = nvmeBuildIOV(&sqe, iov, iovCount);
+	if(numLBA < 0) { nvmeReleaseIOCommand(sqe.CID); return -numLBA; }
 
-	nvmeSubmitIOCommand(&sqe);
+	sqe.OPC = 0x01;
+	sqe.NSID = nsid;
+	sqe.CDW10 = destLBA & 0xFFFFFFFF;
+	sqe.CDW11 = (destLBA >> 32) & 0XFFFFFFFF;
+	sqe.CDW12 = numLBA - 1; // 0's Based
 
-	return 0;
+	return nvmeSubmitIOCommand(&sqe);
+}
+
+// Vectored Read: Scatter one command into the segments. The total length must be a whole number of LBAs.
+int nvmeReadv(const nvmeIOVec_type * iov, u16 iovCount, u64 srcLBA)
+{
+	sqe_prp_type sqe;
+	int numLBA;
+
+	memset(&sqe, 0, sizeof(sqe_prp_type));
+	if(nvmeReserveIOCommand(&sqe) != NVME_RW_OK) { return NVME_RW_QUEUE_FULL; }
+	numLBA = nvmeBuildIOV(&sqe, iov, iovCount);
+	if(numLBA < 0) { nvmeReleaseIOCommand(sqe.CID); return -numLBA; }
+
+	sqe.OPC = 0x02;
+	sqe.NSID = nsid;
+	sqe.CDW10 = srcLBA & 0xFFFFFFFF;
+	sqe.CDW11 = (srcLBA >> 32) & 0XFFFFFFFF;
+	sqe.CDW12 = numLBA - 1; // 0's Based
+
+	return nvmeSubmitIOCommand(&sqe);
 }
 
 int nvmeServiceIOCompletions(u16 maxCompletions)
@@ -332,14 +496,91 @@ int nvmeServiceIOCompletions(u16 maxCompletions)
 	u16 numCompletions;
 	cqe_type cqeLastCompleted;
 
-	numCompletions = nvmeCompleteIOCommands(&cqeLastCompleted, maxCompletions);
+	numCompletions = nvmeCompleteIOCommands(&cqeLastCompleted, NULL, maxCompletions);
 
 	return numCompletions;
 }
 
+// Same as nvmeServiceIOCompletions(), but also reports the CID and status of each completed command.
+int nvmeServiceIOCompletionsCID(nvmeCompletion_type * completions, u16 maxCompletions)
+{
+	cqe_type cqeLastCompleted;
+
+	return nvmeCompleteIOCommands(&cqeLastCompleted, completions, maxCompletions);
+}
+
 u16 nvmeGetIOSlip(void)
 {
-	return (u16)(io_cid - io_cid_last_completed - 1);
+	return (u16)(__atomic_load_n(&io_submitted, __ATOMIC_RELAXED) - __atomic_load_n(&io_completed, __ATOMIC_RELAXED));
+}
+
+// Whether the command with this CID has completed, and its status if so. Any core may poll, while one of them (or an
+// ISR) reaps completions. A result is kept until its command slot has been taken IO_TRACK_SIZE / (IOSQ_SIZE + 1) more
+// times, which is usually about IO_TRACK_SIZE more commands since slots are taken in rotation.
+u8 nvmeIsIOComplete(u16 cid, u16 * status)
+{
+	u16 track = cid & (IO_TRACK_SIZE - 1);
+
+	if(__atomic_load_n(&io_done_cid[track], __ATOMIC_ACQUIRE) != cid) { return 0; }
+
+	*status = io_done_status[track];
+	return 1;
+}
+
+// Whether the command with this CID is still in flight. Unlike nvmeIsIOComplete(), this stays exact once the result
+// has been overwritten by later commands, so it suits waiting for a command without needing its status.
+u8 nvmeIsIOPending(u16 cid)
+{
+	return __atomic_load_n(&io_done_cid[cid & (IO_TRACK_SIZE - 1)], __ATOMIC_ACQUIRE) == (u16)~cid;
+}
+
+// Add a function called for every completed I/O command, with its status, size and latency. Returns 1 if
+// NVME_COMPLETION_HOOKS_MAX are already added. Adding one again has no effect.
+int nvmeAddCompletionHook(nvmeCompletionHook_type hook)
+{
+	for(u8 h = 0; h < io_completion_hooks; h++)
+	{
+		if(io_completion_hook[h] == hook) { return 0; }
+	}
+	if(io_completion_hooks == NVME_COMPLETION_HOOKS_MAX) { return 1; }
+
+	io_completion_hook[io_completion_hooks] = hook;
+	__atomic_store_n(&io_completion_hooks, io_completion_hooks + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+void nvmeRemoveCompletionHook(nvmeCompletionHook_type hook)
+{
+	u8 n = 0;
+
+	for(u8 h = 0; h < io_completion_hooks; h++)
+	{
+		if(io_completion_hook[h] != hook) { io_completion_hook[n++] = io_completion_hook[h]; }
+	}
+	__atomic_store_n(&io_completion_hooks, n, __ATOMIC_RELEASE);
+}
+
+void nvmeSetQueueConfig(const nvmeQueueConfig_type * config)
+{
+	queueConfig = *config;
+}
+
+// Select the I/O Submission Queue for subsequent commands from the calling core. Completions from all queues share the
+// same slip count.
+int nvmeSelectIOQueue(u8 sq)
+{
+	if(sq >= NVME_IOSQ_COUNT) { return 1; }
+
+	io_sq_sel[nvmeGetCore()] = sq;
+
+	return 0;
+}
+
+// I/O Submission Queue selected by the calling core, e.g. to restore it after switching queues for a few commands.
+u8 nvmeGetIOQueue(void)
+{
+	return io_sq_sel[nvmeGetCore()];
 }
 
 int nvmeTrim(u64 startLBA, u32 numLBA)
@@ -353,16 +594,72 @@ int nvmeTrim(u64 startLBA, u32 numLBA)
 	dsmRange[0].length = numLBA;
 
 	memset(&sqe, 0, sizeof(sqe_prp_type));
-	sqe.CID = io_cid;
 	sqe.OPC = 0x09;
 	sqe.NSID = nsid;
 	sqe.PRP1 = (u64) dsmRange;
 	sqe.CDW10 = 0;   // 0's Based
 	sqe.CDW11 = 0x4; // Deallocate (AD) flag.
 
-	nvmeSubmitIOCommand(&sqe);
+	if(nvmeReserveIOCommand(&sqe) != NVME_RW_OK) { return NVME_RW_QUEUE_FULL; }
 
-	return 0;
+	return nvmeSubmitIOCommand(&sqe);
+}
+
+// Precompute the PRP list for a buffer that will be used repeatedly for I/O. Transfers that lie entirely within a
+// registered buffer point PRP2 directly into its persistent list instead of building a new one per command.
+int nvmeRegisterBuffer(const u8 * buffer, u32 size)
+{
+	u64 pageStart = (u64) buffer & ~((u64) DDR_PAGE_MASK);
+	u32 nPages = (((u64) buffer + size - pageStart) + DDR_PAGE_MASK) >> DDR_PAGE_EXP;
+	int slot;
+
+	if ((u64) buffer & 0x3) { return NVME_REG_BAD_ALIGNMENT; } 	// Must be DWORD-aligned!
+	if ((size == 0) || (nPages > REG_PRP_LIST_PAGES * REG_PRP_PER_LIST_PAGE)) { return NVME_REG_TOO_LARGE; }
+
+	// Re-registering a buffer replaces its slot, otherwise take the first free one.
+	for(slot = 0; slot < REG_BUFFERS_MAX; slot++)
+	{
+		if(regBuffer[slot].addrStart == (u64) buffer) { break; }
+	}
+	if(slot == REG_BUFFERS_MAX)
+	{
+		for(slot = 0; slot < REG_BUFFERS_MAX; slot++)
+		{
+			if(regBuffer[slot].nPages == 0) { break; }
+		}
+	}
+	if(slot == REG_BUFFERS_MAX) { return NVME_REG_NO_SLOT; }
+
+	regBuffer[slot].prpList = prpRegHeap + (slot * REG_PRP_LIST_PAGES * REG_PRP_PER_LIST_PAGE);
+	for(u32 p = 0; p < nPages; p++)
+	{
+		regBuffer[slot].prpList[p] = pageStart + ((u64) p << DDR_PAGE_EXP);
+	}
+	regBuffer[slot].addrStart = (u64) buffer;
+	regBuffer[slot].addrEnd = (u64) buffer + size;
+	regBuffer[slot].nPages = nPages;
+
+	return NVME_REG_OK;
+}
+
+int nvmeUnregisterBuffer(const u8 * buffer)
+{
+	for(int slot = 0; slot < REG_BUFFERS_MAX; slot++)
+	{
+		if((regBuffer[slot].nPages > 0) && (regBuffer[slot].addrStart == (u64) buffer))
+		{
+			// Commands still in flight may reference the list, so don't free it out from under them.
+			while(nvmeGetIOSlip() > 0)
+			{
+				nvmeServiceIOCompletions(16);
+			}
+
+			memset(&regBuffer[slot], 0, sizeof(regBuffer_type));
+			return NVME_REG_OK;
+		}
+	}
+
+	return NVME_REG_NOT_FOUND;
 }
 
 // Private Function Definitions ----------------------------------------------------------------------------------------
@@ -402,9 +699,11 @@ int nvmeInitController(u32 tTimeout_ms)
 	*regCC &= ~REG_CC_IOSQES_Msk;
 	*regCC |= (0x6) << REG_CC_IOSQES_Pos;
 
-	// Arbitration Mechanism: Round Robin
+	// Arbitration Mechanism: Weighted Round Robin with Urgent Priority Class if configured and supported, else Round Robin
+	capability = (*regCAP & REG_CAP_AMS_Msk) >> REG_CAP_AMS_Pos;
+	ams_wrr = (queueConfig.wrr && (capability & 0x1)) ? 1 : 0;
 	*regCC &= ~REG_CC_AMS_Msk;
-	*regCC |= (0x0) << REG_CC_AMS_Pos;
+	*regCC |= (ams_wrr ? 0x1 : 0x0) << REG_CC_AMS_Pos;
 
 	// Memory Page Size: 4KiB (Minimum)
 	capability = (*regCAP & REG_CAP_MPSMIN_Msk) >> REG_CAP_MPSMIN_Pos;
@@ -420,17 +719,20 @@ int nvmeInitController(u32 tTimeout_ms)
 
 	// Doorbell Stride: Realign Pointers if Necessary
 	capability = (*regCAP & REG_CAP_DSTRD_Msk) >> REG_CAP_DSTRD_Pos;
+	// The stride is (4 << DSTRD) bytes, i.e. (1 << DSTRD) u32s.
 	if(capability > 0)
 	{
-		regCQ0HDBL = regSQ0TDBL + 1 * (1 << (2 + capability));
-		regSQ1TDBL = regSQ0TDBL + 2 * (1 << (2 + capability));
-		regCQ1HDBL = regSQ0TDBL + 3 * (1 << (2 + capability));
+		regCQ0HDBL = regSQ0TDBL + 1 * (1 << capability);
+		regSQ1TDBL = regSQ0TDBL + 2 * (1 << capability);
+		regCQ1HDBL = regSQ0TDBL + 3 * (1 << capability);
+		regSQ2TDBL = regSQ0TDBL + 4 * (1 << capability);
 	}
 
 	// Initialize all queue memory to zeros.
 	memset(asq, 0, (ASQ_SIZE + 1) * sizeof(sqe_prp_type));
 	memset(acq, 0, (ACQ_SIZE + 1) * sizeof(cqe_type));
 	memset(iosq, 0, (IOSQ_SIZE + 1) * sizeof(sqe_prp_type));
+	memset(iosq2, 0, (IOSQ_SIZE + 1) * sizeof(sqe_prp_type));
 	memset(iocq, 0, (IOCQ_SIZE + 1) * sizeof(cqe_type));
 
 	// Enable Controller
@@ -465,6 +767,16 @@ int nvmeIdentifyController(u32 tTimeout_ms)
 	if (idController->SQES != 0x66) { return NVME_ERROR_QUEUE_TYPE; }
 	if (idController->CQES != 0x44) { return NVME_ERROR_QUEUE_TYPE; }
 
+	sgl_support = idController->SGLS & ID_SGLS_SUPPORT_Msk;
+
+	// Maximum Data Transfer Size, in minimum memory pages (4KiB, see nvmeInitController()). 0: No limit.
+	io_transfer_max = IO_TRANSFER_MAX;
+	if((idController->MDTS > 0) && (idController->MDTS < 32 - DDR_PAGE_EXP)
+	 && ((DDR_PAGE_SIZE << idController->MDTS) < IO_TRANSFER_MAX))
+	{
+		io_transfer_max = DDR_PAGE_SIZE << idController->MDTS;
+	}
+
 	nvmeParsePowerStates();
 
 	return NVME_OK;
@@ -547,16 +859,62 @@ int nvmeCreateIOQueues(u32 tTimeout_ms)
 	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
 	if(cqe.SF_P >> 1) { return NVME_ERROR_QUEUE_CREATION; }
 
-	// Create I/O Submission Queue
+	// Create I/O Submission Queues, both completing to I/O Completion Queue 1.
+	// Queue Priority is ignored by the controller unless Weighted Round Robin is selected.
+	for(u16 sq = 0; sq < NVME_IOSQ_COUNT; sq++)
+	{
+		memset(&sqe, 0, sizeof(sqe_prp_type));
+		sqe.CID = admin_cid;
+		sqe.OPC = 0x01;
+		sqe.PRP1 = (sq == NVME_IOSQ_BULK) ? (u64) iosq : (u64) iosq2;
+		sqe.CDW10 = (IOSQ_SIZE << 16) | (sq + 1);
+		sqe.CDW11 = 0x00010001 | ((queueConfig.sqPriority[sq] & 0x3) << 1);
+		nvmeStatus = nvmeAdminCommand(&sqe, &cqe, tTimeout_ms);
+		if(nvmeStatus != NVME_OK) { return nvmeStatus; }
+		if(cqe.SF_P >> 1) { return NVME_ERROR_QUEUE_CREATION; }
+	}
+
+	return NVME_OK;
+}
+
+int nvmeSetArbitration(u32 tTimeout_ms)
+{
+	u32 nvmeStatus = NVME_OK;
+	sqe_prp_type sqe;
+	cqe_type cqe;
+
+	// Set Features 01h: Arbitration
 	memset(&sqe, 0, sizeof(sqe_prp_type));
 	sqe.CID = admin_cid;
-	sqe.OPC = 0x01;
-	sqe.PRP1 = (u64) iosq;
-	sqe.CDW10 = (IOSQ_SIZE << 16) | 0x0001;
-	sqe.CDW11 = 0x00010001;
+	sqe.OPC = 0x09;
+	sqe.CDW10 = 0x01;
+	sqe.CDW11 = (queueConfig.arbitrationBurst & 0x7);
+	if(ams_wrr)
+	{
+		sqe.CDW11 |= (queueConfig.weightLow << 8) | (queueConfig.weightMedium << 16) | (queueConfig.weightHigh << 24);
+	}
 	nvmeStatus = nvmeAdminCommand(&sqe, &cqe, tTimeout_ms);
 	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
-	if(cqe.SF_P >> 1) { return NVME_ERROR_QUEUE_CREATION; }
+	if(cqe.SF_P >> 1) { return NVME_ERROR_SET_FEATURES; }
+
+	return NVME_OK;
+}
+
+int nvmeSetInterruptCoalescing(u32 tTimeout_ms)
+{
+	u32 nvmeStatus = NVME_OK;
+	sqe_prp_type sqe;
+	cqe_type cqe;
+
+	// Set Features 08h: Interrupt Coalescing
+	memset(&sqe, 0, sizeof(sqe_prp_type));
+	sqe.CID = admin_cid;
+	sqe.OPC = 0x09;
+	sqe.CDW10 = 0x08;
+	sqe.CDW11 = (queueConfig.aggrTime << 8) | queueConfig.aggrThreshold;
+	nvmeStatus = nvmeAdminCommand(&sqe, &cqe, tTimeout_ms);
+	if(nvmeStatus != NVME_OK) { return nvmeStatus; }
+	if(cqe.SF_P >> 1) { return NVME_ERROR_SET_FEATURES; }
 
 	return NVME_OK;
 }
@@ -697,26 +1055,128 @@ int nvmeCompleteAdminCommand(cqe_type * cqe, u32 tTimeout_ms)
 
 	*cqe = *cqeTemp;
 
+	if(cqe->CID == smart_cid) { smart_pending = 0; }
+
 	return NVME_OK;
 }
 
-void nvmeSubmitIOCommand(const sqe_prp_type * sqe)
+// Non-Blocking Admin Command Completion, for commands submitted without waiting.
+void nvmeServiceAdminCompletions(void)
+{
+	cqe_type cqe;
+	cqe_type * cqeTemp;
+
+	while(1)
+	{
+		isb(); dsb(); // Xil_DCacheInvalidate();
+		cqeTemp = (cqe_type *)((u64)acq + acq_head_local * sizeof(cqe_type));
+		if((cqeTemp->SF_P & 0x0001) == acq_phase) { break; }
+
+		nvmeCompleteAdminCommand(&cqe, 1);
+	}
+}
+
+// Take an I/O CQ credit, so the commands outstanding on both SQs can never overflow the CQ (or the SQ, which is the
+// same size), then a command slot, and give the command its CID. The low bits of the CID are the slot, so the PRP list
+// and SGL pages indexed by CID & IOSQ_SIZE belong to this command until it completes. Returns NVME_RW_QUEUE_FULL,
+// with nothing taken, if all credits are in use.
+int nvmeReserveIOCommand(sqe_prp_type * sqe)
+{
+	u16 credit = __atomic_load_n(&io_credit, __ATOMIC_RELAXED);
+	u64 slotFree;
+	u64 slotRotated;
+	u8 slotStart;
+	u8 slot;
+
+	do
+	{
+		if((u16)(credit - __atomic_load_n(&io_completed, __ATOMIC_ACQUIRE)) >= NVME_IO_QUEUE_DEPTH) { return NVME_RW_QUEUE_FULL; }
+	}
+	while(!__atomic_compare_exchange_n(&io_credit, &credit, (u16)(credit + 1), 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	// A slot is taken after its credit and freed before it, so with at most NVME_IO_QUEUE_DEPTH credits out there is a
+	// free one left. Searching onwards from the last slot taken cycles through all of them, rather than reusing the lowest
+	// over and over, which keeps each result in nvmeIsIOComplete() for as long as possible.
+	slotFree = __atomic_load_n(&io_slot_free, __ATOMIC_RELAXED);
+	do
+	{
+		slotStart = __atomic_load_n(&io_slot_next, __ATOMIC_RELAXED);
+		slotRotated = (slotFree >> slotStart) | (slotFree << ((64 - slotStart) & 63));
+		slot = (slotStart + __builtin_ctzll(slotRotated)) & IOSQ_SIZE;
+	}
+	while(!__atomic_compare_exchange_n(&io_slot_free, &slotFree, slotFree & ~(1ULL << slot), 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+	__atomic_store_n(&io_slot_next, (slot + 1) & IOSQ_SIZE, __ATOMIC_RELAXED);
+
+	// Only the slot's owner touches its generation.
+	io_slot_gen[slot]++;
+	sqe->CID = (u16)(io_slot_gen[slot] * (IOSQ_SIZE + 1) + slot);
+
+	return NVME_RW_OK;
+}
+
+// Return the slot and credit of a command that won't be submitted after all, e.g. because its data pointer couldn't
+// be built.
+void nvmeReleaseIOCommand(u16 cid)
+{
+	__atomic_fetch_or(&io_slot_free, 1ULL << (cid & IOSQ_SIZE), __ATOMIC_RELEASE);
+	__atomic_fetch_sub(&io_credit, 1, __ATOMIC_RELEASE);
+}
+
+// Index of the calling core, from MPIDR_EL1.Aff0.
+u8 nvmeGetCore(void)
+{
+	u64 mpidr;
+
+	__asm__ volatile("mrs %0, mpidr_el1" : "=r" (mpidr));
+
+	return (u8)(mpidr & (IO_CORES - 1));
+}
+
+// Multi-Producer I/O Submission: Any core may submit a command reserved with nvmeReserveIOCommand(), which can no
+// longer fail. The command takes a slot ticket on its SQ. The SQE is copied into its slot in parallel with other
+// submitters, but the doorbell is rung in ticket order: each submitter waits for the ones with earlier tickets to
+// publish theirs, so the tail only ever moves forward over complete entries. Don't submit from an ISR, which could wait
+// forever on a ticket held by the code it interrupted.
+int nvmeSubmitIOCommand(const sqe_prp_type * sqe)
 {
-	u64 iosq_offset = iosq_tail_local * sizeof(sqe_prp_type);
-	memcpy((void *)((u64)iosq + iosq_offset), sqe, sizeof(sqe_prp_type));
-	iosq_tail_local = (iosq_tail_local + 1) & IOSQ_SIZE;
-	io_cid++;
+	u8 sq = io_sq_sel[nvmeGetCore()];
+	sqe_prp_type * iosqSel = (sq == NVME_IOSQ_BULK) ? iosq : iosq2;
+	u32 * regSQTDBL = (sq == NVME_IOSQ_BULK) ? regSQ1TDBL : regSQ2TDBL;
+	u16 track = sqe->CID & (IO_TRACK_SIZE - 1);
+	u16 ticket;
 
+	ticket = __atomic_fetch_add(&iosq_reserved[sq], 1, __ATOMIC_RELAXED);
+
+	// Read (0x02) and Write (0x01) carry a 0's based LBA count in CDW12.
+	io_submit_lba[track] = ((sqe->OPC == 0x01) || (sqe->OPC == 0x02)) ? (sqe->CDW12 & 0xFFFF) + 1 : 0;
+	XTime_GetTime(&io_submit_time[track]);
+	__atomic_store_n(&io_done_cid[track], (u16)~sqe->CID, __ATOMIC_RELAXED);
+
+	memcpy((void *)((u64)iosqSel + (ticket & IOSQ_SIZE) * sizeof(sqe_prp_type)), sqe, sizeof(sqe_prp_type));
+
+	while(__atomic_load_n(&iosq_published[sq], __ATOMIC_ACQUIRE) != ticket) { }
+
+	__atomic_fetch_add(&io_submitted, 1, __ATOMIC_RELAXED);
 	isb(); dsb(); // Xil_DCacheFlush();
-	*regSQ1TDBL = iosq_tail_local;
+	*regSQTDBL = (u16)(ticket + 1) & IOSQ_SIZE;
+	__atomic_store_n(&iosq_published[sq], (u16)(ticket + 1), __ATOMIC_RELEASE);
+
+	return NVME_RW_OK;
 }
 
 // Non-Blocking IO Command Completion
-int nvmeCompleteIOCommands(cqe_type * cqe, u16 nCompletionsMax)
+// One core (or ISR) reaps at a time. Any other caller, including an ISR that interrupted the one reaping, returns with
+// no completions instead of waiting. Completion hooks are therefore never called concurrently.
+int nvmeCompleteIOCommands(cqe_type * cqe, nvmeCompletion_type * completions, u16 nCompletionsMax)
 {
 	u32 nCompletions = 0;
 	cqe_type * cqeTemp;
 	u64 iocq_offset;
+	nvmeCompletion_type completion;
+	u16 track;
+	XTime tNow = 0;
+
+	if(__atomic_test_and_set(&iocq_lock, __ATOMIC_ACQUIRE)) { return 0; }
 
 	for(nCompletions = 0; nCompletions < nCompletionsMax; nCompletions++)
 	{
@@ -727,7 +1187,24 @@ int nvmeCompleteIOCommands(cqe_type * cqe, u16 nCompletionsMax)
 
 		if((cqeTemp->SF_P & 0x0001) == iocq_phase) { break; }
 
-		io_cid_last_completed = cqeTemp->CID;
+		track = cqeTemp->CID & (IO_TRACK_SIZE - 1);
+		io_done_status[track] = cqeTemp->SF_P >> 1;
+		__atomic_store_n(&io_done_cid[track], cqeTemp->CID, __ATOMIC_RELEASE);
+
+		if((completions != NULL) || (io_completion_hooks > 0))
+		{
+			if(tNow == 0) { XTime_GetTime(&tNow); }
+			completion.cid = cqeTemp->CID;
+			completion.status = cqeTemp->SF_P >> 1;
+			completion.numLBA = io_submit_lba[track];
+			completion.latency = (u32)(tNow - io_submit_time[track]);
+
+			if(completions != NULL) { completions[nCompletions] = completion; }
+			for(u8 h = 0; h < io_completion_hooks; h++) { io_completion_hook[h](&completion); }
+		}
+
+		// The command's PRP list or SGL pages may be reused from here on.
+		__atomic_fetch_or(&io_slot_free, 1ULL << (cqeTemp->CID & IOSQ_SIZE), __ATOMIC_RELEASE);
 
 		iocq_head_local = (iocq_head_local + 1) & IOCQ_SIZE;
 		if(iocq_head_local == 0) { iocq_phase ^= 0x01; }
@@ -737,13 +1214,249 @@ int nvmeCompleteIOCommands(cqe_type * cqe, u16 nCompletionsMax)
 	{
 		isb(); dsb(); // Xil_DCacheFlush();
 		*regCQ1HDBL = iocq_head_local;
+
+		// Return the credits only after the head doorbell, so the CQ entries are free before they're reused.
+		__atomic_store_n(&io_completed, (u16)(io_completed + nCompletions), __ATOMIC_RELEASE);
 	}
 
 	*cqe = *cqeTemp;
+	__atomic_clear(&iocq_lock, __ATOMIC_RELEASE);
 
 	return nCompletions;
 }
 
+// Fill in the data pointer for a contiguous buffer. Returns NVME_RW_OK or NVME_RW_BAD_ALIGNMENT.
+int nvmeBuildDataPointer(sqe_prp_type * sqe, const u8 * buffer, u32 numLBA)
+{
+	nvmeIOVec_type iov;
+
+	// DWORD-aligned buffers can use PRPs. Registered buffers always do, since their list is prebuilt.
+	if(((u64) buffer & 0x3) == 0)
+	{
+		if(nvmeBuildRegisteredPRP(sqe, buffer, numLBA)) { return NVME_RW_OK; }
+
+		if((sgl_support == ID_SGLS_SUPPORT_NONE) || ((numLBA << lba_exp) < SGL_THRESHOLD))
+		{
+			nvmeBuildPRP(sqe, buffer, numLBA);
+			return NVME_RW_OK;
+		}
+	}
+
+	// Unaligned buffers and large unregistered transfers use a single SGL Data Block descriptor, if supported.
+	iov.base = (u8 *) buffer;
+	iov.len = numLBA << lba_exp;
+	if(nvmeBuildSGL(sqe, &iov, 1)) { return NVME_RW_OK; }
+
+	return NVME_RW_BAD_ALIGNMENT;
+}
+
+// Fill in PRP1 and PRP2 for a DWORD-aligned buffer, building a PRP list if needed.
+void nvmeBuildPRP(sqe_prp_type * sqe, const u8 * buffer, u32 numLBA)
+{
+	int nLBA = numLBA;
+	int nPRP;
+	int offset;
+	u64 * prpList = prpListHeap + ((sqe->CID & IOSQ_SIZE) * (DDR_PAGE_SIZE >> 3));
+
+	sqe->PRP1 = (u64) buffer;
+
+	// Subtract off the integer number of LBAs covered by the first PRP.
+	offset = (u64) buffer & DDR_PAGE_MASK;
+	nLBA -= (DDR_PAGE_SIZE - offset) >> lba_exp;
+
+	// If there is more data to transfer...
+	if(nLBA > 0)
+	{
+		// Move the buffer pointer to its page boundary.
+		buffer -= (u64) offset;
+
+		nPRP = ((nLBA - 1) >> (DDR_PAGE_EXP - lba_exp)) + 1;
+		if(nPRP > 1)
+		{
+			// 2 or more PRPs remaining, use a list.
+			sqe->PRP2 = (u64) prpList;
+			for(int p = 1; p <= nPRP; p++)
+			{
+				prpList[p-1] = (u64)(buffer + (p << DDR_PAGE_EXP));
+			}
+		}
+		else
+		{
+			// 1 PRP remaining, fits in the command itself.
+			sqe->PRP2 = (u64) (buffer + (1 << DDR_PAGE_EXP));
+		}
+	}
+}
+
+// Fill in PRP1 and PRP2 from a registered buffer's persistent list. Returns 0 if the transfer isn't fully covered by one.
+int nvmeBuildRegisteredPRP(sqe_prp_type * sqe, const u8 * buffer, u32 numLBA)
+{
+	u64 addrStart = (u64) buffer;
+	u64 addrEnd = addrStart + ((u64) numLBA << lba_exp);
+	u32 pFirst, pLast;
+
+	for(int slot = 0; slot < REG_BUFFERS_MAX; slot++)
+	{
+		if((regBuffer[slot].nPages == 0) || (addrStart < regBuffer[slot].addrStart) || (addrEnd > regBuffer[slot].addrEnd))
+		{ continue; }
+
+		// Index of the second page of the transfer and of its last page in the persistent list.
+		pFirst = ((addrStart >> DDR_PAGE_EXP) - (regBuffer[slot].addrStart >> DDR_PAGE_EXP)) + 1;
+		pLast = ((addrEnd - 1) >> DDR_PAGE_EXP) - (regBuffer[slot].addrStart >> DDR_PAGE_EXP);
+
+		sqe->PRP1 = addrStart;
+
+		if(pLast < pFirst)
+		{
+			// The whole transfer fits in the first PRP.
+			sqe->PRP2 = 0;
+			return 1;
+		}
+
+		if(pLast == pFirst)
+		{
+			// 1 PRP remaining, fits in the command itself.
+			sqe->PRP2 = regBuffer[slot].prpList[pFirst];
+			return 1;
+		}
+
+		// The list has no chain entries, so the slice used by this command can't cross a list page boundary.
+		if((pFirst / REG_PRP_PER_LIST_PAGE) != (pLast / REG_PRP_PER_LIST_PAGE)) { return 0; }
+
+		sqe->PRP2 = (u64) &regBuffer[slot].prpList[pFirst];
+		return 1;
+	}
+
+	return 0;
+}
+
+// Fill in the data pointer for a vectored transfer. Returns the number of LBAs, or a negated NVME_RW_* error.
+int nvmeBuildIOV(sqe_prp_type * sqe, const nvmeIOVec_type * iov, u16 iovCount)
+{
+	u64 nBytes = 0;
+	int nvmeRWStatus;
+
+	if(iovCount == 0) { return -NVME_RW_BAD_LENGTH; }
+	for(u16 i = 0; i < iovCount; i++) { nBytes += iov[i].len; }
+	if((nBytes == 0) || (nBytes & (lba_size - 1)) || (nBytes > io_transfer_max)) { return -NVME_RW_BAD_LENGTH; }
+
+	// Single segment: same as a contiguous transfer.
+	if(iovCount == 1)
+	{
+		nvmeRWStatus = nvmeBuildDataPointer(sqe, iov[0].base, iov[0].len >> lba_exp);
+		if(nvmeRWStatus != NVME_RW_OK) { return -nvmeRWStatus; }
+		return (int)(nBytes >> lba_exp);
+	}
+
+	// Prefer PRPs if the segment layout allows it, since every controller supports them.
+	if(nvmeBuildIOVPRP(sqe, iov, iovCount)) { return (int)(nBytes >> lba_exp); }
+	if(nvmeBuildSGL(sqe, iov, iovCount)) { return (int)(nBytes >> lba_exp); }
+
+	return -NVME_RW_BAD_ALIGNMENT;
+}
+
+// PRPs can describe the vector only if the segments join at page boundaries. Returns 0 if they don't.
+int nvmeBuildIOVPRP(sqe_prp_type * sqe, const nvmeIOVec_type * iov, u16 iovCount)
+{
+	u64 * prpList = prpListHeap + ((sqe->CID & IOSQ_SIZE) * (DDR_PAGE_SIZE >> 3));
+	u32 nPRP = 0;
+	u64 addr, addrEnd;
+
+	if((u64) iov[0].base & 0x3) { return 0; }
+	for(u16 i = 0; i < iovCount; i++)
+	{
+		if((i > 0) && ((u64) iov[i].base & DDR_PAGE_MASK)) { return 0; }
+		if((i < iovCount - 1) && (((u64) iov[i].base + iov[i].len) & DDR_PAGE_MASK)) { return 0; }
+	}
+
+	sqe->PRP1 = (u64) iov[0].base;
+
+	// List every page after the first one, across all segments.
+	for(u16 i = 0; i < iovCount; i++)
+	{
+		addr = ((u64) iov[i].base & ~((u64) DDR_PAGE_MASK)) + ((i == 0) ? DDR_PAGE_SIZE : 0);
+		addrEnd = (u64) iov[i].base + iov[i].len;
+		for(; addr < addrEnd; addr += DDR_PAGE_SIZE)
+		{
+			if(nPRP == IOV_PRP_MAX) { return 0; }
+			prpList[nPRP++] = addr;
+		}
+	}
+
+	if(nPRP == 1)
+	{
+		// 1 PRP remaining, fits in the command itself.
+		sqe->PRP2 = prpList[0];
+	}
+	else if(nPRP > 1)
+	{
+		sqe->PRP2 = (u64) prpList;
+	}
+
+	return 1;
+}
+
+// SGLs can describe any vector the controller's alignment rules allow. Returns 0 if SGLs can't be used.
+// Each page of the command's SGL heap is one segment. Full pages end in a Segment or Last Segment descriptor
+// that chains to the next page, and the final segment contains only Data Block descriptors.
+int nvmeBuildSGL(sqe_prp_type * sqe, const nvmeIOVec_type * iov, u16 iovCount)
+{
+	sglDesc_type * sglSegment = (sglDesc_type *)((u64) sglHeap + (sqe->CID & IOSQ_SIZE) * SGL_PAGES_PER_CMD * DDR_PAGE_SIZE);
+	sglDesc_type * sglPointer = (sglDesc_type *) &sqe->PRP1;
+	u32 nRemaining = iovCount;
+	u32 nSegment;
+	u16 i = 0;
+
+	if(sgl_support == ID_SGLS_SUPPORT_NONE) { return 0; }
+	if(iovCount > SGL_MAX) { return 0; }
+	if(sgl_support == ID_SGLS_SUPPORT_DWORD)
+	{
+		for(u16 j = 0; j < iovCount; j++)
+		{
+			if(((u64) iov[j].base | iov[j].len) & 0x3) { return 0; }
+		}
+	}
+
+	sqe->PSDT_FUSE = (sqe->PSDT_FUSE & ~0xC0) | SQE_PSDT_SGL;
+
+	if(iovCount == 1)
+	{
+		// Single segment: Data Block descriptor directly in the command.
+		memset(sglPointer, 0, sizeof(sglDesc_type));
+		sglPointer->address = (u64) iov[0].base;
+		sglPointer->length = iov[0].len;
+		sglPointer->SGLID = SGL_ID_DATA_BLOCK;
+		return 1;
+	}
+
+	while(nRemaining > 0)
+	{
+		// Descriptors in this segment, including a trailing pointer to the next one if the rest don't fit.
+		nSegment = (nRemaining > SGL_PER_PAGE) ? SGL_PER_PAGE : nRemaining;
+
+		memset(sglPointer, 0, sizeof(sglDesc_type));
+		sglPointer->address = (u64) sglSegment;
+		sglPointer->length = nSegment * sizeof(sglDesc_type);
+		sglPointer->SGLID = (nRemaining > SGL_PER_PAGE) ? SGL_ID_SEGMENT : SGL_ID_LAST_SEGMENT;
+
+		if(nRemaining > SGL_PER_PAGE) { nSegment--; }
+
+		for(u32 d = 0; d < nSegment; d++, i++)
+		{
+			memset(&sglSegment[d], 0, sizeof(sglDesc_type));
+			sglSegment[d].address = (u64) iov[i].base;
+			sglSegment[d].length = iov[i].len;
+			sglSegment[d].SGLID = SGL_ID_DATA_BLOCK;
+		}
+
+		nRemaining -= nSegment;
+		sglPointer = &sglSegment[nSegment];
+		sglSegment += SGL_PER_PAGE;
+	}
+
+	return 1;
+}
+
 int nvmeCheckTimeout(XTime tStart, u32 tTimeout_ms)
 {
 	XTime tNow;
@@ -45,28 +45,119 @@ THE SOFTWARE.
 #define NVME_ERROR_LBA_SIZE                0x00000200
 #define NVME_ERROR_POWER_STATE_TRANSITION  0x00000400
 #define NVME_ERROR_QUEUE_CREATION          0x00000800
+#define NVME_ERROR_SET_FEATURES            0x00001000
 
 #define NVME_RW_OK                         0x00000000
 #define NVME_RW_BAD_ALIGNMENT              0x00000001
+#define NVME_RW_BAD_LENGTH                 0x00000002
+#define NVME_RW_QUEUE_FULL                 0x00000004	// I/O queues full. Retry after completions are serviced.
+
+// I/O Submission Queues, all sharing one I/O Completion Queue
+#define NVME_IOSQ_COUNT                    2
+#define NVME_IOSQ_BULK                     0			// Default queue, e.g. for capture data.
+#define NVME_IOSQ_PRIORITY                 1			// Latency-sensitive queue, e.g. for metadata.
+#define NVME_IO_QUEUE_DEPTH                63			// Most I/O commands in flight at a time, across all I/O SQs.
+#define NVME_IO_SLOTS                      64			// CIDs of the I/O commands in flight differ modulo this.
+
+#define NVME_COMPLETION_HOOKS_MAX          2			// Completion hooks added at a time.
+
+// I/O Submission Queue Priority (Weighted Round Robin Arbitration Only)
+#define NVME_QPRIO_URGENT                  0x0
+#define NVME_QPRIO_HIGH                    0x1
+#define NVME_QPRIO_MEDIUM                  0x2
+#define NVME_QPRIO_LOW                     0x3
+
+#define NVME_REG_OK                        0x00000000
+#define NVME_REG_BAD_ALIGNMENT             0x00000001
+#define NVME_REG_TOO_LARGE                 0x00000002
+#define NVME_REG_NO_SLOT                   0x00000004
+#define NVME_REG_NOT_FOUND                 0x00000008
 
 // Public Type Definitions ---------------------------------------------------------------------------------------------
 
+// I/O Vector Segment for Vectored Reads and Writes
+typedef struct
+{
+	u8 * base;
+	u32 len;					// [B]
+} nvmeIOVec_type;
+
+// I/O Command Completion, for callers that track individual commands by CID.
+typedef struct
+{
+	u16 cid;					// Command Identifier
+	u16 status;					// Status Field (0 = Success)
+	u32 numLBA;					// LBAs transferred, 0 for commands without data.
+	u32 latency;				// Submission to completion, in XTime counts.
+} nvmeCompletion_type;
+
+// Called for every completed I/O command while added, e.g. for performance logging, by whichever core reaps it.
+typedef void (*nvmeCompletionHook_type)(const nvmeCompletion_type * completion);
+
+// Queue Arbitration and Completion Coalescing Configuration
+// Must be set with nvmeSetQueueConfig() before nvmeInit() to take effect. The I/O CQ is created with interrupts disabled
+// and polled, so the aggregation settings are programmed but have no effect on when completions are seen.
+typedef struct
+{
+	u8 wrr;							// 1: Weighted Round Robin with Urgent Priority Class, if supported. 0: Round Robin.
+	u8 sqPriority[NVME_IOSQ_COUNT];	// NVME_QPRIO_* for each I/O Submission Queue (WRR only).
+	u8 weightHigh;					// High Priority Weight, 0's Based (WRR only)
+	u8 weightMedium;				// Medium Priority Weight, 0's Based (WRR only)
+	u8 weightLow;					// Low Priority Weight, 0's Based (WRR only)
+	u8 arbitrationBurst;			// Arbitration Burst (2^N [Command]), 7 = No Limit
+	u8 aggrThreshold;				// Completion Aggregation Threshold, 0's Based [Completion]
+	u8 aggrTime;					// Completion Aggregation Time in [100us], 0 = No Coalescing
+} nvmeQueueConfig_type;
+
+// Thermal Status from Identify Controller and the Most Recent SMART / Health Log Page
+typedef struct
+{
+	float tComposite;				// Composite Temperature in [degC]
+	float tWarning;					// Warning Composite Temperature Threshold (WCTEMP) in [degC], 0 if not reported.
+	float tCritical;				// Critical Composite Temperature Threshold (CCTEMP) in [degC], 0 if not reported.
+	u32 tWarningTime_min;			// Time above WCTEMP in [min]
+	u32 tCriticalTime_min;			// Time above CCTEMP in [min]
+	u32 tmt1Count;					// Thermal Management Temperature 1 Transition Count
+	u32 tmt2Count;					// Thermal Management Temperature 2 Transition Count
+	u32 tmt1Time_s;					// Total Time For Thermal Management Temperature 1 in [s]
+	u32 tmt2Time_s;					// Total Time For Thermal Management Temperature 2 in [s]
+	u8 hctmSupported;				// Host Controlled Thermal Management supported.
+} nvmeThermal_type;
+
 // Public Function Prototypes ------------------------------------------------------------------------------------------
 
 int nvmeInit(void);
 int nvmeGetStatus(void);
 u64 nvmeGetLBACount(void);
 u16 nvmeGetLBASize(void);
+u32 nvmeGetMaxTransferSize(void);
 int nvmeGetMetrics(void);
 float nvmeGetTemp(void);
+void nvmeGetThermal(nvmeThermal_type * thermal);
+int nvmeSetThermalManagement(float tmt1, float tmt2);
 
 int nvmeWrite(const u8 * srcByte, u64 destLBA, u32 numLBA);
+int nvmeWriteCID(const u8 * srcByte, u64 destLBA, u32 numLBA, u16 * cid);
 int nvmeFlush();
 int nvmeRead(u8 * destByte, u64 srcLBA, u32 numLBA);
+int nvmeReadCID(u8 * destByte, u64 srcLBA, u32 numLBA, u16 * cid);
+int nvmeWritev(const nvmeIOVec_type * iov, u16 iovCount, u64 destLBA);
+int nvmeReadv(const nvmeIOVec_type * iov, u16 iovCount, u64 srcLBA);
 int nvmeServiceIOCompletions(u16 maxCompletions);
+int nvmeServiceIOCompletionsCID(nvmeCompletion_type * completions, u16 maxCompletions);
+u8 nvmeIsIOComplete(u16 cid, u16 * status);
+u8 nvmeIsIOPending(u16 cid);
+int nvmeAddCompletionHook(nvmeCompletionHook_type hook);
+void nvmeRemoveCompletionHook(nvmeCompletionHook_type hook);
+void nvmeSetQueueConfig(const nvmeQueueConfig_type * config);
+int nvmeSelectIOQueue(u8 sq);
+u8 nvmeGetIOQueue(void);
 u16 nvmeGetIOSlip(void);
 int nvmeTrim(u64 startLBA, u32 numLBA);
 
+int nvmeRegisterBuffer(const u8 * buffer, u32 size);
+int nvmeUnregisterBuffer(const u8 * buffer);
+
 // Externed Public Global Variables ------------------------------------------------------------------------------------
 
 extern u8 lba_exp;
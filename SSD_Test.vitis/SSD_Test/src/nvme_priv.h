@@ -83,6 +83,24 @@ THE SOFTWARE.
 #define REG_CSTS_RDY                 0x00000001
 // ====================================================================================
 
+// Identify Controller SGL Support
+// ====================================================================================
+#define ID_SGLS_SUPPORT_Msk         0x00000003
+#define ID_SGLS_SUPPORT_NONE        0x00000000	// SGLs not supported.
+#define ID_SGLS_SUPPORT_BYTE        0x00000001	// SGLs supported, no alignment or granularity requirement.
+#define ID_SGLS_SUPPORT_DWORD       0x00000002	// SGLs supported, DWORD alignment and granularity required.
+// ====================================================================================
+
+// Submission Queue Entry and SGL Descriptor Fields
+// ====================================================================================
+#define SQE_PSDT_PRP                      0x00	// PRPs used for this transfer.
+#define SQE_PSDT_SGL                      0x40	// SGLs used for this transfer, MPTR is an address.
+
+#define SGL_ID_DATA_BLOCK                 0x00	// SGL Data Block Descriptor, Address Subtype
+#define SGL_ID_SEGMENT                    0x20	// SGL Segment Descriptor, Address Subtype
+#define SGL_ID_LAST_SEGMENT               0x30	// SGL Last Segment Descriptor, Address Subtype
+// ====================================================================================
+
 // Power State Descriptor Bitfields
 // ====================================================================================
 #define PSD_MXPS_Offset                      0
@@ -140,6 +158,15 @@ typedef struct __attribute__((packed))
 	u32 CDW15;
 } sqe_prp_type;
 
+// 16B SGL Descriptor, can replace PRP1 and PRP2 in a Submission Queue Entry
+typedef struct __attribute__((packed))
+{
+	u64 address;
+	u32 length;					// [B]
+	u8 reserved[3];
+	u8 SGLID;					// SGL Descriptor Type (7:4) and Subtype (3:0)
+} sglDesc_type;
+
 // 16B Completion Queue Entry
 typedef struct __attribute__((packed))
 {
@@ -336,6 +363,15 @@ typedef struct __attribute__((packed))
 	u8 reserved2[280];
 } logSMARTHealth_type;
 
+// Registered Buffer with Precomputed PRP List
+typedef struct
+{
+	u64 addrStart;				// First byte of the buffer.
+	u64 addrEnd;				// One past the last byte of the buffer.
+	u64 * prpList;				// Page addresses, starting with the page containing addrStart.
+	u32 nPages;
+} regBuffer_type;
+
 // Range Definition for Dataset Management Commands
 typedef struct __attribute__((packed))
 {
@@ -0,0 +1,149 @@
+/*
+Rate Pacing
+
+Token bucket that paces block I/O to a target data rate. Tokens arrive in batches: one block at a time for a smooth
+stream, or one frame's worth of blocks at a time to replay a camera's frame cadence. Tokens that arrive while the
+test is stalled are kept, up to the bucket depth, so the test catches up afterwards instead of losing the time.
+Tokens beyond the bucket depth are counted as dropped: that is input a recorder with that much buffering would lose.
+paceWait() services I/O completions while it waits for a token.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "pace.h"
+#include "xtime_l.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void paceRefill(XTime tNow);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+u32 paceBlockSize = 0;			// Bytes per block.
+u32 paceBatch = 1;				// Blocks per token arrival.
+u32 paceDepth = 1;				// Bucket depth in blocks.
+u32 paceTokens = 0;				// Blocks that may be released now.
+u64 paceCountsPerBatch = 0;		// Timer counts between token arrivals.
+XTime paceNextArrival = 0;
+float paceRate = 0.0f;			// Current rate in [MB/s].
+paceStats_type paceStats;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Smooth token bucket: rate in [MB/s], burst is the bucket depth in blocks (1 for no burst allowance).
+void paceInit(u32 blockSize, float rate, u32 burst)
+{
+	paceBlockSize = blockSize;
+	paceBatch = 1;
+	paceDepth = (burst > 0) ? burst : 1;
+	paceSetRate(rate);
+
+	// The first block is released immediately.
+	XTime_GetTime(&paceNextArrival);
+	paceTokens = 0;
+
+	paceStats.blocksReleased = 0;
+	paceStats.blocksDropped = 0;
+	paceStats.backlogMax = 0;
+	paceStats.depth = paceDepth;
+}
+
+// Frame cadence: fps frames per second of frameSize bytes each, rounded up to whole blocks. All of a frame's blocks
+// arrive at once. The bucket holds at least one frame; burst is the extra depth in blocks beyond that.
+void paceInitFrames(u32 blockSize, float fps, u32 frameSize, u32 burst)
+{
+	u32 blocksPerFrame = (frameSize + blockSize - 1) / blockSize;
+
+	if(blocksPerFrame == 0) { blocksPerFrame = 1; }
+
+	paceInit(blockSize, fps * (float)blocksPerFrame * (float)blockSize * 1e-6f, 0);
+	paceBatch = blocksPerFrame;
+	paceDepth = blocksPerFrame + burst;
+	paceSetRate(paceRate);
+	paceStats.depth = paceDepth;
+}
+
+// Change the rate in [MB/s], e.g. from the thermal governor. In frame mode this changes the frame rate.
+void paceSetRate(float rate)
+{
+	if(rate < 0.001f) { rate = 0.001f; }
+	paceRate = rate;
+	paceCountsPerBatch = (u64)((float)paceBatch * (float)paceBlockSize * (float)COUNTS_PER_SECOND / (rate * 1e6f));
+	if(paceCountsPerBatch == 0) { paceCountsPerBatch = 1; }
+}
+
+float paceGetRate(void)
+{
+	return paceRate;
+}
+
+// Wait for a token to release one block, calling service (if not NULL) while waiting.
+void paceWait(void (*service)(void))
+{
+	XTime tNow;
+
+	XTime_GetTime(&tNow);
+	paceRefill(tNow);
+
+	while(paceTokens == 0)
+	{
+		if(service) { service(); }
+		XTime_GetTime(&tNow);
+		paceRefill(tNow);
+	}
+
+	paceTokens--;
+	paceStats.blocksReleased++;
+}
+
+// Take a token if one is available, without waiting. Returns 1 if a block may be released.
+u8 paceTry(void)
+{
+	XTime tNow;
+
+	XTime_GetTime(&tNow);
+	paceRefill(tNow);
+
+	if(paceTokens == 0) { return 0; }
+
+	paceTokens--;
+	paceStats.blocksReleased++;
+	return 1;
+}
+
+void paceGetStats(paceStats_type * stats)
+{
+	*stats = paceStats;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Add the tokens that have arrived by tNow, discarding any that overflow the bucket.
+void paceRefill(XTime tNow)
+{
+	u64 nArrivals;
+	u64 tokens;
+
+	if(tNow < paceNextArrival) { return; }
+
+	nArrivals = (tNow - paceNextArrival) / paceCountsPerBatch + 1;
+	paceNextArrival += nArrivals * paceCountsPerBatch;
+
+	tokens = (u64)paceTokens + nArrivals * paceBatch;
+	if(tokens > paceDepth)
+	{
+		paceStats.blocksDropped += tokens - paceDepth;
+		tokens = paceDepth;
+	}
+	paceTokens = (u32)tokens;
+
+	if(paceTokens > paceStats.backlogMax) { paceStats.backlogMax = paceTokens; }
+}
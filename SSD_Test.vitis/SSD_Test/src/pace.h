@@ -0,0 +1,37 @@
+/*
+Rate Pacing Include
+*/
+
+#ifndef __PACE_INCLUDE__
+#define __PACE_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Pacing Statistics, since paceInit() or paceInitFrames().
+typedef struct
+{
+	u64 blocksReleased;		// Blocks allowed through paceWait().
+	u64 blocksDropped;		// Blocks whose tokens overflowed the bucket, i.e. input a recorder would have lost.
+	u32 backlogMax;			// Most tokens waiting at once, in blocks.
+	u32 depth;				// Bucket depth in blocks.
+} paceStats_type;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+void paceInit(u32 blockSize, float rate, u32 burst);
+void paceInitFrames(u32 blockSize, float fps, u32 frameSize, u32 burst);
+void paceSetRate(float rate);
+float paceGetRate(void);
+void paceWait(void (*service)(void));
+u8 paceTry(void);
+void paceGetStats(paceStats_type * stats);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,220 @@
+/*
+Data Integrity Pattern Generation and Checking
+
+Each LBA starts with a 16B header: its own LBA, then the pass number and seed. The rest of the LBA is an arithmetic
+sequence of 64-bit words starting from a hash of (LBA, pass, seed), so every LBA, pass and seed gives different data
+and a misplaced or stale block is detected. Generating and comparing the sequence takes one vector add per 16B, so
+the AArch64 build uses NEON for both. The comparison only finds which LBAs are bad; the per-bit statistics are
+computed for those LBAs alone with the scalar path.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "pattern.h"
+#include <string.h>
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PATTERN_USE_NEON 1
+#else
+#define PATTERN_USE_NEON 0
+#endif
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define PATTERN_HEADER_WORDS 2
+#define PATTERN_STEP 0x9E3779B97F4A7C15ULL		// Odd, so the sequence doesn't repeat within an LBA.
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+u64 patternBase(u64 lba, u32 pass, u32 seed);
+void patternFillLBA(u64 * word, u64 lba, u32 nWords, u32 pass, u32 seed);
+u64 patternCompareLBA(const u64 * word, u64 lba, u32 nWords, u32 pass, u32 seed);
+void patternCountLBA(const u64 * word, u64 lba, u32 nWords, u32 pass, u32 seed, patternStats_type * stats);
+u32 patternPopCount(u64 x);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Fill numLBA LBAs of lbaSize bytes starting at LBA lba. lbaSize must be a multiple of 64B.
+void patternFill(u8 * buffer, u64 lba, u32 numLBA, u32 lbaSize, u32 pass, u32 seed)
+{
+	u32 nWords = lbaSize >> 3;
+
+	for(u32 i = 0; i < numLBA; i++)
+	{
+		patternFillLBA((u64 *)(buffer + (u64) i * lbaSize), lba + i, nWords, pass, seed);
+	}
+}
+
+// Check numLBA LBAs against the pattern and accumulate results into stats. Returns the number of bad LBAs.
+u32 patternCheck(const u8 * buffer, u64 lba, u32 numLBA, u32 lbaSize, u32 pass, u32 seed, patternStats_type * stats)
+{
+	u32 nWords = lbaSize >> 3;
+	u32 nBad = 0;
+	const u64 * word;
+
+	for(u32 i = 0; i < numLBA; i++)
+	{
+		word = (const u64 *)(buffer + (u64) i * lbaSize);
+		stats->lbaChecked++;
+
+		if(patternCompareLBA(word, lba + i, nWords, pass, seed) == 0) { continue; }
+
+		if(stats->lbaBad == 0)
+		{
+			stats->firstBadLBA = lba + i;
+			stats->firstBadStampLBA = word[0];
+		}
+		stats->lbaBad++;
+		nBad++;
+
+		patternCountLBA(word, lba + i, nWords, pass, seed, stats);
+	}
+
+	return nBad;
+}
+
+void patternResetStats(patternStats_type * stats)
+{
+	memset(stats, 0, sizeof(patternStats_type));
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// SplitMix64 finalizer over the LBA, pass and seed.
+u64 patternBase(u64 lba, u32 pass, u32 seed)
+{
+	u64 x = lba ^ ((u64) pass << 40) ^ ((u64) seed * PATTERN_STEP);
+
+	x ^= x >> 30;
+	x *= 0xBF58476D1CE4E5B9ULL;
+	x ^= x >> 27;
+	x *= 0x94D049BB133111EBULL;
+	x ^= x >> 31;
+
+	return x;
+}
+
+void patternFillLBA(u64 * word, u64 lba, u32 nWords, u32 pass, u32 seed)
+{
+	u64 base = patternBase(lba, pass, seed);
+	u32 i = PATTERN_HEADER_WORDS;
+
+	word[0] = lba;
+	word[1] = ((u64) pass << 32) | seed;
+
+#if PATTERN_USE_NEON
+	// 8 words (64B) per iteration, as four 2-lane vectors.
+	uint64x2_t v0 = vcombine_u64(vcreate_u64(base + 2 * PATTERN_STEP), vcreate_u64(base + 3 * PATTERN_STEP));
+	uint64x2_t v1 = vaddq_u64(v0, vdupq_n_u64(2 * PATTERN_STEP));
+	uint64x2_t v2 = vaddq_u64(v0, vdupq_n_u64(4 * PATTERN_STEP));
+	uint64x2_t v3 = vaddq_u64(v0, vdupq_n_u64(6 * PATTERN_STEP));
+	uint64x2_t inc = vdupq_n_u64(8 * PATTERN_STEP);
+
+	// Words 2-7 finish the first 64B, then whole 64B lines.
+	vst1q_u64(&word[2], v0);
+	vst1q_u64(&word[4], v1);
+	vst1q_u64(&word[6], v2);
+	v0 = v3;
+	v1 = vaddq_u64(v0, vdupq_n_u64(2 * PATTERN_STEP));
+	v2 = vaddq_u64(v0, vdupq_n_u64(4 * PATTERN_STEP));
+	v3 = vaddq_u64(v0, vdupq_n_u64(6 * PATTERN_STEP));
+	for(i = 8; i < nWords; i += 8)
+	{
+		vst1q_u64(&word[i], v0);
+		vst1q_u64(&word[i + 2], v1);
+		vst1q_u64(&word[i + 4], v2);
+		vst1q_u64(&word[i + 6], v3);
+		v0 = vaddq_u64(v0, inc);
+		v1 = vaddq_u64(v1, inc);
+		v2 = vaddq_u64(v2, inc);
+		v3 = vaddq_u64(v3, inc);
+	}
+#else
+	u64 value = base + PATTERN_HEADER_WORDS * PATTERN_STEP;
+	for(; i < nWords; i++)
+	{
+		word[i] = value;
+		value += PATTERN_STEP;
+	}
+#endif
+}
+
+// Returns the OR of all differences between the LBA and its pattern, i.e. 0 if it matches.
+u64 patternCompareLBA(const u64 * word, u64 lba, u32 nWords, u32 pass, u32 seed)
+{
+	u64 base = patternBase(lba, pass, seed);
+	u64 diff = (word[0] ^ lba) | (word[1] ^ (((u64) pass << 32) | seed));
+	u32 i = PATTERN_HEADER_WORDS;
+
+#if PATTERN_USE_NEON
+	uint64x2_t e0 = vcombine_u64(vcreate_u64(base + 2 * PATTERN_STEP), vcreate_u64(base + 3 * PATTERN_STEP));
+	uint64x2_t e1 = vaddq_u64(e0, vdupq_n_u64(2 * PATTERN_STEP));
+	uint64x2_t e2 = vaddq_u64(e0, vdupq_n_u64(4 * PATTERN_STEP));
+	uint64x2_t e3;
+	uint64x2_t inc = vdupq_n_u64(8 * PATTERN_STEP);
+	uint64x2_t acc;
+
+	acc = veorq_u64(vld1q_u64(&word[2]), e0);
+	acc = vorrq_u64(acc, veorq_u64(vld1q_u64(&word[4]), e1));
+	acc = vorrq_u64(acc, veorq_u64(vld1q_u64(&word[6]), e2));
+	e0 = vaddq_u64(e0, vdupq_n_u64(6 * PATTERN_STEP));
+	e1 = vaddq_u64(e0, vdupq_n_u64(2 * PATTERN_STEP));
+	e2 = vaddq_u64(e0, vdupq_n_u64(4 * PATTERN_STEP));
+	e3 = vaddq_u64(e0, vdupq_n_u64(6 * PATTERN_STEP));
+	for(i = 8; i < nWords; i += 8)
+	{
+		acc = vorrq_u64(acc, veorq_u64(vld1q_u64(&word[i]), e0));
+		acc = vorrq_u64(acc, veorq_u64(vld1q_u64(&word[i + 2]), e1));
+		acc = vorrq_u64(acc, veorq_u64(vld1q_u64(&word[i + 4]), e2));
+		acc = vorrq_u64(acc, veorq_u64(vld1q_u64(&word[i + 6]), e3));
+		e0 = vaddq_u64(e0, inc);
+		e1 = vaddq_u64(e1, inc);
+		e2 = vaddq_u64(e2, inc);
+		e3 = vaddq_u64(e3, inc);
+	}
+	diff |= vgetq_lane_u64(acc, 0) | vgetq_lane_u64(acc, 1);
+#else
+	u64 value = base + PATTERN_HEADER_WORDS * PATTERN_STEP;
+	for(; i < nWords; i++)
+	{
+		diff |= word[i] ^ value;
+		value += PATTERN_STEP;
+	}
+#endif
+
+	return diff;
+}
+
+// Word and bit error counts for an LBA that failed the fast comparison.
+void patternCountLBA(const u64 * word, u64 lba, u32 nWords, u32 pass, u32 seed, patternStats_type * stats)
+{
+	u64 expected;
+	u64 value = patternBase(lba, pass, seed) + PATTERN_HEADER_WORDS * PATTERN_STEP;
+
+	for(u32 i = 0; i < nWords; i++)
+	{
+		if(i == 0) { expected = lba; }
+		else if(i == 1) { expected = ((u64) pass << 32) | seed; }
+		else { expected = value; value += PATTERN_STEP; }
+
+		if(word[i] == expected) { continue; }
+
+		stats->wordsBad++;
+		stats->bitsBad += patternPopCount(word[i] ^ expected);
+		stats->bits0to1 += patternPopCount(word[i] & ~expected);
+		stats->bits1to0 += patternPopCount(~word[i] & expected);
+	}
+}
+
+u32 patternPopCount(u64 x)
+{
+	return (u32) __builtin_popcountll(x);
+}
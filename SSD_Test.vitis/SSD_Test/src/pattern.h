@@ -0,0 +1,37 @@
+/*
+Data Integrity Pattern Generation and Checking Include
+*/
+
+#ifndef __PATTERN_INCLUDE__
+#define __PATTERN_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Verification Results, accumulated over any number of patternCheck() calls.
+typedef struct
+{
+	u64 lbaChecked;
+	u64 lbaBad;
+	u64 firstBadLBA;			// Valid if lbaBad > 0.
+	u64 firstBadStampLBA;		// LBA stamped in the first bad block's header, to spot misdirected writes.
+	u64 wordsBad;				// Mismatched 64-bit words.
+	u64 bitsBad;
+	u64 bits0to1;				// Bits read as 1 that were written as 0.
+	u64 bits1to0;				// Bits read as 0 that were written as 1.
+} patternStats_type;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+void patternFill(u8 * buffer, u64 lba, u32 numLBA, u32 lbaSize, u32 pass, u32 seed);
+u32 patternCheck(const u8 * buffer, u64 lba, u32 numLBA, u32 lbaSize, u32 pass, u32 seed, patternStats_type * stats);
+void patternResetStats(patternStats_type * stats);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
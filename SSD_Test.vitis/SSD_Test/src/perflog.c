@@ -0,0 +1,232 @@
+/*
+Performance Log
+
+Binary log of fine-grained performance data, kept in a ring in DDR and dumped after the run. While the log is running,
+it hooks I/O completions in the NVMe driver and records:
+ - One interval record per elapsed interval that saw a completion: bytes completed, commands in flight, temperature.
+   An interval with no completions at all (a stall) shows up as a gap between interval record times.
+ - One latency record per latencyEvery completions: command latency and size.
+When the ring is full, the oldest records are overwritten. perfLogDumpUART() prints the header and records as hex
+lines; perfLogDumpDisk() writes the raw header and ring to a reserved region at the end of the SSD, for a host script
+to read back with dd.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "perflog.h"
+#include "nvme.h"
+#include "xtime_l.h"
+#include "xil_printf.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// The log sits in DDR after the application data buffer and capture ring.
+#define PERFLOG_BASE 0x60000000
+#define PERFLOG_BYTES (256 << 20)
+#define PERFLOG_HEADER_BYTES 4096
+#define PERFLOG_CAPACITY ((PERFLOG_BYTES - PERFLOG_HEADER_BYTES) / sizeof(perfLogRecord_type))
+
+// Disk dumps are written in chunks of this size, or of the drive's maximum transfer size if that is smaller.
+#define PERFLOG_DUMP_CHUNK (1 << 20)
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void perfLogCompletion(const nvmeCompletion_type * completion);
+void perfLogAppend(u8 type, u64 time, u32 value, s16 aux);
+s16 perfLogTemp(void);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+perfLogHeader_type * const perfLogHeader = (perfLogHeader_type * const) (PERFLOG_BASE);
+perfLogRecord_type * const perfLogRecords = (perfLogRecord_type * const) (PERFLOG_BASE + PERFLOG_HEADER_BYTES);
+
+XTime perfLogTStart = 0;
+u64 perfLogCountsPerInterval = 0;
+u64 perfLogIntervalEnd = 0;			// End of the current interval, in counts since perfLogTStart.
+u64 perfLogIntervalBytes = 0;
+u32 perfLogLatencyCountdown = 0;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Clear the log and start recording, with interval records every intervalUs and one latency record per latencyEvery
+// completions (0 for none).
+void perfLogStart(u32 intervalUs, u32 latencyEvery)
+{
+	perfLogHeader->magic = PERFLOG_MAGIC;
+	perfLogHeader->version = PERFLOG_VERSION;
+	perfLogHeader->recordSize = sizeof(perfLogRecord_type);
+	perfLogHeader->countsPerSecond = COUNTS_PER_SECOND;
+	perfLogHeader->capacity = PERFLOG_CAPACITY;
+	perfLogHeader->head = 0;
+	perfLogHeader->count = 0;
+	perfLogHeader->intervalUs = intervalUs;
+	perfLogHeader->latencyEvery = latencyEvery;
+	perfLogHeader->lbaSize = nvmeGetLBASize();
+	perfLogHeader->reserved = 0;
+
+	perfLogCountsPerInterval = (u64)intervalUs * COUNTS_PER_SECOND / 1000000ULL;
+	if(perfLogCountsPerInterval == 0) { perfLogCountsPerInterval = 1; }
+	perfLogIntervalEnd = perfLogCountsPerInterval;
+	perfLogIntervalBytes = 0;
+	perfLogLatencyCountdown = latencyEvery;
+
+	XTime_GetTime(&perfLogTStart);
+	nvmeAddCompletionHook(perfLogCompletion);
+}
+
+// Stop recording. The log is kept until the next perfLogStart().
+void perfLogStop(void)
+{
+	XTime tNow;
+
+	nvmeRemoveCompletionHook(perfLogCompletion);
+
+	// Close out the last partial interval.
+	if(perfLogIntervalBytes > 0)
+	{
+		XTime_GetTime(&tNow);
+		perfLogAppend(PERFLOG_REC_INTERVAL, tNow - perfLogTStart, (u32)perfLogIntervalBytes, perfLogTemp());
+		perfLogIntervalBytes = 0;
+	}
+}
+
+// Add a mark record, e.g. at a phase change within a test.
+void perfLogMark(u32 id)
+{
+	XTime tNow;
+
+	XTime_GetTime(&tNow);
+	perfLogAppend(PERFLOG_REC_MARK, tNow - perfLogTStart, id, 0);
+}
+
+u64 perfLogGetCount(void)
+{
+	return perfLogHeader->count;
+}
+
+// Print the header and the newest nRecords records (all if 0) as hex, one record per line, for capture on a host.
+void perfLogDumpUART(u64 nRecords)
+{
+	u32 * word;
+	u64 index;
+
+	if((nRecords == 0) || (nRecords > perfLogHeader->count)) { nRecords = perfLogHeader->count; }
+
+	// Start at the oldest record to be dumped.
+	index = (perfLogHeader->head + perfLogHeader->capacity - nRecords) % perfLogHeader->capacity;
+
+	xil_printf("PERFLOG BEGIN\r\n");
+	word = (u32 *) perfLogHeader;
+	for(u32 w = 0; w < sizeof(perfLogHeader_type) / sizeof(u32); w++) { xil_printf("%08x", word[w]); }
+	xil_printf("\r\n");
+
+	for(u64 r = 0; r < nRecords; r++)
+	{
+		word = (u32 *) &perfLogRecords[index];
+		xil_printf("%08x%08x%08x%08x\r\n", word[0], word[1], word[2], word[3]);
+		index = (index + 1) % perfLogHeader->capacity;
+	}
+	xil_printf("PERFLOG END\r\n");
+}
+
+// Write the header and the whole ring to the last PERFLOG_BYTES of the SSD. Returns PERFLOG_OK and the first LBA.
+int perfLogDumpDisk(u64 * lbaStart)
+{
+	u32 lbaSize = nvmeGetLBASize();
+	u32 chunk = (nvmeGetMaxTransferSize() < PERFLOG_DUMP_CHUNK) ? nvmeGetMaxTransferSize() : PERFLOG_DUMP_CHUNK;
+	u32 lbaPerChunk;
+	u64 lbaCount = nvmeGetLBACount();
+	u64 bytesUsed = PERFLOG_HEADER_BYTES + perfLogHeader->count * sizeof(perfLogRecord_type);
+	u64 lba;
+	u8 * src = (u8 *) perfLogHeader;
+
+	if(perfLogHeader->count == 0) { return PERFLOG_EMPTY; }
+	if(lbaSize == 0) { return PERFLOG_IO_ERROR; }
+
+	// No more than one command can carry, in whole LBAs.
+	lbaPerChunk = chunk / lbaSize;
+	chunk = lbaPerChunk * lbaSize;
+	if(lbaPerChunk == 0) { return PERFLOG_IO_ERROR; }
+	if(lbaCount < 2 * (PERFLOG_BYTES / lbaSize)) { return PERFLOG_NO_SPACE; }
+
+	lba = lbaCount - PERFLOG_BYTES / lbaSize;
+	*lbaStart = lba;
+
+	// Only the part of the ring that holds records needs writing.
+	for(u64 offset = 0; offset < bytesUsed; offset += chunk)
+	{
+		if(nvmeWrite(src + offset, lba, lbaPerChunk) != NVME_RW_OK) { return PERFLOG_IO_ERROR; }
+		lba += lbaPerChunk;
+		while(nvmeGetIOSlip() > 16) { nvmeServiceIOCompletions(16); }
+	}
+	while(nvmeGetIOSlip() > 0) { nvmeServiceIOCompletions(16); }
+	nvmeFlush();
+	while(nvmeGetIOSlip() > 0) { nvmeServiceIOCompletions(16); }
+
+	return PERFLOG_OK;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// NVMe completion hook.
+void perfLogCompletion(const nvmeCompletion_type * completion)
+{
+	u64 t;
+	XTime tNow;
+	u32 latencyUs;
+	u32 numLBA;
+
+	XTime_GetTime(&tNow);
+	t = tNow - perfLogTStart;
+
+	// Close the interval this completion falls after. Intervals without completions are skipped.
+	if(t >= perfLogIntervalEnd)
+	{
+		if(perfLogIntervalBytes > 0)
+		{
+			perfLogAppend(PERFLOG_REC_INTERVAL, perfLogIntervalEnd, (u32)perfLogIntervalBytes, perfLogTemp());
+		}
+		perfLogIntervalEnd += ((t - perfLogIntervalEnd) / perfLogCountsPerInterval + 1) * perfLogCountsPerInterval;
+		perfLogIntervalBytes = 0;
+	}
+	perfLogIntervalBytes += (u64)completion->numLBA * perfLogHeader->lbaSize;
+
+	if(perfLogHeader->latencyEvery == 0) { return; }
+	if(--perfLogLatencyCountdown > 0) { return; }
+	perfLogLatencyCountdown = perfLogHeader->latencyEvery;
+
+	latencyUs = (u32)((u64)completion->latency * 1000000ULL / COUNTS_PER_SECOND);
+	numLBA = (completion->numLBA > 0x7FFF) ? 0x7FFF : completion->numLBA;
+	perfLogAppend(PERFLOG_REC_LATENCY, t, latencyUs, (s16)numLBA);
+}
+
+void perfLogAppend(u8 type, u64 time, u32 value, s16 aux)
+{
+	perfLogRecord_type * rec = &perfLogRecords[perfLogHeader->head];
+	u16 slip = nvmeGetIOSlip();
+
+	rec->time = time;
+	rec->value = value;
+	rec->aux = aux;
+	rec->qd = (slip > 255) ? 255 : (u8)slip;
+	rec->type = type;
+
+	perfLogHeader->head++;
+	if(perfLogHeader->head == perfLogHeader->capacity) { perfLogHeader->head = 0; }
+	if(perfLogHeader->count < perfLogHeader->capacity) { perfLogHeader->count++; }
+}
+
+// Composite temperature from the most recent SMART / Health sample, in [0.1degC]. Unfiltered, unlike nvmeGetTemp().
+s16 perfLogTemp(void)
+{
+	nvmeThermal_type thermal;
+
+	nvmeGetThermal(&thermal);
+	return (s16)(thermal.tComposite * 10.0f);
+}
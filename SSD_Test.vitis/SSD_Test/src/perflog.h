@@ -0,0 +1,68 @@
+/*
+Performance Log Include
+*/
+
+#ifndef __PERFLOG_INCLUDE__
+#define __PERFLOG_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+#define PERFLOG_MAGIC 0x474F4C50	// "PLOG"
+#define PERFLOG_VERSION 1
+
+// Record Types
+#define PERFLOG_REC_INTERVAL 1		// value = bytes completed in the interval, aux = temperature in [0.1degC]
+#define PERFLOG_REC_LATENCY 2		// value = command latency in [us], aux = command size in [LBA], saturated
+#define PERFLOG_REC_MARK 3			// value = mark ID, from perfLogMark()
+
+// perfLogDumpDisk() Return Values
+#define PERFLOG_OK 0
+#define PERFLOG_EMPTY 1
+#define PERFLOG_NO_SPACE 2
+#define PERFLOG_IO_ERROR 4
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Log Record, 16B with natural alignment. time is in XTime counts since perfLogStart(). qd is the number of commands in flight.
+typedef struct
+{
+	u64 time;
+	u32 value;
+	s16 aux;
+	u8 qd;
+	u8 type;
+} perfLogRecord_type;
+
+// Log Header, at the start of the dump. Records follow it in ring order: if count < capacity, they are records
+// [0, count). Otherwise the oldest is at index head, so the log is [head, capacity) then [0, head).
+typedef struct
+{
+	u32 magic;
+	u16 version;
+	u16 recordSize;
+	u64 countsPerSecond;
+	u64 capacity;				// Records the ring holds.
+	u64 head;					// Next record index to be written.
+	u64 count;					// Valid records, at most capacity.
+	u32 intervalUs;
+	u32 latencyEvery;			// One latency record per this many completions.
+	u32 lbaSize;
+	u32 reserved;
+} perfLogHeader_type;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+void perfLogStart(u32 intervalUs, u32 latencyEvery);
+void perfLogStop(void);
+void perfLogMark(u32 id);
+u64 perfLogGetCount(void);
+void perfLogDumpUART(u64 nRecords);
+int perfLogDumpDisk(u64 * lbaStart);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,178 @@
+/*
+Frame Buffer Ring
+
+Ring of frame buffers between a producer (camera emulation) and a consumer (the NVMe writer). The producer acquires
+the next free frame, fills it, and publishes it. The consumer takes published frames one block at a time, in order,
+and submits each block to the SSD. A frame goes back to the producer only when every write from it has completed,
+so a buffer is never refilled while DMA from it may still be in flight. If the next frame is still owned by the
+consumer when the producer needs it, the incoming frame is dropped, as it would be in a recorder.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "ring.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Frame States
+#define FRAME_FREE 0			// Owned by the producer.
+#define FRAME_FILLING 1			// Acquired by the producer, not yet published.
+#define FRAME_PUBLISHED 2		// Owned by the consumer, blocks left to submit.
+#define FRAME_WRITING 3			// Owned by the consumer, all blocks submitted, some not yet completed.
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	u8 state;
+	u32 blocksSubmitted;
+	u32 blocksOutstanding;
+} frame_type;
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+u8 * ringBase = 0;
+u32 ringFrames = 0;
+u32 ringFrameSize = 0;
+u32 ringBlockSize = 0;
+u32 ringBlocksPerFrame = 0;
+
+frame_type frames[RING_FRAMES_MAX];
+u32 ringProduceIdx = 0;			// Next frame for the producer.
+u32 ringConsumeIdx = 0;			// Next frame for the consumer.
+u32 ringOccupancy = 0;			// Frames not owned by the producer.
+ringStats_type ringStats;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Set up nFrames buffers of frameSize bytes each, starting at base. frameSize must be a multiple of blockSize.
+int ringInit(u8 * base, u32 nFrames, u32 frameSize, u32 blockSize)
+{
+	if((nFrames == 0) || (nFrames > RING_FRAMES_MAX)) { return RING_BAD_COUNT; }
+	if((blockSize == 0) || (frameSize == 0) || (frameSize % blockSize)) { return RING_BAD_SIZE; }
+
+	ringBase = base;
+	ringFrames = nFrames;
+	ringFrameSize = frameSize;
+	ringBlockSize = blockSize;
+	ringBlocksPerFrame = frameSize / blockSize;
+
+	for(u32 f = 0; f < RING_FRAMES_MAX; f++)
+	{
+		frames[f].state = FRAME_FREE;
+		frames[f].blocksSubmitted = 0;
+		frames[f].blocksOutstanding = 0;
+	}
+	ringProduceIdx = 0;
+	ringConsumeIdx = 0;
+	ringOccupancy = 0;
+
+	ringStats.framesProduced = 0;
+	ringStats.framesDropped = 0;
+	ringStats.framesWritten = 0;
+	ringStats.occupancyMax = 0;
+	for(u32 n = 0; n <= RING_FRAMES_MAX; n++) { ringStats.occupancyHist[n] = 0; }
+
+	return RING_OK;
+}
+
+// Producer: Get the next frame buffer to fill and its index, or NULL if the ring is full (the frame is counted as
+// dropped). Several frames may be acquired before they are published, e.g. to fill them in parallel.
+u8 * ringAcquire(u16 * frame)
+{
+	u8 * buffer;
+
+	frame_type * f = &frames[ringProduceIdx];
+
+	ringStats.occupancyHist[ringOccupancy]++;
+
+	if(f->state != FRAME_FREE)
+	{
+		ringStats.framesDropped++;
+		return 0;
+	}
+
+	f->state = FRAME_FILLING;
+	ringOccupancy++;
+	if(ringOccupancy > ringStats.occupancyMax) { ringStats.occupancyMax = ringOccupancy; }
+
+	buffer = ringBase + (u64)ringProduceIdx * ringFrameSize;
+	*frame = ringProduceIdx;
+	ringProduceIdx = (ringProduceIdx + 1) % ringFrames;
+
+	return buffer;
+}
+
+// Producer: Hand a filled frame from ringAcquire() to the consumer. The consumer still takes frames in ring order.
+void ringPublish(u16 frame)
+{
+	frame_type * f;
+
+	if(frame >= ringFrames) { return; }
+	f = &frames[frame];
+	if(f->state != FRAME_FILLING) { return; }
+
+	f->blocksSubmitted = 0;
+	f->blocksOutstanding = 0;
+	f->state = FRAME_PUBLISHED;
+	ringStats.framesProduced++;
+}
+
+// Consumer: Get the next block to write, or NULL if no published frame has blocks left. The caller must submit the
+// block and call ringRelease() with the returned frame index when the write completes.
+u8 * ringConsume(u16 * frame)
+{
+	frame_type * f = &frames[ringConsumeIdx];
+	u8 * block;
+
+	if(f->state != FRAME_PUBLISHED) { return 0; }
+
+	block = ringBase + (u64)ringConsumeIdx * ringFrameSize + (u64)f->blocksSubmitted * ringBlockSize;
+	*frame = ringConsumeIdx;
+
+	f->blocksSubmitted++;
+	f->blocksOutstanding++;
+	if(f->blocksSubmitted == ringBlocksPerFrame)
+	{
+		f->state = FRAME_WRITING;
+		ringConsumeIdx = (ringConsumeIdx + 1) % ringFrames;
+	}
+
+	return block;
+}
+
+// Consumer: One block write from frame has completed. The frame returns to the producer after its last block.
+void ringRelease(u16 frame)
+{
+	frame_type * f;
+
+	if(frame >= ringFrames) { return; }
+	f = &frames[frame];
+	if(f->blocksOutstanding == 0) { return; }
+
+	f->blocksOutstanding--;
+	if((f->state == FRAME_WRITING) && (f->blocksOutstanding == 0))
+	{
+		f->state = FRAME_FREE;
+		ringOccupancy--;
+		ringStats.framesWritten++;
+	}
+}
+
+u32 ringGetOccupancy(void)
+{
+	return ringOccupancy;
+}
+
+void ringGetStats(ringStats_type * stats)
+{
+	*stats = ringStats;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
@@ -0,0 +1,45 @@
+/*
+Frame Buffer Ring Include
+*/
+
+#ifndef __RING_INCLUDE__
+#define __RING_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+#define RING_FRAMES_MAX 64
+
+// ringInit() Return Values
+#define RING_OK 0
+#define RING_BAD_COUNT 1
+#define RING_BAD_SIZE 2
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Ring Statistics, since ringInit(). Occupancy is sampled each time the producer asks for a frame.
+typedef struct
+{
+	u64 framesProduced;
+	u64 framesDropped;		// Frames that arrived while every buffer was still owned by the consumer.
+	u64 framesWritten;		// Frames whose writes have all completed.
+	u32 occupancyMax;
+	u64 occupancyHist[RING_FRAMES_MAX + 1];
+} ringStats_type;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+int ringInit(u8 * base, u32 nFrames, u32 frameSize, u32 blockSize);
+u8 * ringAcquire(u16 * frame);
+void ringPublish(u16 frame);
+u8 * ringConsume(u16 * frame);
+void ringRelease(u16 frame);
+u32 ringGetOccupancy(void);
+void ringGetStats(ringStats_type * stats);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
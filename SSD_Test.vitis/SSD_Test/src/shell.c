@@ -0,0 +1,288 @@
+/*
+UART Command Shell
+
+Reads command lines from the PS UART and dispatches them to application commands. Built-in commands show and set
+named parameters, sweep a parameter over a range while repeating a command, and print help. Several commands can be
+given on one line separated by ';', so a whole test sequence can be pasted or sent by a host script at once.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "shell.h"
+#include "xuartps.h"
+#include "xil_printf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define SHELL_PROMPT "> "
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void shellReadLine(char * line, u32 lineMax);
+int shellExecuteOne(char * cmd);
+int shellHelp(void);
+int shellShow(void);
+int shellSet(int argc, char ** argv);
+int shellSweep(int argc, char ** argv);
+const shellParam_type * shellFindParam(const char * name);
+int shellParseU32(const char * str, u32 * value);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+const shellCommand_type * shellCommands = NULL;
+u32 shellNumCommands = 0;
+const shellParam_type * shellParams = NULL;
+u32 shellNumParams = 0;
+u32 shellUartBase = 0;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+void shellInit(const shellCommand_type * commands, u32 nCommands, const shellParam_type * params, u32 nParams)
+{
+	shellCommands = commands;
+	shellNumCommands = nCommands;
+	shellParams = params;
+	shellNumParams = nParams;
+	shellUartBase = XUartPs_LookupConfig(XPAR_XUARTPS_0_DEVICE_ID)->BaseAddress;
+}
+
+// Read and execute lines until a command returns SHELL_EXIT.
+void shellRun(void)
+{
+	char line[SHELL_LINE_MAX];
+
+	xil_printf("Type help for a list of commands.\r\n");
+
+	while(1)
+	{
+		xil_printf(SHELL_PROMPT);
+		shellReadLine(line, SHELL_LINE_MAX);
+		if(shellExecute(line) == SHELL_EXIT) { return; }
+	}
+}
+
+// Execute a line of one or more commands separated by ';'. Stops at the first error or exit.
+int shellExecute(char * line)
+{
+	char * cmd = line;
+	char * next;
+	int result = SHELL_OK;
+
+	while(cmd != NULL)
+	{
+		next = strchr(cmd, ';');
+		if(next != NULL) { *next++ = '\0'; }
+
+		result = shellExecuteOne(cmd);
+		if(result != SHELL_OK) { return result; }
+
+		cmd = next;
+	}
+
+	return result;
+}
+
+int shellSetParam(const char * name, u32 value)
+{
+	const shellParam_type * param = shellFindParam(name);
+
+	if(param == NULL) { return SHELL_ERROR; }
+	if((value < param->min) || (value > param->max)) { return SHELL_ERROR; }
+
+	*param->value = value;
+
+	return SHELL_OK;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Blocking line input with echo and backspace.
+void shellReadLine(char * line, u32 lineMax)
+{
+	u32 n = 0;
+	u8 c;
+
+	while(1)
+	{
+		while(!XUartPs_IsReceiveData(shellUartBase));
+		c = XUartPs_RecvByte(shellUartBase);
+
+		if((c == '\r') || (c == '\n'))
+		{
+			xil_printf("\r\n");
+			line[n] = '\0';
+			return;
+		}
+		else if(((c == '\b') || (c == 0x7F)) && (n > 0))
+		{
+			n--;
+			xil_printf("\b \b");
+		}
+		else if((c >= ' ') && (c < 0x7F) && (n < lineMax - 1))
+		{
+			line[n++] = c;
+			XUartPs_SendByte(shellUartBase, c);
+		}
+	}
+}
+
+int shellExecuteOne(char * cmd)
+{
+	char * argv[SHELL_ARGS_MAX];
+	int argc = 0;
+	char * token;
+	int result;
+
+	token = strtok(cmd, " \t");
+	while((token != NULL) && (argc < SHELL_ARGS_MAX))
+	{
+		argv[argc++] = token;
+		token = strtok(NULL, " \t");
+	}
+	if(argc == 0) { return SHELL_OK; }
+
+	if(strcmp(argv[0], "help") == 0) { return shellHelp(); }
+	if(strcmp(argv[0], "show") == 0) { return shellShow(); }
+	if(strcmp(argv[0], "set") == 0) { return shellSet(argc, argv); }
+	if(strcmp(argv[0], "sweep") == 0) { return shellSweep(argc, argv); }
+
+	for(u32 i = 0; i < shellNumCommands; i++)
+	{
+		if(strcmp(argv[0], shellCommands[i].name) == 0)
+		{
+			result = shellCommands[i].handler(argc, argv);
+			if(result == SHELL_ERROR) { xil_printf("Command failed: %s\r\n", argv[0]); }
+			return result;
+		}
+	}
+
+	xil_printf("Unknown command: %s\r\n", argv[0]);
+	return SHELL_ERROR;
+}
+
+int shellHelp(void)
+{
+	char strWorking[SHELL_LINE_MAX];
+
+	xil_printf("help                                  Show this list.\r\n");
+	xil_printf("show                                  Show all parameters.\r\n");
+	xil_printf("set <param> <value>                   Set a parameter.\r\n");
+	xil_printf("sweep <param> <start> <stop> <step> [command]\r\n");
+	xil_printf("                                      Run a command (default: run) for each parameter value.\r\n");
+	for(u32 i = 0; i < shellNumCommands; i++)
+	{
+		sprintf(strWorking, "%-37s %s\r\n", shellCommands[i].name, shellCommands[i].help);
+		xil_printf("%s", strWorking);
+	}
+	xil_printf("Separate commands with ; to run them in sequence.\r\n");
+
+	return SHELL_OK;
+}
+
+int shellShow(void)
+{
+	char strWorking[SHELL_LINE_MAX];
+
+	for(u32 i = 0; i < shellNumParams; i++)
+	{
+		sprintf(strWorking, "%-20s %12u   %s\r\n", shellParams[i].name, *shellParams[i].value, shellParams[i].help);
+		xil_printf("%s", strWorking);
+	}
+
+	return SHELL_OK;
+}
+
+int shellSet(int argc, char ** argv)
+{
+	char strWorking[SHELL_LINE_MAX];
+	const shellParam_type * param;
+	u32 value;
+
+	if(argc != 3) { xil_printf("Usage: set <param> <value>\r\n"); return SHELL_ERROR; }
+
+	param = shellFindParam(argv[1]);
+	if(param == NULL) { xil_printf("Unknown parameter: %s\r\n", argv[1]); return SHELL_ERROR; }
+
+	if(shellParseU32(argv[2], &value) || (shellSetParam(argv[1], value) != SHELL_OK))
+	{
+		sprintf(strWorking, "%s must be in [%u, %u].\r\n", param->name, param->min, param->max);
+		xil_printf("%s", strWorking);
+		return SHELL_ERROR;
+	}
+
+	return SHELL_OK;
+}
+
+int shellSweep(int argc, char ** argv)
+{
+	char strWorking[SHELL_LINE_MAX];
+	const shellParam_type * param;
+	u32 start, stop, step, value, valuePrev;
+	char cmd[SHELL_LINE_MAX];
+	int result;
+
+	if((argc < 5) || (argc > 6)) { xil_printf("Usage: sweep <param> <start> <stop> <step> [command]\r\n"); return SHELL_ERROR; }
+
+	param = shellFindParam(argv[1]);
+	if(param == NULL) { xil_printf("Unknown parameter: %s\r\n", argv[1]); return SHELL_ERROR; }
+	if(shellParseU32(argv[2], &start) || shellParseU32(argv[3], &stop) || shellParseU32(argv[4], &step) || (step == 0))
+	{
+		xil_printf("Bad sweep range.\r\n");
+		return SHELL_ERROR;
+	}
+
+	valuePrev = *param->value;
+	for(value = start; value <= stop; value += step)
+	{
+		if(shellSetParam(param->name, value) != SHELL_OK)
+		{
+			sprintf(strWorking, "%s must be in [%u, %u].\r\n", param->name, param->min, param->max);
+			xil_printf("%s", strWorking);
+			break;
+		}
+		sprintf(strWorking, "Sweep: %s = %u\r\n", param->name, value);
+		xil_printf("%s", strWorking);
+
+		// The command line is tokenized in place, so give each pass its own copy.
+		strncpy(cmd, (argc == 6) ? argv[5] : "run", SHELL_LINE_MAX - 1);
+		cmd[SHELL_LINE_MAX - 1] = '\0';
+		result = shellExecuteOne(cmd);
+		if(result != SHELL_OK) { *param->value = valuePrev; return result; }
+
+		if(value > stop - step) { break; }	// Don't wrap around at the top of the u32 range.
+	}
+	*param->value = valuePrev;
+
+	return SHELL_OK;
+}
+
+const shellParam_type * shellFindParam(const char * name)
+{
+	for(u32 i = 0; i < shellNumParams; i++)
+	{
+		if(strcmp(name, shellParams[i].name) == 0) { return &shellParams[i]; }
+	}
+
+	return NULL;
+}
+
+// Decimal or 0x-prefixed hexadecimal. Returns 0 on success.
+int shellParseU32(const char * str, u32 * value)
+{
+	char * end;
+	unsigned long v = strtoul(str, &end, 0);
+
+	if((end == str) || (*end != '\0') || (v > 0xFFFFFFFFUL)) { return 1; }
+	*value = (u32) v;
+
+	return 0;
+}
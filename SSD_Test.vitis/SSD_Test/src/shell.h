@@ -0,0 +1,50 @@
+/*
+UART Command Shell Include
+*/
+
+#ifndef __SHELL_INCLUDE__
+#define __SHELL_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+#define SHELL_LINE_MAX    256
+#define SHELL_ARGS_MAX     8
+
+#define SHELL_OK           0
+#define SHELL_EXIT         1
+#define SHELL_ERROR        2
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Runtime-adjustable parameter, shown and set by name.
+typedef struct
+{
+	const char * name;
+	u32 * value;
+	u32 min;
+	u32 max;
+	const char * help;
+} shellParam_type;
+
+// Command handler, called with the command name as argv[0]. Returns SHELL_OK, SHELL_EXIT or SHELL_ERROR.
+typedef struct
+{
+	const char * name;
+	int (*handler)(int argc, char ** argv);
+	const char * help;
+} shellCommand_type;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+void shellInit(const shellCommand_type * commands, u32 nCommands, const shellParam_type * params, u32 nParams);
+void shellRun(void);
+int shellExecute(char * line);
+int shellSetParam(const char * name, u32 value);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,125 @@
+/*
+SLC Cache and Garbage Collection Analysis
+
+Finds the transitions in a series of per-interval write rates: the burst level while writes land in the SLC cache,
+the cliff where the cache runs out, and later step changes such as garbage collection starting or stopping. All of
+the detectors compare means over settle samples, so that single-interval hiccups aren't mistaken for transitions.
+The first sample is skipped when finding the burst level, since it includes the queue filling up.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "slc.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Mean of rate[from, to). 0 if empty.
+float slcMean(const float * rate, u32 from, u32 to)
+{
+	float sum = 0.0f;
+
+	if(to <= from) { return 0.0f; }
+	for(u32 i = from; i < to; i++) { sum += rate[i]; }
+
+	return sum / (float)(to - from);
+}
+
+// Rate while writes land in the SLC cache: the mean of the settle samples after the first.
+float slcBurstLevel(const float * rate, u32 n, u32 settle)
+{
+	u32 to = 1 + settle;
+
+	if(n < 2) { return (n == 1) ? rate[0] : 0.0f; }
+	if(to > n) { to = n; }
+
+	return slcMean(rate, 1, to);
+}
+
+// First sample at or after from where the mean of the next settle samples falls below fraction of the burst level.
+// Returns n if there is no cliff yet. An online search can resume from n - settle of the previous call.
+u32 slcFindCliff(const float * rate, u32 n, float fraction, u32 settle, u32 from)
+{
+	float limit;
+	float sum = 0.0f;
+
+	if(settle == 0) { settle = 1; }
+	if(from < 1 + settle) { from = 1 + settle; }
+	if(from + settle > n) { return n; }
+
+	limit = fraction * slcBurstLevel(rate, n, settle) * (float)settle;
+
+	// Sliding sum over [i, i + settle).
+	for(u32 i = from; i < from + settle; i++) { sum += rate[i]; }
+	for(u32 i = from; ; i++)
+	{
+		if(sum < limit)
+		{
+			// Place the cliff at the first low sample in the window.
+			for(u32 j = i; j < i + settle; j++)
+			{
+				if(rate[j] * (float)settle < limit) { return j; }
+			}
+			return i;
+		}
+		if(i + settle >= n) { break; }
+		sum += rate[i + settle] - rate[i];
+	}
+
+	return n;
+}
+
+// Step changes of more than threshold (as a fraction of the earlier level) between the settle samples before and
+// after a sample. Adjacent candidates are merged, keeping the largest step. Returns the number found, up to max.
+u32 slcFindTransitions(const float * rate, u32 n, float threshold, u32 settle, slcTransition_type * transitions, u32 max)
+{
+	u32 nFound = 0;
+	float before, after, step, stepBest = 0.0f;
+	slcTransition_type best = { 0, 0.0f, 0.0f };
+	u8 inStep = 0;
+
+	if(settle == 0) { settle = 1; }
+	if(n < 2 * settle) { return 0; }
+
+	for(u32 i = settle; i + settle <= n; i++)
+	{
+		before = slcMean(rate, i - settle, i);
+		after = slcMean(rate, i, i + settle);
+		step = (before > 0.0f) ? (after - before) / before : 0.0f;
+		if(step < 0.0f) { step = -step; }
+
+		if(step > threshold)
+		{
+			if(!inStep || (step > stepBest))
+			{
+				best.index = i;
+				best.before = before;
+				best.after = after;
+				stepBest = step;
+			}
+			inStep = 1;
+		}
+		else if(inStep)
+		{
+			if(nFound < max) { transitions[nFound++] = best; }
+			inStep = 0;
+			stepBest = 0.0f;
+		}
+	}
+	if(inStep && (nFound < max)) { transitions[nFound++] = best; }
+
+	return nFound;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
@@ -0,0 +1,33 @@
+/*
+SLC Cache and Garbage Collection Analysis Include
+*/
+
+#ifndef __SLC_INCLUDE__
+#define __SLC_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Step Change in a Rate Series
+typedef struct
+{
+	u32 index;					// First sample at the new level.
+	float before;				// Mean rate over the settle samples before the step.
+	float after;				// Mean rate over the settle samples from the step on.
+} slcTransition_type;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+float slcMean(const float * rate, u32 from, u32 to);
+float slcBurstLevel(const float * rate, u32 n, u32 settle);
+u32 slcFindCliff(const float * rate, u32 n, float fraction, u32 settle, u32 from);
+u32 slcFindTransitions(const float * rate, u32 n, float threshold, u32 settle, slcTransition_type * transitions, u32 max);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
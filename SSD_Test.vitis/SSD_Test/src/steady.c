@@ -0,0 +1,71 @@
+/*
+Steady-State Detection
+
+SNIA SSS PTS style steady-state check over a window of measurement rounds: the tracked variable is steady when its
+range across the window is within maxExcursion of the window average, and the least-squares line through the window
+changes by no more than maxSlopeExcursion of the average from the first round to the last (typically 20% and 10%).
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "steady.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Check n values (the measurement window, oldest first). Returns 1 if steady. result may be NULL.
+u8 steadyCheck(const float * values, u32 n, float maxExcursion, float maxSlopeExcursion, steadyResult_type * result)
+{
+	float sum = 0.0f, min, max, average;
+	float xMean, sxx = 0.0f, sxy = 0.0f, slope;
+	steadyResult_type r = { 0.0f, 0.0f, 0.0f, 0 };
+
+	if(n < 2)
+	{
+		if(result) { *result = r; }
+		return 0;
+	}
+
+	min = values[0];
+	max = values[0];
+	for(u32 i = 0; i < n; i++)
+	{
+		sum += values[i];
+		if(values[i] < min) { min = values[i]; }
+		if(values[i] > max) { max = values[i]; }
+	}
+	average = sum / (float)n;
+
+	// Least-squares slope per round.
+	xMean = (float)(n - 1) * 0.5f;
+	for(u32 i = 0; i < n; i++)
+	{
+		sxx += ((float)i - xMean) * ((float)i - xMean);
+		sxy += ((float)i - xMean) * (values[i] - average);
+	}
+	slope = sxy / sxx;
+
+	r.average = average;
+	if(average > 0.0f)
+	{
+		r.excursion = (max - min) / average;
+		r.slopeExcursion = ((slope < 0.0f) ? -slope : slope) * (float)(n - 1) / average;
+		r.steady = (r.excursion <= maxExcursion) && (r.slopeExcursion <= maxSlopeExcursion);
+	}
+
+	if(result) { *result = r; }
+	return r.steady;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
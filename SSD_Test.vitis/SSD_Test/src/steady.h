@@ -0,0 +1,31 @@
+/*
+Steady-State Detection Include
+*/
+
+#ifndef __STEADY_INCLUDE__
+#define __STEADY_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Measurement Window Results
+typedef struct
+{
+	float average;
+	float excursion;			// (max - min) across the window, as a fraction of the average.
+	float slopeExcursion;		// Change of the least-squares line across the window, as a fraction of the average.
+	u8 steady;					// Both excursions within their limits.
+} steadyResult_type;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+u8 steadyCheck(const float * values, u32 n, float maxExcursion, float maxSlopeExcursion, steadyResult_type * result);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
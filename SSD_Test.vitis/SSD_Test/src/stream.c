@@ -0,0 +1,230 @@
+/*
+Streaming File Writer
+
+Preallocates a file as one contiguous run of clusters (f_expand) and writes it with nvmeWrite() straight into that LBA
+extent, at whatever queue depth the caller keeps, instead of through f_write(). FatFs is only involved at open and
+close. streamClose() waits for the file's own data writes to complete, then trims the file to the LBAs written and writes its
+directory entry, so the result is an ordinary contiguous exFAT file.
+
+Rolling capture strings numbered streaming files together. The next file is created and preallocated, and the previous
+one closed, in idle time the caller gives to streamRollIdle() (e.g. while pacing), so a roll from one file to the next
+only switches extents. If no idle time came since the last roll, the roll does the work inline.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "stream.h"
+#include "nvme.h"
+#include <stdio.h>
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+u8 streamReap(streamFile_type * sf);
+int streamRollCreateNext(streamRoll_type * sr);
+int streamRollClosePrev(streamRoll_type * sr);
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Create (or replace) a file with up to sizeMax bytes of contiguous space, rounded up to whole clusters.
+int streamOpen(streamFile_type * sf, const char * path, u64 sizeMax)
+{
+	LBA_t sect, nsect;
+	FRESULT res;
+
+	sf->lbaSize = nvmeGetLBASize();
+	sf->lbaWritten = 0;
+	sf->nPending = 0;
+
+	if(f_open(&sf->fil, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) { return STREAM_ERROR_OPEN; }
+
+	res = f_expand(&sf->fil, (FSIZE_t) sizeMax, 1);
+	if(res == FR_OK) { res = f_extent(&sf->fil, &sect, &nsect); }
+	if(res != FR_OK)
+	{
+		f_close(&sf->fil);
+		f_unlink(path);
+		return (res == FR_DENIED) ? STREAM_ERROR_NO_SPACE : STREAM_ERROR_IO;
+	}
+
+	sf->lbaStart = sect;
+	sf->lbaCount = nsect;
+
+	return STREAM_OK;
+}
+
+// Submit the next numLBA LBAs of the file. Doesn't wait for completion: the caller manages the I/O slip as usual.
+int streamWrite(streamFile_type * sf, const u8 * srcByte, u32 numLBA)
+{
+	u16 cid;
+
+	if(sf->lbaWritten + numLBA > sf->lbaCount) { return STREAM_ERROR_FULL; }
+
+	// Fewer than STREAM_PENDING_MAX commands can be in flight, so dropping the completed ones always makes room.
+	if(sf->nPending == STREAM_PENDING_MAX) { streamReap(sf); }
+
+	if(nvmeWriteCID(srcByte, sf->lbaStart + sf->lbaWritten, numLBA, &cid) != NVME_RW_OK) { return STREAM_ERROR_IO; }
+	sf->cidPending[sf->nPending++] = cid;
+	sf->lbaWritten += numLBA;
+
+	return STREAM_OK;
+}
+
+// LBA the next streamWrite() goes to, e.g. for callers that submit the commands themselves.
+u64 streamGetNextLBA(const streamFile_type * sf)
+{
+	return sf->lbaStart + sf->lbaWritten;
+}
+
+// Wait for the data, then set the file size to the LBAs written, free the rest of the extent, and close the file. Only
+// this file's writes are waited for: in rolling capture, the next file's stay in flight. On an error the file is left
+// open, so that the close can be retried.
+int streamClose(streamFile_type * sf)
+{
+	FRESULT res;
+
+	while(streamReap(sf) > 0)
+	{
+		nvmeServiceIOCompletions(16);
+	}
+
+	// The data doesn't go through the FIL, so an error it holds is from an earlier attempt to close it.
+	sf->fil.err = 0;
+	res = f_lseek(&sf->fil, (FSIZE_t)(sf->lbaWritten * sf->lbaSize));
+	if(res == FR_OK) { res = f_truncate(&sf->fil); }
+	if(res == FR_OK) { res = f_close(&sf->fil); }
+
+	return (res == FR_OK) ? STREAM_OK : STREAM_ERROR_IO;
+}
+
+// Start a rolling capture with file 0. pathFormat turns a file number into a path, e.g. "f%06u.bin".
+int streamRollOpen(streamRoll_type * sr, const char * pathFormat, u64 sizeMax)
+{
+	char path[STREAM_PATH_MAX];
+
+	sr->cur = 0;
+	sr->nextReady = 0;
+	sr->prevOpen = 0;
+	sr->nFile = 0;
+	sr->sizeMax = sizeMax;
+	sr->pathFormat = pathFormat;
+	sr->rolls = 0;
+	sr->rollsWaited = 0;
+	sr->idleStatus = STREAM_OK;
+
+	snprintf(path, STREAM_PATH_MAX, pathFormat, sr->nFile);
+	return streamOpen(&sr->file[sr->cur], path, sizeMax);
+}
+
+// Submit the next numLBA LBAs, rolling to the next file first if they don't fit in the current one.
+int streamRollWrite(streamRoll_type * sr, const u8 * srcByte, u32 numLBA)
+{
+	streamFile_type * sf = &sr->file[sr->cur];
+	int status;
+
+	if((sf->lbaWritten + numLBA) * sf->lbaSize > sr->sizeMax)
+	{
+		// Catch up on whatever idle time didn't get to.
+		if(sr->prevOpen || !sr->nextReady) { sr->rollsWaited++; }
+		status = streamRollClosePrev(sr);
+		if(status == STREAM_OK) { status = streamRollCreateNext(sr); }
+		if(status != STREAM_OK) { return status; }
+		sr->idleStatus = STREAM_OK;
+
+		// The full file is finished later.
+		sr->cur ^= 1;
+		sr->nFile++;
+		sr->nextReady = 0;
+		sr->prevOpen = 1;
+		sr->rolls++;
+		sf = &sr->file[sr->cur];
+	}
+
+	return streamWrite(sf, srcByte, numLBA);
+}
+
+// Use idle time: finish the previous file once its writes have completed, then create the next one. Does at most one
+// of them per call, and doesn't wait for writes.
+void streamRollIdle(streamRoll_type * sr)
+{
+	if(sr->idleStatus != STREAM_OK) { return; }
+
+	if(sr->prevOpen)
+	{
+		if(streamReap(&sr->file[sr->cur ^ 1]) == 0) { sr->idleStatus = streamRollClosePrev(sr); }
+	}
+	else if(!sr->nextReady) { sr->idleStatus = streamRollCreateNext(sr); }
+}
+
+// Finish the previous and current files, and remove the next one if it was created ahead.
+int streamRollClose(streamRoll_type * sr)
+{
+	char path[STREAM_PATH_MAX];
+	int status;
+
+	status = streamRollClosePrev(sr);
+	status |= streamClose(&sr->file[sr->cur]);
+
+	if(sr->nextReady)
+	{
+		f_close(&sr->file[sr->cur ^ 1].fil);
+		snprintf(path, STREAM_PATH_MAX, sr->pathFormat, sr->nFile + 1);
+		f_unlink(path);
+		sr->nextReady = 0;
+	}
+
+	return status;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Drop the file's writes that have completed from its pending list. Returns the number still in flight.
+u8 streamReap(streamFile_type * sf)
+{
+	u8 n = 0;
+
+	for(u8 i = 0; i < sf->nPending; i++)
+	{
+		if(nvmeIsIOPending(sf->cidPending[i])) { sf->cidPending[n++] = sf->cidPending[i]; }
+	}
+	sf->nPending = n;
+
+	return n;
+}
+
+// Rolling Capture: Create and preallocate the next file in the spare slot, if not done yet.
+int streamRollCreateNext(streamRoll_type * sr)
+{
+	char path[STREAM_PATH_MAX];
+	int status;
+
+	if(sr->nextReady || sr->prevOpen) { return STREAM_OK; }
+
+	snprintf(path, STREAM_PATH_MAX, sr->pathFormat, sr->nFile + 1);
+	status = streamOpen(&sr->file[sr->cur ^ 1], path, sr->sizeMax);
+	if(status == STREAM_OK) { sr->nextReady = 1; }
+
+	return status;
+}
+
+// Rolling Capture: Close the previous file in the spare slot, if it is still open. It stays open if that fails.
+int streamRollClosePrev(streamRoll_type * sr)
+{
+	int status;
+
+	if(!sr->prevOpen) { return STREAM_OK; }
+
+	status = streamClose(&sr->file[sr->cur ^ 1]);
+	if(status == STREAM_OK) { sr->prevOpen = 0; }
+
+	return status;
+}
@@ -0,0 +1,67 @@
+/*
+Streaming File Writer Include
+*/
+
+#ifndef __STREAM_INCLUDE__
+#define __STREAM_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+#include "ff.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// Return Values
+#define STREAM_OK 0
+#define STREAM_ERROR_OPEN 1			// File couldn't be created.
+#define STREAM_ERROR_NO_SPACE 2		// No contiguous run of free clusters large enough.
+#define STREAM_ERROR_FULL 4			// Write past the end of the preallocated extent.
+#define STREAM_ERROR_IO 8			// NVMe submission or FatFs metadata error.
+
+#define STREAM_PATH_MAX 32			// Longest rolling capture file path, including the terminator.
+#define STREAM_PENDING_MAX 64		// Writes tracked per file. More than the NVMe driver keeps in flight.
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Streaming File, from streamOpen() to streamClose().
+typedef struct
+{
+	FIL fil;
+	u64 lbaStart;				// First LBA of the preallocated extent.
+	u64 lbaCount;				// LBAs preallocated.
+	u64 lbaWritten;				// LBAs submitted, in order from lbaStart.
+	u32 lbaSize;
+	u16 cidPending[STREAM_PENDING_MAX];	// CIDs of the file's writes that may still be in flight.
+	u8 nPending;
+} streamFile_type;
+
+// Rolling Capture: Numbered streaming files of sizeMax bytes each, from streamRollOpen() to streamRollClose().
+typedef struct
+{
+	streamFile_type file[2];	// The file being written, and the next one or the previous one.
+	u8 cur;						// Index of the file being written.
+	u8 nextReady;				// file[cur ^ 1] is created and preallocated for the next roll.
+	u8 prevOpen;				// file[cur ^ 1] is full, its directory entry still to be written.
+	u32 nFile;					// Number of the file being written.
+	u64 sizeMax;
+	const char * pathFormat;	// sprintf() format of a file path from its number.
+	u32 rolls;
+	u32 rollsWaited;			// Rolls that had to create the next file or finish the previous one inline.
+	int idleStatus;				// First error in idle time. Idle work stops there until the next roll retries inline.
+} streamRoll_type;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+int streamOpen(streamFile_type * sf, const char * path, u64 sizeMax);
+int streamWrite(streamFile_type * sf, const u8 * srcByte, u32 numLBA);
+u64 streamGetNextLBA(const streamFile_type * sf);
+int streamClose(streamFile_type * sf);
+int streamRollOpen(streamRoll_type * sr, const char * pathFormat, u64 sizeMax);
+int streamRollWrite(streamRoll_type * sr, const u8 * srcByte, u32 numLBA);
+void streamRollIdle(streamRoll_type * sr);
+int streamRollClose(streamRoll_type * sr);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
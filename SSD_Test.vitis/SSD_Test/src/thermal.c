@@ -0,0 +1,124 @@
+/*
+Thermal Throughput Governor
+
+Paces I/O to hold the SSD composite temperature a margin below its Warning Composite Temperature Threshold (WCTEMP),
+so that sustained throughput degrades smoothly instead of hitting the controller's own thermal throttling.
+thermalGovern() is called at a fixed interval (1Hz) from the test loop. Each call uses the SMART / Health sample
+requested on the previous call and requests the next one without waiting, so the I/O stream is never stalled.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "thermal.h"
+#include "nvme.h"
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define THERMAL_WARNING_DEFAULT   70.0f     // Assumed WCTEMP in [degC] if the controller doesn't report one.
+#define THERMAL_MARGIN             5.0f     // Target temperature below WCTEMP in [degC].
+#define THERMAL_HCTM_MARGIN        2.0f     // HCTM TMT1 below WCTEMP in [degC], if enabled.
+#define THERMAL_GAIN              0.02f     // Fractional rate limit change per [degC] error per update.
+#define THERMAL_STEP_MIN          0.80f     // Largest fractional decrease per update.
+#define THERMAL_STEP_MAX          1.10f     // Largest fractional increase per update.
+#define THERMAL_RATE_MIN          0.10f     // Lowest rate limit as a fraction of the maximum.
+#define THERMAL_TMT_CUT           0.90f     // Extra cut if the controller started throttling on its own.
+#define THERMAL_FILTER            0.70f     // Temperature filter coefficient per update.
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+// Public Global Variables ---------------------------------------------------------------------------------------------
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+float thermalRateMax = 0.0f;
+float thermalRateLimit = 0.0f;
+float thermalTarget = THERMAL_WARNING_DEFAULT - THERMAL_MARGIN;
+float thermalTf = -100.0f;
+u32 thermalTMTCountPrev = 0;
+
+// Interrupt Handlers --------------------------------------------------------------------------------------------------
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+// Start the governor with the unthrottled rate limit in [MB/s]. Optionally also program Host Controlled Thermal
+// Management so that the controller's light throttling starts just below WCTEMP, as a backstop.
+void thermalInit(float rateMax, u8 useHCTM)
+{
+	nvmeThermal_type thermal;
+	float tWarning;
+
+	nvmeGetThermal(&thermal);
+	tWarning = (thermal.tWarning > 0.0f) ? thermal.tWarning : THERMAL_WARNING_DEFAULT;
+
+	thermalRateMax = rateMax;
+	thermalRateLimit = rateMax;
+	thermalTarget = tWarning - THERMAL_MARGIN;
+	thermalTf = -100.0f;
+	thermalTMTCountPrev = thermal.tmt1Count + thermal.tmt2Count;
+
+	if(useHCTM && thermal.hctmSupported)
+	{
+		nvmeSetThermalManagement(tWarning - THERMAL_HCTM_MARGIN, tWarning);
+	}
+
+	nvmeGetMetrics();
+}
+
+// Update the rate limit from the latest temperature sample and the rate measured over the last interval in [MB/s].
+// Returns the new rate limit in [MB/s].
+float thermalGovern(float rateMeasured)
+{
+	nvmeThermal_type thermal;
+	float error, step;
+	u32 tmtCount;
+
+	nvmeGetThermal(&thermal);
+	nvmeGetMetrics();
+
+	// No sample yet.
+	if(thermal.tComposite < -200.0f) { return thermalRateLimit; }
+
+	if(thermalTf == -100.0f)
+	{
+		thermalTf = thermal.tComposite;
+	}
+	else
+	{
+		thermalTf = THERMAL_FILTER * thermalTf + (1.0f - THERMAL_FILTER) * thermal.tComposite;
+	}
+
+	// When too hot, start from what the drive is actually doing so that the limit binds right away.
+	error = thermalTarget - thermalTf;
+	if((error < 0.0f) && (rateMeasured > 0.0f) && (thermalRateLimit > rateMeasured))
+	{
+		thermalRateLimit = rateMeasured;
+	}
+
+	step = 1.0f + THERMAL_GAIN * error;
+	if(step < THERMAL_STEP_MIN) { step = THERMAL_STEP_MIN; }
+	if(step > THERMAL_STEP_MAX) { step = THERMAL_STEP_MAX; }
+	thermalRateLimit *= step;
+
+	// The controller entered thermal management on its own, so back off further.
+	tmtCount = thermal.tmt1Count + thermal.tmt2Count;
+	if(tmtCount != thermalTMTCountPrev)
+	{
+		thermalRateLimit *= THERMAL_TMT_CUT;
+		thermalTMTCountPrev = tmtCount;
+	}
+
+	if(thermalRateLimit < THERMAL_RATE_MIN * thermalRateMax) { thermalRateLimit = THERMAL_RATE_MIN * thermalRateMax; }
+	if(thermalRateLimit > thermalRateMax) { thermalRateLimit = thermalRateMax; }
+
+	return thermalRateLimit;
+}
+
+// Filtered composite temperature in [degC] as of the last update.
+float thermalGetTemp(void)
+{
+	return thermalTf;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
@@ -0,0 +1,24 @@
+/*
+Thermal Throughput Governor Include
+*/
+
+#ifndef __THERMAL_INCLUDE__
+#define __THERMAL_INCLUDE__
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "xil_types.h"
+
+// Public Pre-Processor Definitions ------------------------------------------------------------------------------------
+
+// Public Type Definitions ---------------------------------------------------------------------------------------------
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+void thermalInit(float rateMax, u8 useHCTM);
+float thermalGovern(float rateMeasured);
+float thermalGetTemp(void);
+
+// Externed Public Global Variables ------------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,235 @@
+/*
+exFAT Allocation Bitmap Scan Test (Host)
+
+Checks find_bitmap() in ff.c against a bit-at-a-time reference scan on a RAM disk. The bitmap is filled with random
+runs, random bits and hand-made wrap-around cases, then searched from many start clusters for many run lengths, once
+through the bitmap mirror and once through the sector window and cache. A free run at the end of the volume must not
+join one at the start: the block would run past the last cluster. The original scanner (FF_FAST_BITMAP 0) still joins
+them, so it fails the wrap-around cases.
+
+Build and run from this directory:
+gcc -O2 -Wall -I../src -o ffbitmap_test ffbitmap_test.c ramdisk.c ../src/ffsystem.c ../src/ffunicode.c && ./ffbitmap_test
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "../src/ff.c"		// For the static find_bitmap() and change_bitmap().
+#include <stdio.h>
+#include <stdlib.h>
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define TEST_PATTERNS 100
+#define TEST_SEARCHES 50
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+int testMode(FATFS * fs, int mirror);
+int testApply(FATFS * fs, BYTE * shadow, const BYTE * pattern, DWORD nbit);
+int testSearch(FATFS * fs, const BYTE * shadow, DWORD nbit, DWORD clst, DWORD ncl);
+DWORD refFind(const BYTE * bitmap, DWORD nbit, DWORD clst, DWORD ncl);
+DWORD refScan(const BYTE * bitmap, DWORD from, DWORD to, DWORD ncl);
+void patternRuns(BYTE * pattern, DWORD nbit, DWORD runMax);
+void patternBits(BYTE * pattern, DWORD nbit, UINT pctUsed);
+void patternWrap(BYTE * pattern, DWORD nbit, DWORD freeEnd, DWORD freeStart);
+UINT testRand(void);
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+static FATFS fs;
+static BYTE work[FF_MAX_SS];
+static UINT randState = 1;
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int main(void)
+{
+	MKFS_PARM opt = { FM_EXFAT, 1, 0, 0, 512 };	// 512B clusters for a bitmap of many sectors.
+	int errors = 0;
+
+	if(f_mkfs("", &opt, work, sizeof(work)) != FR_OK) { printf("f_mkfs failed.\n"); return 1; }
+	if(f_mount(&fs, "", 1) != FR_OK) { printf("f_mount failed.\n"); return 1; }
+
+	printf("%u clusters, %u bitmap sectors of %u B.\n", fs.n_fatent - 2,
+			(fs.n_fatent - 2 + SS(&fs) * 8 - 1) / (SS(&fs) * 8), SS(&fs));
+
+	errors += testMode(&fs, 1);
+	errors += testMode(&fs, 0);
+
+	f_mount(0, "", 0);
+
+	printf("%s: %d mismatches.\n", errors ? "FAIL" : "PASS", errors);
+	return errors ? 1 : 0;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Run all patterns through the mirror (if the bitmap fits in it) or through the window.
+int testMode(FATFS * fs, int mirror)
+{
+	DWORD nbit = fs->n_fatent - 2;
+	UINT nsect = (nbit + SS(fs) * 8 - 1) / (SS(fs) * 8);
+	BYTE * shadow = calloc(nsect, SS(fs));
+	BYTE * pattern = calloc(nsect, SS(fs));
+	DWORD runs[] = { 8, 100, 5000 };
+	int errors = 0;
+	UINT n = 0;
+
+	// The shadow starts out as the bitmap on the disk, with the mirror and window written back.
+	if(sync_fs(fs) != FR_OK) { printf("sync_fs failed.\n"); errors = 1; goto done; }
+	if(disk_read(fs->pdrv, shadow, fs->bitbase, nsect) != RES_OK) { printf("disk_read failed.\n"); errors = 1; goto done; }
+
+#if FF_BITMAP_MIRROR
+	if(mirror && !fs->bm_buf) { printf("Bitmap doesn't fit in the mirror, skipped.\n"); goto done; }
+	if(!mirror) { fs->bm_buf = 0; }		// Through the window from here on.
+#else
+	if(mirror) { goto done; }
+#endif
+
+	for(n = 0; n < TEST_PATTERNS; n++)
+	{
+		switch(n % 4)
+		{
+		case 0: patternRuns(pattern, nbit, runs[(n / 4) % 3]); break;
+		case 1: patternBits(pattern, nbit, 50 + testRand() % 50); break;
+		case 2: patternWrap(pattern, nbit, 1 + testRand() % 200, 1 + testRand() % 200); break;
+		default: patternRuns(pattern, nbit, 64 * (1 + testRand() % 64)); break;
+		}
+		if(testApply(fs, shadow, pattern, nbit)) { errors++; break; }
+
+		for(UINT s = 0; s < TEST_SEARCHES; s++)
+		{
+			// Start at the ends and on word boundaries as well as at random.
+			DWORD clst = (s % 4 == 0) ? nbit + 1 - testRand() % 70 : (s % 4 == 1) ? 2 + (testRand() % nbit & ~63)
+					: (s % 4 == 2) ? 2 + testRand() % 70 : 2 + testRand() % nbit;
+			DWORD ncl = (s % 3 == 0) ? 1 + testRand() % 8 : (s % 3 == 1) ? 1 + testRand() % 400 : 1 + testRand() % 20000;
+
+			errors += testSearch(fs, shadow, nbit, clst, ncl);
+		}
+	}
+
+	printf("%s: %u patterns, %d mismatches.\n", mirror ? "Mirror" : "Window", n, errors);
+
+done:
+	free(shadow);
+	free(pattern);
+	return errors;
+}
+
+// Change the bitmap to the pattern, one run of differing bits at a time. Returns 1 on error.
+int testApply(FATFS * fs, BYTE * shadow, const BYTE * pattern, DWORD nbit)
+{
+	DWORD v = 0;
+	DWORD start;
+	int bv;
+
+	while(v < nbit)
+	{
+		bv = (pattern[v / 8] >> (v % 8)) & 1;
+		if(bv == ((shadow[v / 8] >> (v % 8)) & 1)) { v++; continue; }
+
+		for(start = v; v < nbit; v++)
+		{
+			if(((pattern[v / 8] >> (v % 8)) & 1) != bv) { break; }
+			if(((shadow[v / 8] >> (v % 8)) & 1) == bv) { break; }
+			shadow[v / 8] ^= 1 << (v % 8);
+		}
+		if(change_bitmap(fs, start + 2, v - start, bv) != FR_OK)
+		{
+			printf("change_bitmap(%u, %u, %d) failed.\n", start + 2, v - start, bv);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Compare one search with the reference. Returns 1 on a mismatch.
+int testSearch(FATFS * fs, const BYTE * shadow, DWORD nbit, DWORD clst, DWORD ncl)
+{
+	DWORD expect = refFind(shadow, nbit, clst, ncl);
+	DWORD found = find_bitmap(fs, clst, ncl);
+
+	if(found == expect) { return 0; }
+
+	printf("find_bitmap(%u, %u) = %u, expected %u.\n", clst, ncl, found, expect);
+	return 1;
+}
+
+// Reference Scan: From clst to the end of the bitmap, then from the start up to clst, without joining the two.
+DWORD refFind(const BYTE * bitmap, DWORD nbit, DWORD clst, DWORD ncl)
+{
+	DWORD found;
+
+	clst -= 2;
+	if(clst >= nbit) { clst = 0; }
+
+	found = refScan(bitmap, clst, nbit, ncl);
+	if(!found && clst) { found = refScan(bitmap, 0, clst, ncl); }
+
+	return found;
+}
+
+// Reference Scan: First run of ncl free clusters within [from, to), as a cluster number, or 0.
+DWORD refScan(const BYTE * bitmap, DWORD from, DWORD to, DWORD ncl)
+{
+	DWORD scl = from;
+	DWORD ctr = 0;
+
+	for(DWORD v = from; v < to; v++)
+	{
+		if((bitmap[v / 8] >> (v % 8)) & 1) { scl = v + 1; ctr = 0; }
+		else if(++ctr == ncl) { return scl + 2; }
+	}
+
+	return 0;
+}
+
+// Alternating used and free runs of 1 to runMax clusters.
+void patternRuns(BYTE * pattern, DWORD nbit, DWORD runMax)
+{
+	int bv = testRand() & 1;
+	DWORD v = 0;
+	DWORD r;
+
+	while(v < nbit)
+	{
+		for(r = 1 + testRand() % runMax; r && v < nbit; r--, v++)
+		{
+			if(bv) { pattern[v / 8] |= 1 << (v % 8); }
+			else { pattern[v / 8] &= ~(1 << (v % 8)); }
+		}
+		bv ^= 1;
+	}
+}
+
+// Independent random bits, pctUsed % of them in use.
+void patternBits(BYTE * pattern, DWORD nbit, UINT pctUsed)
+{
+	for(DWORD v = 0; v < nbit; v++)
+	{
+		if(testRand() % 100 < pctUsed) { pattern[v / 8] |= 1 << (v % 8); }
+		else { pattern[v / 8] &= ~(1 << (v % 8)); }
+	}
+}
+
+// All in use but freeEnd clusters at the end of the bitmap and freeStart at the start, plus a few short gaps.
+void patternWrap(BYTE * pattern, DWORD nbit, DWORD freeEnd, DWORD freeStart)
+{
+	DWORD v;
+
+	for(v = 0; v < nbit; v++) { pattern[v / 8] |= 1 << (v % 8); }
+	for(v = 0; v < freeStart; v++) { pattern[v / 8] &= ~(1 << (v % 8)); }
+	for(v = nbit - freeEnd; v < nbit; v++) { pattern[v / 8] &= ~(1 << (v % 8)); }
+	for(UINT g = 0; g < 16; g++)
+	{
+		v = testRand() % nbit;
+		pattern[v / 8] &= ~(1 << (v % 8));
+	}
+}
+
+UINT testRand(void)
+{
+	randState = randState * 1103515245 + 12345;
+	return randState >> 8;
+}
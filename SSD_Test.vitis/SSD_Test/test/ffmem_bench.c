@@ -0,0 +1,161 @@
+/*
+FatFs Memory Function Benchmark (Host)
+
+Checks mem_cpy(), mem_set() and mem_cmp() in ff.c against the C library over random sizes and alignments, then times
+them against the original byte loops at the sizes FatFs uses: directory entries, 512B and 4KiB sectors. Build with
+FF_FAST_MEM 0 and 1 in ffconf.h to compare the two builds of ff.c as well.
+-fno-tree-loop-distribute-patterns keeps GCC from turning the byte loops into C library calls, which would time the
+library instead of the loops.
+
+Build and run from this directory:
+gcc -O2 -Wall -fstrict-aliasing -fno-tree-loop-distribute-patterns -I../src -o ffmem_bench ffmem_bench.c ramdisk.c ../src/ffsystem.c ../src/ffunicode.c && ./ffmem_bench
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "../src/ff.c"		// For the static mem_cpy(), mem_set() and mem_cmp().
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define BENCH_CHECKS 200000
+#define BENCH_BYTES 200000000UL		// Bytes moved per size and function.
+#define BENCH_BUF_MAX 8192
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+int benchCheck(void);
+void benchTime(UINT n);
+void byteCpy(void * dst, const void * src, UINT cnt);
+void byteSet(void * dst, int val, UINT cnt);
+int byteCmp(const void * dst, const void * src, UINT cnt);
+double benchNow(void);
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+static BYTE bufA[BENCH_BUF_MAX + 64];
+static BYTE bufB[BENCH_BUF_MAX + 64];
+static BYTE bufC[BENCH_BUF_MAX + 64];
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int main(void)
+{
+	UINT sizes[] = { 32, 512, 4096 };
+	int errors;
+
+	printf("FF_FAST_MEM %d, %s.\n", FF_FAST_MEM, FF_MEM_WORD ? "32-bit words" : "byte loops");
+
+	errors = benchCheck();
+	printf("%s: %d mismatches in %d checks.\n", errors ? "FAIL" : "PASS", errors, BENCH_CHECKS);
+
+	printf("Size [B], Copy [ns/B], Byte Copy, Fill [ns/B], Byte Fill, Compare [ns/B], Byte Compare\n");
+	for(UINT i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) { benchTime(sizes[i]); }
+
+	return errors ? 1 : 0;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Results, and the bytes around them, against the C library. Returns the number of mismatches.
+int benchCheck(void)
+{
+	UINT seed = 1;
+	UINT n, oa, ob, k;
+	int errors = 0;
+	int r, e;
+
+	for(int it = 0; it < BENCH_CHECKS; it++)
+	{
+		seed = seed * 1103515245 + 12345;
+		n = 1 + (seed >> 8) % 600;
+		oa = (seed >> 3) & 7;
+		ob = (seed >> 20) & 7;
+		for(UINT i = 0; i < n + 16; i++) { bufA[i] = (BYTE)(i * 7 + it); bufB[i] = (BYTE)(i * 3); }
+
+		memcpy(bufC, bufB, n + 16);
+		mem_cpy(bufC + ob, bufA + oa, n);
+		if(memcmp(bufC + ob, bufA + oa, n) || memcmp(bufC, bufB, ob) || memcmp(bufC + ob + n, bufB + ob + n, 8)) { errors++; }
+
+		memcpy(bufC, bufB, n + 16);
+		mem_set(bufC + ob, it & 0xFF, n);
+		for(UINT i = 0; i < n; i++) { if(bufC[ob + i] != (BYTE) it) { errors++; break; } }
+		if(memcmp(bufC, bufB, ob) || memcmp(bufC + ob + n, bufB + ob + n, 8)) { errors++; }
+
+		// Equal, then different in one byte: the result is the difference of the first differing bytes.
+		memcpy(bufC + ob, bufA + oa, n);
+		if(mem_cmp(bufC + ob, bufA + oa, n) != 0) { errors++; }
+		k = (seed >> 12) % n;
+		bufC[ob + k] ^= 0x5A;
+		r = mem_cmp(bufC + ob, bufA + oa, n);
+		e = (int) bufC[ob + k] - (int) bufA[oa + k];
+		if(r != e) { errors++; }
+	}
+
+	return errors;
+}
+
+// One line of ns per byte for each function and its byte loop.
+void benchTime(UINT n)
+{
+	long reps = BENCH_BYTES / n;
+	double t[7];
+	volatile int sink = 0;
+
+	memcpy(bufC, bufA, n);
+	t[0] = benchNow();
+	for(long r = 0; r < reps; r++) { mem_cpy(bufC, bufA, n); __asm__ volatile("" : : "r" (bufC) : "memory"); }
+	t[1] = benchNow();
+	for(long r = 0; r < reps; r++) { byteCpy(bufC, bufA, n); __asm__ volatile("" : : "r" (bufC) : "memory"); }
+	t[2] = benchNow();
+	for(long r = 0; r < reps; r++) { mem_set(bufC, (int) r, n); __asm__ volatile("" : : "r" (bufC) : "memory"); }
+	t[3] = benchNow();
+	for(long r = 0; r < reps; r++) { byteSet(bufC, (int) r, n); __asm__ volatile("" : : "r" (bufC) : "memory"); }
+	t[4] = benchNow();
+	memcpy(bufC, bufA, n);
+	for(long r = 0; r < reps; r++) { sink += mem_cmp(bufC, bufA, n); __asm__ volatile("" : : "r" (bufC) : "memory"); }
+	t[5] = benchNow();
+	for(long r = 0; r < reps; r++) { sink += byteCmp(bufC, bufA, n); __asm__ volatile("" : : "r" (bufC) : "memory"); }
+	t[6] = benchNow();
+
+	printf("%8u", n);
+	for(int i = 0; i < 6; i++) { printf(",%10.3f", (t[i + 1] - t[i]) * 1e9 / ((double) reps * n)); }
+	printf("\n");
+}
+
+// The original FatFs byte loops, kept out of line like the functions they are compared with.
+__attribute__((noinline)) void byteCpy(void * dst, const void * src, UINT cnt)
+{
+	BYTE * d = (BYTE *) dst;
+	const BYTE * s = (const BYTE *) src;
+
+	if(cnt != 0) { do { *d++ = *s++; } while(--cnt); }
+}
+
+__attribute__((noinline)) void byteSet(void * dst, int val, UINT cnt)
+{
+	BYTE * d = (BYTE *) dst;
+
+	do { *d++ = (BYTE) val; } while(--cnt);
+}
+
+__attribute__((noinline)) int byteCmp(const void * dst, const void * src, UINT cnt)
+{
+	const BYTE * d = (const BYTE *) dst;
+	const BYTE * s = (const BYTE *) src;
+	int r = 0;
+
+	do { r = *d++ - *s++; } while(--cnt && r == 0);
+
+	return r;
+}
+
+double benchNow(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
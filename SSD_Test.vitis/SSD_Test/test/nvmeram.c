@@ -0,0 +1,176 @@
+/*
+Host RAM NVMe Drive
+
+The part of nvme.h that diskio.c uses, over NVMERAM_LBAS LBAs of NVMERAM_LBA_SIZE bytes in memory, so that diskio.c
+can be tested on a PC. Reads and writes are queued and take effect when nvmeServiceIOCompletions() completes them, in
+random order. nvmeRamFailRead() makes the next read of an LBA fail.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "nvme.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#ifndef NVMERAM_LBA_SIZE
+#define NVMERAM_LBA_SIZE 512
+#endif
+
+#ifndef NVMERAM_LBAS
+#define NVMERAM_LBAS (128UL << 10)		// 64MiB with 512B LBAs.
+#endif
+
+#ifndef NVMERAM_MAX_TRANSFER
+#define NVMERAM_MAX_TRANSFER (64 << 10)
+#endif
+
+// Private Type Definitions --------------------------------------------------------------------------------------------
+
+typedef struct
+{
+	u8 opc;					// 0x00: Flush, 0x01: Write, 0x02: Read
+	u8 * buffer;
+	u64 lba;
+	u32 numLBA;
+	u16 cid;
+} nvmeRamCommand_type;
+
+// Public Function Prototypes ------------------------------------------------------------------------------------------
+
+void nvmeRamFailRead(u64 lba);
+u32 nvmeRamFailures(void);
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+int nvmeRamSubmit(u8 opc, u8 * buffer, u64 lba, u32 numLBA, u16 * cid);
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+static u8 nvmeRam[NVMERAM_LBAS * NVMERAM_LBA_SIZE];
+static nvmeRamCommand_type nvmeRamPending[NVME_IO_QUEUE_DEPTH];
+static u16 nvmeRamCount = 0;
+static u64 nvmeRamSlotFree = ~0ULL;				// Same CID scheme as the driver: unique modulo NVME_IO_SLOTS in flight.
+static u16 nvmeRamSlotGen[NVME_IO_SLOTS];
+static nvmeCompletionHook_type nvmeRamHook[NVME_COMPLETION_HOOKS_MAX];
+static u8 nvmeRamHooks = 0;
+static u64 nvmeRamFailLBA = ~0ULL;
+static u32 nvmeRamFailed = 0;
+static u8 nvmeRamSQ = NVME_IOSQ_BULK;
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int nvmeInit(void) { return NVME_OK; }
+int nvmeGetStatus(void) { return NVME_OK; }
+u64 nvmeGetLBACount(void) { return NVMERAM_LBAS; }
+u16 nvmeGetLBASize(void) { return NVMERAM_LBA_SIZE; }
+u32 nvmeGetMaxTransferSize(void) { return NVMERAM_MAX_TRANSFER; }
+u16 nvmeGetIOSlip(void) { return nvmeRamCount; }
+int nvmeSelectIOQueue(u8 sq) { nvmeRamSQ = sq; return 0; }
+u8 nvmeGetIOQueue(void) { return nvmeRamSQ; }
+
+int nvmeWriteCID(const u8 * srcByte, u64 destLBA, u32 numLBA, u16 * cid)
+{
+	return nvmeRamSubmit(0x01, (u8 *) srcByte, destLBA, numLBA, cid);
+}
+
+int nvmeReadCID(u8 * destByte, u64 srcLBA, u32 numLBA, u16 * cid)
+{
+	return nvmeRamSubmit(0x02, destByte, srcLBA, numLBA, cid);
+}
+
+int nvmeFlush()
+{
+	u16 cid;
+
+	return nvmeRamSubmit(0x00, NULL, 0, 0, &cid);
+}
+
+// Complete up to maxCompletions commands, picked at random.
+int nvmeServiceIOCompletions(u16 maxCompletions)
+{
+	nvmeRamCommand_type c;
+	nvmeCompletion_type completion;
+	u16 n = 0;
+	u16 i;
+
+	while((nvmeRamCount > 0) && (n < maxCompletions))
+	{
+		i = rand() % nvmeRamCount;
+		c = nvmeRamPending[i];
+		nvmeRamPending[i] = nvmeRamPending[--nvmeRamCount];
+
+		completion.cid = c.cid;
+		completion.status = 0;
+		completion.numLBA = c.numLBA;
+		completion.latency = 0;
+		if(c.opc == 0x01) { memcpy(nvmeRam + c.lba * NVMERAM_LBA_SIZE, c.buffer, (size_t) c.numLBA * NVMERAM_LBA_SIZE); }
+		if(c.opc == 0x02)
+		{
+			if((nvmeRamFailLBA >= c.lba) && (nvmeRamFailLBA < c.lba + c.numLBA))
+			{
+				// Unrecovered Read Error, and the buffer is left as it was.
+				completion.status = 0x0281;
+				nvmeRamFailLBA = ~0ULL;
+				nvmeRamFailed++;
+			}
+			else { memcpy(c.buffer, nvmeRam + c.lba * NVMERAM_LBA_SIZE, (size_t) c.numLBA * NVMERAM_LBA_SIZE); }
+		}
+
+		nvmeRamSlotFree |= 1ULL << (c.cid % NVME_IO_SLOTS);
+		for(u8 h = 0; h < nvmeRamHooks; h++) { nvmeRamHook[h](&completion); }
+		n++;
+	}
+
+	return n;
+}
+
+int nvmeAddCompletionHook(nvmeCompletionHook_type hook)
+{
+	for(u8 h = 0; h < nvmeRamHooks; h++)
+	{
+		if(nvmeRamHook[h] == hook) { return 0; }
+	}
+	if(nvmeRamHooks == NVME_COMPLETION_HOOKS_MAX) { return 1; }
+
+	nvmeRamHook[nvmeRamHooks++] = hook;
+	return 0;
+}
+
+// The next read that covers the LBA fails.
+void nvmeRamFailRead(u64 lba)
+{
+	nvmeRamFailLBA = lba;
+}
+
+// Number of reads failed so far.
+u32 nvmeRamFailures(void)
+{
+	return nvmeRamFailed;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+int nvmeRamSubmit(u8 opc, u8 * buffer, u64 lba, u32 numLBA, u16 * cid)
+{
+	nvmeRamCommand_type * c;
+	u8 slot = 0;
+
+	if((opc != 0x00) && ((numLBA == 0) || ((u64) numLBA * NVMERAM_LBA_SIZE > NVMERAM_MAX_TRANSFER))) { return NVME_RW_BAD_LENGTH; }
+	if((opc != 0x00) && (lba + numLBA > NVMERAM_LBAS)) { return NVME_RW_BAD_LENGTH; }
+	if(nvmeRamCount == NVME_IO_QUEUE_DEPTH) { return NVME_RW_QUEUE_FULL; }
+
+	while(!(nvmeRamSlotFree & (1ULL << slot))) { slot++; }
+	nvmeRamSlotFree &= ~(1ULL << slot);
+
+	c = &nvmeRamPending[nvmeRamCount++];
+	c->opc = opc;
+	c->buffer = buffer;
+	c->lba = lba;
+	c->numLBA = numLBA;
+	c->cid = (u16)(++nvmeRamSlotGen[slot] * NVME_IO_SLOTS + slot);
+	*cid = c->cid;
+
+	return NVME_RW_OK;
+}
@@ -0,0 +1,95 @@
+/*
+Host RAM Disk
+
+diskio.h for the host tests in this directory: RAMDISK_SECTORS sectors of RAMDISK_SS bytes in memory, so that ff.c can
+be built and run on a PC without the NVMe driver. Asynchronous commands complete as they are submitted.
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "ff.h"
+#include "diskio.h"
+#include <string.h>
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#ifndef RAMDISK_SS
+#define RAMDISK_SS 512
+#endif
+
+#ifndef RAMDISK_SECTORS
+#define RAMDISK_SECTORS (128UL << 10)		// 64MiB with 512B sectors.
+#endif
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+static BYTE ramdisk[RAMDISK_SECTORS * RAMDISK_SS];
+static DWORD ramdiskToken;
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+DSTATUS disk_status(BYTE pdrv)
+{
+	return 0;
+}
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+	return 0;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE * buff, LBA_t sector, UINT count)
+{
+	if((sector >= RAMDISK_SECTORS) || (count > RAMDISK_SECTORS - sector)) { return RES_PARERR; }
+
+	memcpy(buff, ramdisk + (size_t)sector * RAMDISK_SS, (size_t)count * RAMDISK_SS);
+	return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE * buff, LBA_t sector, UINT count)
+{
+	if((sector >= RAMDISK_SECTORS) || (count > RAMDISK_SECTORS - sector)) { return RES_PARERR; }
+
+	memcpy(ramdisk + (size_t)sector * RAMDISK_SS, buff, (size_t)count * RAMDISK_SS);
+	return RES_OK;
+}
+
+DRESULT disk_read_async(BYTE pdrv, BYTE * buff, LBA_t sector, UINT count, DWORD * token)
+{
+	*token = ++ramdiskToken;
+	return disk_read(pdrv, buff, sector, count);
+}
+
+DRESULT disk_write_async(BYTE pdrv, const BYTE * buff, LBA_t sector, UINT count, DWORD * token)
+{
+	*token = ++ramdiskToken;
+	return disk_write(pdrv, buff, sector, count);
+}
+
+DRESULT disk_poll(BYTE pdrv, DWORD token)
+{
+	return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void * buff)
+{
+	switch(cmd)
+	{
+	case CTRL_SYNC:
+		return RES_OK;
+	case GET_SECTOR_COUNT:
+		*(LBA_t *) buff = RAMDISK_SECTORS;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(WORD *) buff = RAMDISK_SS;
+		return RES_OK;
+	case GET_BLOCK_SIZE:
+		*(DWORD *) buff = 1;
+		return RES_OK;
+	case CTRL_TRIM:
+	case CTRL_WRITE_BEHIND:
+		return RES_OK;
+	}
+
+	return RES_PARERR;
+}
@@ -0,0 +1,114 @@
+/*
+Failed Read-Ahead Test (Host)
+
+Runs ff.c and diskio.c on a RAM NVMe drive (nvmeram.c) and fails one prefetch read of a file being read sequentially.
+FatFs throws the prefetched buffer away and reads the data again, so the read must still return the file, and a failed
+read the caller never asked for must not fail later reads or writes of the volume.
+
+Build and run from this directory:
+gcc -O2 -Wall -I. -I../src -o readahead_test readahead_test.c nvmeram.c ../src/diskio.c ../src/ffsystem.c ../src/ffunicode.c && ./readahead_test
+*/
+
+// Include Headers -----------------------------------------------------------------------------------------------------
+
+#include "../src/ff.c"		// For the static clst2sect().
+#include "nvme.h"
+#include <stdio.h>
+#include <string.h>
+
+// Private Pre-Processor Definitions -----------------------------------------------------------------------------------
+
+#define TEST_FILE_BYTES (4UL << 20)
+#define TEST_FAIL_OFFSET (1UL << 20)	// Well into the read-ahead of a sequential read from the start.
+#define TEST_CHUNK (16UL << 10)
+
+// Private Function Prototypes -----------------------------------------------------------------------------------------
+
+void nvmeRamFailRead(u64 lba);
+u32 nvmeRamFailures(void);
+int testWrite(const char * path, UINT seed);
+int testRead(const char * path, UINT seed);
+void testFill(BYTE * buf, FSIZE_t ofs, UINT n, UINT seed);
+
+// Private Global Variables --------------------------------------------------------------------------------------------
+
+static FATFS fs;
+static BYTE work[FF_MAX_SS];
+static BYTE buf[TEST_CHUNK];
+static BYTE expect[TEST_CHUNK];
+
+// Public Function Definitions -----------------------------------------------------------------------------------------
+
+int main(void)
+{
+	MKFS_PARM opt = { FM_EXFAT, 1, 0, 0, 0 };
+	int errors = 0;
+
+	if(f_mkfs("", &opt, work, sizeof(work)) != FR_OK) { printf("f_mkfs failed.\n"); return 1; }
+	if(f_mount(&fs, "", 1) != FR_OK) { printf("f_mount failed.\n"); return 1; }
+
+	errors += testWrite("a.bin", 1);
+	errors += testRead("a.bin", 1);
+	if(nvmeRamFailures() != 1) { printf("The prefetch read didn't fail.\n"); errors++; }
+
+	// The volume is still usable.
+	errors += testWrite("b.bin", 2);
+	if(f_mount(0, "", 0) != FR_OK) { errors++; }
+	if(f_mount(&fs, "", 1) != FR_OK) { printf("f_mount failed.\n"); return 1; }
+	errors += testRead("b.bin", 2);
+
+	printf("%s: %d errors.\n", errors ? "FAIL" : "PASS", errors);
+	return errors ? 1 : 0;
+}
+
+// Private Function Definitions ----------------------------------------------------------------------------------------
+
+// Write a file of TEST_FILE_BYTES. Returns the number of errors.
+int testWrite(const char * path, UINT seed)
+{
+	FIL fil;
+	UINT bw;
+	FRESULT res;
+
+	if(f_open(&fil, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) { printf("f_open(%s) failed.\n", path); return 1; }
+	for(FSIZE_t ofs = 0; ofs < TEST_FILE_BYTES; ofs += TEST_CHUNK)
+	{
+		testFill(buf, ofs, TEST_CHUNK, seed);
+		res = f_write(&fil, buf, TEST_CHUNK, &bw);
+		if((res != FR_OK) || (bw != TEST_CHUNK)) { printf("f_write(%s) failed: %d.\n", path, res); f_close(&fil); return 1; }
+	}
+	res = f_close(&fil);
+	if(res != FR_OK) { printf("f_close(%s) failed: %d.\n", path, res); return 1; }
+
+	return 0;
+}
+
+// Read the file back sequentially, failing the first read of the sector at TEST_FAIL_OFFSET. Returns the number of
+// errors.
+int testRead(const char * path, UINT seed)
+{
+	FIL fil;
+	UINT br;
+	FRESULT res;
+	int errors = 0;
+
+	if(f_open(&fil, path, FA_READ) != FR_OK) { printf("f_open(%s) failed.\n", path); return 1; }
+	nvmeRamFailRead(clst2sect(&fs, fil.obj.sclust) + TEST_FAIL_OFFSET / SS(&fs));
+
+	for(FSIZE_t ofs = 0; ofs < TEST_FILE_BYTES; ofs += TEST_CHUNK)
+	{
+		res = f_read(&fil, buf, TEST_CHUNK, &br);
+		if((res != FR_OK) || (br != TEST_CHUNK)) { printf("f_read(%s) at %u failed: %d.\n", path, (UINT) ofs, res); errors++; break; }
+		testFill(expect, ofs, TEST_CHUNK, seed);
+		if(memcmp(buf, expect, TEST_CHUNK)) { printf("%s: Wrong data at %u.\n", path, (UINT) ofs); errors++; }
+	}
+	res = f_close(&fil);
+	if(res != FR_OK) { printf("f_close(%s) failed: %d.\n", path, res); errors++; }
+
+	return errors;
+}
+
+void testFill(BYTE * buf, FSIZE_t ofs, UINT n, UINT seed)
+{
+	for(UINT i = 0; i < n; i += 4) { st_dword(buf + i, (DWORD)(ofs + i) * 2654435761U + seed); }
+}
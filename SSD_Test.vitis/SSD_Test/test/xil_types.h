@@ -0,0 +1,17 @@
+/*
+Host Stand-In for the BSP's xil_types.h
+
+Just the integer types that nvme.h needs, for the host tests in this directory.
+*/
+
+#ifndef XIL_TYPES_H
+#define XIL_TYPES_H
+
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+#endif